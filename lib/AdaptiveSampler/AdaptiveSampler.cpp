@@ -0,0 +1,139 @@
+/**
+ * @file         : AdaptiveSampler.cpp
+ * @summary      : Adaptive sampler
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Rate of change driven sampling interval with median and EMA filtering
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "AdaptiveSampler.h"
+
+AdaptiveSampler::AdaptiveSampler(uint8_t channels, unsigned long minInterval, unsigned long maxInterval) {
+  this->channels = channels < SAMPLER_MAX_CHANNELS ? channels : SAMPLER_MAX_CHANNELS;
+  this->minInterval = minInterval;
+  this->maxInterval = maxInterval > minInterval ? maxInterval : minInterval;
+  this->interval = minInterval;
+  for (uint8_t channel = 0; channel < SAMPLER_MAX_CHANNELS; channel++) {
+    this->thresholds[channel] = 0;
+    this->resolutions[channel] = 0;
+    this->filtered[channel] = NAN;
+  }
+  this->samples = 0;
+  this->next = 0;
+  this->started = false;
+  this->lastTime = 0;
+  this->hourStart = 0;
+  this->hourSamples = 0;
+  this->lastHourSamples = 0;
+  this->hourDone = false;
+}
+
+void AdaptiveSampler::setThreshold(uint8_t channel, float perMinute, float resolution) {
+  if (channel < this->channels) {
+    this->thresholds[channel] = perMinute;
+    this->resolutions[channel] = resolution;
+  }
+}
+
+float AdaptiveSampler::median(uint8_t channel) {
+  float values[SAMPLER_MEDIAN_SIZE];
+  for (uint8_t i = 0; i < this->samples; i++) {
+    values[i] = this->window[channel][i];
+  }
+  // Insertion sort, the window is tiny
+  for (uint8_t i = 1; i < this->samples; i++) {
+    float value = values[i];
+    int8_t j = i - 1;
+    while (j >= 0 && values[j] > value) {
+      values[j + 1] = values[j];
+      j--;
+    }
+    values[j + 1] = value;
+  }
+  return this->samples % 2 ? values[this->samples / 2] : (values[this->samples / 2 - 1] + values[this->samples / 2]) / 2;
+}
+
+unsigned long AdaptiveSampler::update(const float *raw, float *filtered, unsigned long now) {
+  if (!this->started) {
+    this->started = true;
+    this->hourStart = now;
+  }
+  if (now - this->hourStart >= SAMPLER_HOUR) {
+    this->lastHourSamples = this->hourSamples;
+    this->hourSamples = 0;
+    this->hourStart += (now - this->hourStart) / SAMPLER_HOUR * SAMPLER_HOUR;
+    this->hourDone = true;
+  }
+  this->hourSamples++;
+  for (uint8_t channel = 0; channel < this->channels; channel++) {
+    this->window[channel][this->next] = raw[channel];
+  }
+  this->next = (this->next + 1) % SAMPLER_MEDIAN_SIZE;
+  if (this->samples < SAMPLER_MEDIAN_SIZE) {
+    this->samples++;
+  }
+  float minutes = (now - this->lastTime) / 60000.0f;
+  bool changing = false;
+  for (uint8_t channel = 0; channel < this->channels; channel++) {
+    float value = this->median(channel);
+    float previous = this->filtered[channel];
+    if (isnan(previous)) {
+      this->filtered[channel] = value;
+      changing = true;
+    } else {
+      this->filtered[channel] = previous + SAMPLER_EMA_WEIGHT * (value - previous);
+      float change = fabsf(this->filtered[channel] - previous);
+      if (minutes > 0 && change > this->resolutions[channel] && change / minutes > this->thresholds[channel]) {
+        changing = true;
+      }
+    }
+    filtered[channel] = this->filtered[channel];
+  }
+  this->lastTime = now;
+  if (changing) {
+    this->interval = this->minInterval;
+  } else if (this->interval < this->maxInterval) {
+    this->interval = this->interval * SAMPLER_BACKOFF < this->maxInterval ? this->interval * SAMPLER_BACKOFF : this->maxInterval;
+  }
+  return this->interval;
+}
+
+unsigned long AdaptiveSampler::getInterval() {
+  return this->interval;
+}
+
+bool AdaptiveSampler::getHourlyCount(uint32_t *count) {
+  if (!this->hourDone) {
+    return false;
+  }
+  this->hourDone = false;
+  *count = this->lastHourSamples;
+  return true;
+}
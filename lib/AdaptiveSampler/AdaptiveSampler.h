@@ -0,0 +1,93 @@
+/**
+ * @file         : AdaptiveSampler.h
+ * @summary      : Adaptive sampler
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Rate of change driven sampling interval with median and EMA filtering
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#pragma once
+#include <stdint.h>
+#include <math.h>
+
+#define SAMPLER_MAX_CHANNELS 4
+#define SAMPLER_MEDIAN_SIZE 3         // Enough to drop any single sample glitch
+#define SAMPLER_EMA_WEIGHT 0.5f       // Weight of a new median in the running average
+#define SAMPLER_BACKOFF 2             // Interval multiplier while readings are stable
+#define SAMPLER_HOUR 3600000UL        // In ms
+
+/**
+ * Filters a few related channels (e.g. temperature and humidity) sampled
+ * together and decides when to sample next. Each channel goes through a
+ * median of the last SAMPLER_MEDIAN_SIZE raw samples, then an EMA. While
+ * every filtered channel changes slower than its threshold the interval
+ * doubles up to `maxInterval`, as soon as one crosses it the interval
+ * drops back to `minInterval`.
+ */
+class AdaptiveSampler {
+  private:
+    uint8_t channels;
+    unsigned long minInterval;    // In ms
+    unsigned long maxInterval;    // In ms
+    unsigned long interval;       // In ms
+    float thresholds[SAMPLER_MAX_CHANNELS];   // Per minute
+    float resolutions[SAMPLER_MAX_CHANNELS];
+    float window[SAMPLER_MAX_CHANNELS][SAMPLER_MEDIAN_SIZE];
+    float filtered[SAMPLER_MAX_CHANNELS];
+    uint8_t samples;              // Samples in the window
+    uint8_t next;                 // Window slot for the next sample
+    bool started;
+    unsigned long lastTime;       // In ms
+    unsigned long hourStart;      // In ms
+    uint32_t hourSamples;
+    uint32_t lastHourSamples;
+    bool hourDone;
+    float median(uint8_t channel);
+
+  public:
+    AdaptiveSampler(uint8_t channels, unsigned long minInterval, unsigned long maxInterval);
+    /**
+     * Rate of change, in units per minute, that counts as changing. Steps
+     * up to `resolution` are sensor noise at short intervals and ignored.
+     */
+    void setThreshold(uint8_t channel, float perMinute, float resolution);
+    /**
+     * Feed one raw sample per channel taken at `now` (ms) and write the
+     * filtered values to `filtered`.
+     * @return ms to wait before the next sample
+     */
+    unsigned long update(const float *raw, float *filtered, unsigned long now);
+    unsigned long getInterval();
+    /**
+     * @return true once per completed hour, with the samples taken during
+     * that hour in `count`
+     */
+    bool getHourlyCount(uint32_t *count);
+};
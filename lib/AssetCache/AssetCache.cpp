@@ -0,0 +1,150 @@
+/**
+ * @file         : AssetCache.cpp
+ * @summary      : Asset cache
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Bounded LRU cache of the web UI files kept on the SD card
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+#include "AssetCache.h"
+
+AssetCache::AssetCache() {
+  this->used = 0;
+  this->clock = 0;
+  this->stats = { 0, 0, 0, 0, 0, 0, 0 };
+  for (uint8_t i = 0; i < ASSET_CACHE_ENTRIES; i++) {
+    this->entries[i].data = nullptr;
+  }
+}
+
+AssetCache::~AssetCache() {
+  this->clear();
+}
+
+void AssetCache::release(ASSETENTRY *entry) {
+  // Freed once the last response sending it is done too
+  entry->data = nullptr;
+  this->used -= entry->size;
+}
+
+ASSETENTRY *AssetCache::evict(size_t size) {
+  while (true) {
+    ASSETENTRY *empty = NULL;
+    ASSETENTRY *oldest = NULL;
+    for (uint8_t i = 0; i < ASSET_CACHE_ENTRIES; i++) {
+      ASSETENTRY *entry = &this->entries[i];
+      if (!entry->data) {
+        empty = empty == NULL ? entry : empty;
+      } else if (oldest == NULL || entry->lastUsed < oldest->lastUsed) {
+        oldest = entry;
+      }
+    }
+    if (empty != NULL && this->used + size <= ASSET_CACHE_BUDGET) {
+      return empty;
+    }
+    this->release(oldest);
+  }
+}
+
+const ASSETENTRY *AssetCache::get(const char *path, bool acceptsGzip) {
+  for (uint8_t i = 0; i < ASSET_CACHE_ENTRIES; i++) {
+    ASSETENTRY *entry = &this->entries[i];
+    if (entry->data && entry->acceptsGzip == acceptsGzip && strcmp(entry->path, path) == 0) {
+      entry->lastUsed = ++this->clock;
+      this->stats.hits++;
+      return entry;
+    }
+  }
+  this->stats.misses++;
+  return NULL;
+}
+
+const ASSETENTRY *AssetCache::put(const char *path, bool acceptsGzip, bool gzip, const char *etag, File &file) {
+  size_t size = file.size();
+  if (size > ASSET_CACHE_MAX_SIZE || strlen(path) >= ASSET_CACHE_PATH_SIZE) {
+    return NULL;
+  }
+  // Load before evicting, a failed allocation or read leaves the cache as
+  // it was. An empty file still needs a non NULL pointer
+  uint8_t *data = (uint8_t *)malloc(size > 0 ? size : 1);
+  if (data == NULL) {
+    return NULL;
+  }
+  if (file.read(data, size) != size) {
+    // Rewound, the caller streams the file instead
+    free(data);
+    file.seek(0);
+    return NULL;
+  }
+  ASSETENTRY *entry = this->evict(size);
+  strcpy(entry->path, path);
+  strncpy(entry->etag, etag, ASSET_CACHE_ETAG_SIZE - 1);
+  entry->etag[ASSET_CACHE_ETAG_SIZE - 1] = '\0';
+  entry->acceptsGzip = acceptsGzip;
+  entry->gzip = gzip;
+  entry->data = std::shared_ptr<uint8_t>(data, free);
+  entry->size = size;
+  entry->lastUsed = ++this->clock;
+  this->used += size;
+  return entry;
+}
+
+void AssetCache::clear() {
+  for (uint8_t i = 0; i < ASSET_CACHE_ENTRIES; i++) {
+    if (this->entries[i].data) {
+      this->release(&this->entries[i]);
+    }
+  }
+}
+
+void AssetCache::makeETag(char *etag, File &file) {
+  sprintf(etag, "\"%x-%lx\"", (unsigned int)file.size(), (unsigned long)file.getLastWrite());
+}
+
+void AssetCache::countSent(size_t bytes, bool cached) {
+  if (cached) {
+    this->stats.cacheBytes += bytes;
+  } else {
+    this->stats.cardBytes += bytes;
+  }
+}
+
+void AssetCache::countNotModified() {
+  this->stats.notModified++;
+}
+
+ASSETCACHESTATS AssetCache::getStats() {
+  ASSETCACHESTATS stats = this->stats;
+  stats.usedBytes = this->used;
+  stats.entries = 0;
+  for (uint8_t i = 0; i < ASSET_CACHE_ENTRIES; i++) {
+    stats.entries += this->entries[i].data != nullptr;
+  }
+  return stats;
+}
@@ -0,0 +1,99 @@
+/**
+ * @file         : AssetCache.h
+ * @summary      : Asset cache
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Bounded LRU cache of the web UI files kept on the SD card
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+#pragma once
+#include <Arduino.h>
+#include <FS.h>
+#include <memory>
+
+#define ASSET_CACHE_ENTRIES 16
+#define ASSET_CACHE_BUDGET 40960          // Total file bytes held in RAM
+#define ASSET_CACHE_MAX_SIZE 16384        // Larger files are streamed from the card every time
+#define ASSET_CACHE_PATH_SIZE 48
+#define ASSET_CACHE_ETAG_SIZE 24
+
+struct ASSETENTRY {
+  char path[ASSET_CACHE_PATH_SIZE];   // As requested, without .gz
+  bool acceptsGzip;                   // Cached for clients that take gzip
+  bool gzip;                          // `data` is the .gz file
+  char etag[ASSET_CACHE_ETAG_SIZE];
+  std::shared_ptr<uint8_t> data;      // Empty for a free entry, shared with responses still sending it
+  size_t size;
+  uint32_t lastUsed;
+};
+
+struct ASSETCACHESTATS {
+  uint32_t hits;
+  uint32_t misses;
+  uint32_t notModified;               // Answered with a 304
+  uint32_t cacheBytes;                // Sent out of RAM
+  uint32_t cardBytes;                 // Sent straight from the card
+  uint32_t usedBytes;                 // Held right now
+  uint8_t entries;
+};
+
+/**
+ * Small files are read once and kept, least recently used first out when
+ * either the entry table or the byte budget is full. Each path may be held
+ * twice, as sent to gzip and non gzip clients, since the first may get the
+ * precompressed file. Entries live until clear(), the card is not written
+ * while the clock runs.
+ */
+class AssetCache {
+  private:
+    ASSETENTRY entries[ASSET_CACHE_ENTRIES];
+    size_t used;
+    uint32_t clock;
+    ASSETCACHESTATS stats;
+    void release(ASSETENTRY *entry);
+    ASSETENTRY *evict(size_t size);
+
+  public:
+    AssetCache();
+    ~AssetCache();
+    /** @return cached copy of `path`, NULL on a miss */
+    const ASSETENTRY *get(const char *path, bool acceptsGzip);
+    /**
+     * Read `file`, at its start, into the cache for `path`.
+     * @return the new entry, NULL when the file is too big, memory is short
+     * or the read comes up short, `file` is then still at its start
+     */
+    const ASSETENTRY *put(const char *path, bool acceptsGzip, bool gzip, const char *etag, File &file);
+    void clear();
+    /** Validator from the file size and modification time */
+    static void makeETag(char *etag, File &file);
+    void countSent(size_t bytes, bool cached);
+    void countNotModified();
+    ASSETCACHESTATS getStats();
+};
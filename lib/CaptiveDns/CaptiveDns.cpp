@@ -0,0 +1,112 @@
+/**
+ * @file         : CaptiveDns.cpp
+ * @summary      : Captive DNS
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : DNS responder that resolves every name to the access point
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+#include "CaptiveDns.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+CaptiveDns::CaptiveDns() {
+  this->socket = -1;
+}
+
+bool CaptiveDns::begin(uint16_t port, const IPAddress &address) {
+  this->address = address;
+  this->socket = ::socket(AF_INET, SOCK_DGRAM, 0);
+  if (this->socket < 0) {
+    return false;
+  }
+  struct sockaddr_in local;
+  memset(&local, 0, sizeof(local));
+  local.sin_family = AF_INET;
+  local.sin_port = htons(port);
+  local.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(this->socket, (struct sockaddr *)&local, sizeof(local)) < 0) {
+    this->stop();
+    return false;
+  }
+  fcntl(this->socket, F_SETFL, fcntl(this->socket, F_GETFL, 0) | O_NONBLOCK);
+  return true;
+}
+
+void CaptiveDns::stop() {
+  if (this->socket >= 0) {
+    close(this->socket);
+    this->socket = -1;
+  }
+}
+
+int CaptiveDns::getSocket() {
+  return this->socket;
+}
+
+void CaptiveDns::processNextRequest() {
+  struct sockaddr_in client;
+  socklen_t clientLength = sizeof(client);
+  ssize_t size;
+  while (this->socket >= 0 && (size = recvfrom(this->socket, this->packet, DNS_PACKET_SIZE, MSG_DONTWAIT, (struct sockaddr *)&client, &clientLength)) >= 0) {
+    uint8_t *packet = this->packet;
+    // Standard queries with a single question only
+    if (size < DNS_HEADER_SIZE || (packet[2] & 0xF8) != 0 || packet[4] != 0 || packet[5] != 1) {
+      clientLength = sizeof(client);
+      continue;
+    }
+    size_t offset = DNS_HEADER_SIZE;
+    while (offset < (size_t)size && packet[offset] != 0) {
+      offset += packet[offset] + 1;
+    }
+    // Past the name, its type and class
+    size_t length = offset + 5;
+    if (length > (size_t)size || length + DNS_ANSWER_SIZE > DNS_PACKET_SIZE) {
+      clientLength = sizeof(client);
+      continue;
+    }
+    uint16_t type = packet[offset + 1] << 8 | packet[offset + 2];
+    bool answer = type == 1 || type == 255;   // A or ANY
+    packet[2] = 0x84 | (packet[2] & 0x01);    // Response, authoritative, keep recursion desired
+    packet[3] = 0x80;                         // Recursion available, no error
+    packet[6] = 0;
+    packet[7] = answer ? 1 : 0;
+    memset(&packet[8], 0, 4);                 // No authority or additional records
+    if (answer) {
+      static const uint8_t record[] = { 0xC0, DNS_HEADER_SIZE, 0, 1, 0, 1, 0, 0, 0, DNS_TTL, 0, 4 };
+      memcpy(&packet[length], record, sizeof(record));
+      for (uint8_t i = 0; i < 4; i++) {
+        packet[length + sizeof(record) + i] = this->address[i];
+      }
+      length += DNS_ANSWER_SIZE;
+    }
+    sendto(this->socket, packet, length, 0, (struct sockaddr *)&client, clientLength);
+    clientLength = sizeof(client);
+  }
+}
@@ -0,0 +1,65 @@
+/**
+ * @file         : CaptiveDns.h
+ * @summary      : Captive DNS
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : DNS responder that resolves every name to the access point
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+#pragma once
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#define DNS_PACKET_SIZE 512       // Plain UDP DNS, no EDNS
+#define DNS_HEADER_SIZE 12
+#define DNS_ANSWER_SIZE 16        // Name pointer, type, class, TTL, length and the address
+#define DNS_TTL 60                // Seconds clients may keep the answer
+
+/**
+ * Answers every A query with one address so phones open the portal
+ * whatever they look up. The socket is non blocking and exposed so the
+ * HTTP server task can wait on it in the same select().
+ */
+class CaptiveDns {
+  private:
+    int socket;
+    IPAddress address;
+    uint8_t packet[DNS_PACKET_SIZE];
+
+  public:
+    CaptiveDns();
+    bool begin(uint16_t port, const IPAddress &address);
+    void stop();
+    /** @return the UDP socket, -1 before begin() */
+    int getSocket();
+    /** Answer the queries waiting on the socket, never blocks */
+    void processNextRequest();
+};
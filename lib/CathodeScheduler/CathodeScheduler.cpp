@@ -0,0 +1,123 @@
+/**
+ * @file         : CathodeScheduler.cpp
+ * @summary      : Cathode poisoning prevention
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Per cathode on-time accounting and slot-machine cycles aimed at the least used cathodes
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "CathodeScheduler.h"
+
+CathodeScheduler::CathodeScheduler(uint8_t tubeCount) {
+  this->tubeCount = tubeCount < CATHODE_MAX_TUBES ? tubeCount : CATHODE_MAX_TUBES;
+  memset(this->hours, 0, sizeof(this->hours));
+  memset(this->seconds, 0, sizeof(this->seconds));
+  memset(this->rotation, 0, sizeof(this->rotation));
+  this->dirty = false;
+  this->sinceSave = 0;
+}
+
+bool CathodeScheduler::begin() {
+  if (!this->preferences.begin(CATHODE_NVS_NAMESPACE, false)) {
+    return false;
+  }
+  // A table of another size belongs to another build, start over
+  if (this->preferences.getBytesLength(CATHODE_NVS_KEY) == sizeof(this->hours)) {
+    this->preferences.getBytes(CATHODE_NVS_KEY, this->hours, sizeof(this->hours));
+  }
+  if (this->preferences.getBytesLength(CATHODE_NVS_ROTATION_KEY) == sizeof(this->rotation)) {
+    this->preferences.getBytes(CATHODE_NVS_ROTATION_KEY, this->rotation, sizeof(this->rotation));
+  }
+  return true;
+}
+
+void CathodeScheduler::account(const uint8_t *digits, uint16_t seconds) {
+  for (uint8_t tube = 0; tube < this->tubeCount; tube++) {
+    uint8_t digit = digits[tube];
+    if (digit >= CATHODE_DIGITS) {
+      continue;
+    }
+    uint32_t total = this->seconds[tube][digit] + seconds;
+    if (total >= 3600) {
+      uint32_t hours = this->hours[tube][digit] + total / 3600;
+      this->hours[tube][digit] = hours > UINT16_MAX ? UINT16_MAX : hours;
+      this->dirty = true;
+      total %= 3600;
+    }
+    this->seconds[tube][digit] = total;
+  }
+  this->sinceSave += seconds;
+}
+
+bool CathodeScheduler::save(bool force) {
+  if (!this->dirty || (!force && this->sinceSave < CATHODE_SAVE_PERIOD)) {
+    return true;
+  }
+  this->dirty = false;
+  this->sinceSave = 0;
+  // The rotation rides along, losing the last hour of it only repeats a few cycles
+  this->preferences.putBytes(CATHODE_NVS_ROTATION_KEY, this->rotation, sizeof(this->rotation));
+  return this->preferences.putBytes(CATHODE_NVS_KEY, this->hours, sizeof(this->hours)) == sizeof(this->hours);
+}
+
+uint32_t CathodeScheduler::usage(uint8_t tube, uint8_t digit) {
+  return (uint32_t)this->hours[tube][digit] * 3600 + this->seconds[tube][digit];
+}
+
+void CathodeScheduler::plan(uint8_t *sequence, uint8_t steps) {
+  for (uint8_t tube = 0; tube < this->tubeCount; tube++) {
+    // Partial selection sort, only the first few are needed. Order starts
+    // at the rotation so equally used cathodes take turns
+    uint8_t order[CATHODE_DIGITS];
+    for (uint8_t i = 0; i < CATHODE_DIGITS; i++) {
+      order[i] = (this->rotation[tube] + i) % CATHODE_DIGITS;
+    }
+    for (uint8_t i = 0; i < CATHODE_CYCLE_DIGITS; i++) {
+      uint8_t least = i;
+      for (uint8_t j = i + 1; j < CATHODE_DIGITS; j++) {
+        if (this->usage(tube, order[j]) < this->usage(tube, order[least])) {
+          least = j;
+        }
+      }
+      // Shift instead of swap, the rest must stay in rotation order
+      uint8_t digit = order[least];
+      memmove(order + i + 1, order + i, least - i);
+      order[i] = digit;
+    }
+    this->rotation[tube] = (order[CATHODE_CYCLE_DIGITS - 1] + 1) % CATHODE_DIGITS;
+    for (uint8_t step = 0; step < steps; step++) {
+      sequence[step * this->tubeCount + tube] = order[step % CATHODE_CYCLE_DIGITS];
+    }
+  }
+}
+
+uint16_t CathodeScheduler::getHours(uint8_t tube, uint8_t digit) {
+  return tube < this->tubeCount && digit < CATHODE_DIGITS ? this->hours[tube][digit] : 0;
+}
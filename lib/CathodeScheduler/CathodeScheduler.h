@@ -0,0 +1,90 @@
+/**
+ * @file         : CathodeScheduler.h
+ * @summary      : Cathode poisoning prevention
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Per cathode on-time accounting and slot-machine cycles aimed at the least used cathodes
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#pragma once
+#include <Arduino.h>
+#include <Preferences.h>
+
+#define CATHODE_MAX_TUBES 8
+#define CATHODE_DIGITS 10
+#define CATHODE_SAVE_PERIOD 3600      // Min time between NVS writes (s)
+#define CATHODE_CYCLE_DIGITS 4        // Least used cathodes each cycle goes through
+#define CATHODE_NVS_NAMESPACE "nixie"
+#define CATHODE_NVS_KEY "cathodes"
+#define CATHODE_NVS_ROTATION_KEY "rotation"
+
+/**
+ * Keeps the on-time of every cathode of every tube in whole hours, a
+ * 16 bit counter each (7 years), persisted in NVS at most once an hour.
+ * The seconds not yet making up an hour stay in RAM and are lost on a
+ * reset, that is at most an hour of a slow moving statistic.
+ *
+ * plan() builds a short slot-machine sequence per tube out of that tube
+ * least used cathodes, the caller shows it like any other frame so it
+ * costs nothing beyond the usual refresh. The cycles themselves are too
+ * short to move the counters, so cathodes that are never shown (3 to 9 on
+ * the tens of hours) tie forever. Ties are broken round-robin, each plan
+ * starts after the last cathode the previous one picked.
+ */
+class CathodeScheduler {
+  private:
+    Preferences preferences;
+    uint8_t tubeCount;
+    uint16_t hours[CATHODE_MAX_TUBES][CATHODE_DIGITS];
+    uint16_t seconds[CATHODE_MAX_TUBES][CATHODE_DIGITS];  // Below an hour
+    uint8_t rotation[CATHODE_MAX_TUBES];  // Digit the tie-break between equally used cathodes starts at
+    bool dirty;               // Hours changed since the last save
+    uint32_t sinceSave;       // In s
+    uint32_t usage(uint8_t tube, uint8_t digit);
+
+  public:
+    CathodeScheduler(uint8_t tubeCount);
+    /** Load the counters from NVS */
+    bool begin();
+    /**
+     * Add `seconds` of on-time to the cathodes in `digits`, one per tube,
+     * blank or out of range digits are skipped.
+     */
+    void account(const uint8_t *digits, uint16_t seconds);
+    /** Write the counters to NVS if they changed and the save period is up */
+    bool save(bool force = false);
+    /**
+     * Fill `sequence`, `steps` frames of tubeCount digits each, cycling
+     * every tube through its CATHODE_CYCLE_DIGITS least used cathodes.
+     */
+    void plan(uint8_t *sequence, uint8_t steps);
+    /** @return on-time of `digit` on `tube` in hours */
+    uint16_t getHours(uint8_t tube, uint8_t digit);
+};
@@ -0,0 +1,135 @@
+/**
+ * @file         : ClockDiscipline.cpp
+ * @summary      : Clock discipline loop
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Hybrid phase/frequency locked loop that learns the local clock drift
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "ClockDiscipline.h"
+
+ClockDiscipline::ClockDiscipline() {
+  this->freq = 0;
+  this->offset = 0;
+  this->residual = 0;
+  this->lastSample = 0;
+  this->lastCorrection = 0;
+  this->samples = 0;
+  this->rtcWindowStart = -1;
+  this->rtcDrift = 0;
+}
+
+CLOCKADJUSTMENT ClockDiscipline::update(double offset, double now) {
+  CLOCKADJUSTMENT adjustment = { CLOCK_NONE, 0 };
+  this->offset = offset;
+  if (fabs(offset) > DISCIPLINE_STEP_THRESHOLD) {
+    // Way off (first sync, RTC lost power), the frequency history is useless
+    this->residual = 0;
+    this->lastSample = now;
+    this->lastCorrection = now;
+    this->samples = 1;
+    adjustment.type = CLOCK_STEP;
+    adjustment.amount = offset;
+    return adjustment;
+  }
+  double interval = now - this->lastSample;
+  if (this->samples > 0 && interval >= DISCIPLINE_MIN_INTERVAL) {
+    // FLL: whatever the phase correction didn't explain is frequency error
+    double error = (offset - this->residual) / interval * 1e6;
+    this->freq += DISCIPLINE_FREQ_WEIGHT * error;
+    if (this->freq > DISCIPLINE_MAX_FREQ) {
+      this->freq = DISCIPLINE_MAX_FREQ;
+    } else if (this->freq < -DISCIPLINE_MAX_FREQ) {
+      this->freq = -DISCIPLINE_MAX_FREQ;
+    }
+  }
+  // PLL: slew part of the offset now, plus the frequency correction owed
+  // since holdover() last ran
+  double phase = DISCIPLINE_PHASE_GAIN * offset;
+  this->residual = offset - phase;
+  adjustment.type = CLOCK_SLEW;
+  adjustment.amount = phase + this->holdover(now);
+  this->lastSample = now;
+  this->samples++;
+  return adjustment;
+}
+
+double ClockDiscipline::holdover(double now) {
+  double amount = this->freq * 1e-6 * (now - this->lastCorrection);
+  this->lastCorrection = now;
+  return amount;
+}
+
+RTCADJUSTMENT ClockDiscipline::updateRtc(double rtcOffset, double now, int8_t aging) {
+  RTCADJUSTMENT adjustment = { false, false, aging, this->rtcDrift };
+  if (this->rtcWindowStart < 0) {
+    // No known starting point for the drift window yet
+    adjustment.setTime = fabs(rtcOffset) >= DS3231_STEP_THRESHOLD;
+    if (!adjustment.setTime) {
+      this->rtcWindowStart = now;
+    }
+    return adjustment;
+  }
+  double window = now - this->rtcWindowStart;
+  // Let the RTC drift until the window is long enough to measure it, the
+  // tubes follow the system clock so the RTC error never shows
+  if (window >= DS3231_MIN_AGING_WINDOW) {
+    this->rtcDrift = -rtcOffset / window * 1e6;
+    int32_t value = aging + (int32_t)lround(DS3231_AGING_GAIN * this->rtcDrift / DS3231_AGING_PPM);
+    value = value > 127 ? 127 : value < -128 ? -128 : value;
+    adjustment.drift = this->rtcDrift;
+    adjustment.setAging = value != aging;
+    adjustment.aging = (int8_t)value;
+    adjustment.setTime = true;
+  } else if (fabs(rtcOffset) >= DS3231_STEP_THRESHOLD) {
+    adjustment.setTime = true;
+  }
+  return adjustment;
+}
+
+void ClockDiscipline::rtcSet(double now) {
+  this->rtcWindowStart = now;
+}
+
+double ClockDiscipline::getOffset() {
+  return this->offset;
+}
+
+double ClockDiscipline::getResidual() {
+  return this->residual;
+}
+
+double ClockDiscipline::getFrequency() {
+  return this->freq;
+}
+
+double ClockDiscipline::getRtcDrift() {
+  return this->rtcDrift;
+}
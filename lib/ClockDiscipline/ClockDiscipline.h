@@ -0,0 +1,110 @@
+/**
+ * @file         : ClockDiscipline.h
+ * @summary      : Clock discipline loop
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Hybrid phase/frequency locked loop that learns the local clock drift
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#pragma once
+#include <stdint.h>
+#include <math.h>
+
+#define DISCIPLINE_STEP_THRESHOLD 2.0     // Offsets above this (s) are stepped instead of slewed
+#define DISCIPLINE_PHASE_GAIN 0.5         // Fraction of the measured offset slewed per sample
+#define DISCIPLINE_FREQ_WEIGHT 0.25       // Weight of a new frequency estimate in the running average
+#define DISCIPLINE_MAX_FREQ 500.0         // Frequency correction clamp (ppm)
+#define DISCIPLINE_MIN_INTERVAL 16.0      // Min time between samples to estimate frequency (s)
+
+#define DS3231_AGING_PPM 0.1              // Approximate frequency change per aging offset LSB (ppm)
+#define DS3231_AGING_GAIN 0.5             // Fraction of the measured drift corrected per update
+#define DS3231_MIN_AGING_WINDOW 86400.0   // Min time between RTC sets to estimate its drift (s)
+#define DS3231_STEP_THRESHOLD 0.5         // RTC offsets above this (s) are always corrected
+
+enum ClockAdjustmentType {
+  CLOCK_NONE,           // Nothing to do
+  CLOCK_SLEW,           // Slew the clock by `amount` s (adjtime)
+  CLOCK_STEP            // Step the clock by `amount` s (settimeofday)
+};
+
+struct CLOCKADJUSTMENT {
+  ClockAdjustmentType type;
+  double amount;        // In s, positive moves the clock forward
+};
+
+struct RTCADJUSTMENT {
+  bool setTime;         // Set the RTC from the reference clock
+  bool setAging;        // Write `aging` to the DS3231 aging offset register
+  int8_t aging;
+  double drift;         // Last measured RTC drift (ppm), positive = running fast
+};
+
+class ClockDiscipline {
+  private:
+    double freq;              // Frequency correction applied to the local clock (ppm)
+    double offset;            // Last measured offset (s)
+    double residual;          // Part of the last offset left uncorrected (s)
+    double lastSample;        // Monotonic time of the last sample (s)
+    double lastCorrection;    // Monotonic time the frequency correction was last applied (s)
+    uint32_t samples;
+    double rtcWindowStart;    // Monotonic time the RTC was last set (s)
+    double rtcDrift;          // In ppm
+
+  public:
+    ClockDiscipline();
+    /**
+     * Feed a reference sample, `offset` is reference minus local time and
+     * `now` is a monotonic time base, both in s.
+     * @return adjustment to apply to the local clock
+     */
+    CLOCKADJUSTMENT update(double offset, double now);
+    /**
+     * Frequency correction accumulated since the last call, used to keep the
+     * local clock on frequency between samples (e.g. during WiFi outages).
+     * @return amount to slew the local clock by (s)
+     */
+    double holdover(double now);
+    /**
+     * Feed the DS3231 offset (reference minus RTC, in s) and its current
+     * aging offset register value.
+     * @return what to write back to the RTC
+     */
+    RTCADJUSTMENT updateRtc(double rtcOffset, double now, int8_t aging);
+    /** Start a new RTC drift window, call once the RTC has been set */
+    void rtcSet(double now);
+    /** @return last measured offset, reference minus local time (s) */
+    double getOffset();
+    /** @return part of the last offset still to be corrected (s) */
+    double getResidual();
+    /** @return local clock frequency correction (ppm) */
+    double getFrequency();
+    /** @return last measured RTC drift (ppm) */
+    double getRtcDrift();
+};
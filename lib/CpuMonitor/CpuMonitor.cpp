@@ -0,0 +1,118 @@
+/**
+ * @file         : CpuMonitor.cpp
+ * @summary      : CPU idle time monitor
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Measures per core idle time from the FreeRTOS idle hooks
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "CpuMonitor.h"
+
+volatile int64_t CpuMonitor::lastPass[CPU_MONITOR_CORES];
+volatile uint32_t CpuMonitor::idleMicros[CPU_MONITOR_CORES];
+TaskHandle_t CpuMonitor::idleTasks[CPU_MONITOR_CORES];
+uint32_t CpuMonitor::sampleIdle[CPU_MONITOR_CORES];
+int64_t CpuMonitor::sampleTime;
+float CpuMonitor::idle[CPU_MONITOR_CORES];
+
+bool CpuMonitor::idleHook(int cpu) {
+  // Back to back passes of the idle loop are idle time, anything longer
+  // may have been some task, the tick hook accounts for those
+  int64_t now = esp_timer_get_time();
+  int64_t gap = now - lastPass[cpu];
+  lastPass[cpu] = now;
+  if (gap < CPU_MONITOR_MAX_GAP) {
+    idleMicros[cpu] += (uint32_t)gap;
+  }
+  // Let the idle task wait for the next interrupt
+  return true;
+}
+
+bool CpuMonitor::idleHookPro() {
+  return idleHook(0);
+}
+
+bool CpuMonitor::idleHookApp() {
+  return idleHook(1);
+}
+
+void IRAM_ATTR CpuMonitor::tickHook(int cpu) {
+  // A task that ran since the last mark gave way to the idle loop, which
+  // marked again, so the time since the mark was all idle
+  if (xTaskGetCurrentTaskHandleForCPU(cpu) == idleTasks[cpu]) {
+    int64_t now = esp_timer_get_time();
+    idleMicros[cpu] += (uint32_t)(now - lastPass[cpu]);
+    lastPass[cpu] = now;
+  }
+}
+
+void IRAM_ATTR CpuMonitor::tickHookPro() {
+  tickHook(0);
+}
+
+void IRAM_ATTR CpuMonitor::tickHookApp() {
+  tickHook(1);
+}
+
+bool CpuMonitor::begin() {
+  sampleTime = esp_timer_get_time();
+  for (int cpu = 0; cpu < portNUM_PROCESSORS && cpu < CPU_MONITOR_CORES; cpu++) {
+    idleTasks[cpu] = xTaskGetIdleTaskHandleForCPU(cpu);
+    lastPass[cpu] = sampleTime;
+  }
+  if (esp_register_freertos_idle_hook_for_cpu(idleHookPro, 0) != ESP_OK
+    || esp_register_freertos_tick_hook_for_cpu(tickHookPro, 0) != ESP_OK) {
+    return false;
+  }
+#if !CONFIG_FREERTOS_UNICORE
+  if (esp_register_freertos_idle_hook_for_cpu(idleHookApp, 1) != ESP_OK
+    || esp_register_freertos_tick_hook_for_cpu(tickHookApp, 1) != ESP_OK) {
+    return false;
+  }
+#endif
+  return true;
+}
+
+void CpuMonitor::sample() {
+  int64_t now = esp_timer_get_time();
+  int64_t elapsed = now - sampleTime;
+  sampleTime = now;
+  for (int cpu = 0; cpu < CPU_MONITOR_CORES; cpu++) {
+    // 32 bit reads are atomic, the counter may wrap but the difference won't
+    uint32_t idleNow = idleMicros[cpu];
+    uint32_t idleDelta = idleNow - sampleIdle[cpu];
+    sampleIdle[cpu] = idleNow;
+    idle[cpu] = elapsed > 0 ? 100.0f * idleDelta / elapsed : 0;
+  }
+}
+
+float CpuMonitor::getIdle(BaseType_t cpu) {
+  return cpu >= 0 && cpu < CPU_MONITOR_CORES ? idle[cpu] : 0;
+}
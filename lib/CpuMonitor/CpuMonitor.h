@@ -0,0 +1,77 @@
+/**
+ * @file         : CpuMonitor.h
+ * @summary      : CPU idle time monitor
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Measures per core idle time from the FreeRTOS idle hooks
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#pragma once
+#include <Arduino.h>
+#include <esp_freertos_hooks.h>
+#include <esp_timer.h>
+
+#define CPU_MONITOR_CORES 2
+#define CPU_MONITOR_MAX_GAP 50    // Longer gaps between idle loop passes may hide a task that ran (us)
+
+/**
+ * Idle time per core without keeping the cores awake. The idle hook marks
+ * where each pass of the idle loop starts and lets the idle task wait for
+ * interrupts as usual. The tick hook finds out what it interrupted: when it
+ * is the idle task, everything since the last mark was spent asleep or
+ * idling, whatever ran before that mark was followed by a fresh one.
+ *
+ * Wakeups by other interrupts restart the mark, their gap only counts when
+ * it is short enough that no task can have run in it. Time slept before
+ * such a wakeup is lost, so the figure errs towards busy.
+ */
+class CpuMonitor {
+  private:
+    static volatile int64_t lastPass[CPU_MONITOR_CORES];
+    static volatile uint32_t idleMicros[CPU_MONITOR_CORES];
+    static TaskHandle_t idleTasks[CPU_MONITOR_CORES];
+    static uint32_t sampleIdle[CPU_MONITOR_CORES];
+    static int64_t sampleTime;
+    static float idle[CPU_MONITOR_CORES];
+    static bool idleHook(int cpu);
+    static bool idleHookPro();
+    static bool idleHookApp();
+    static void tickHook(int cpu);
+    static void tickHookPro();
+    static void tickHookApp();
+
+  public:
+    /** Register the idle and tick hooks on every core */
+    static bool begin();
+    /** Close the current measurement window and start a new one */
+    static void sample();
+    /** @return idle percentage of `cpu` over the last window */
+    static float getIdle(BaseType_t cpu);
+};
@@ -35,31 +35,35 @@
 
 #include "DateTime.h"
 
-// Based on https://github.com/PaulStoffregen/Time/blob/master/Time.cpp
-// currently assumes UTC timezone, instead of using this->_timeOffset
-String getFormattedDate(NTPClient *timeClient, unsigned long secs) {
-  unsigned long rawTime = (secs ? secs : timeClient->getEpochTime()) / 86400L;  // in days
-  long days = 0, year = 1970;
-  uint8_t month;
-  static const uint8_t monthDays[]={31,28,31,30,31,30,31,31,30,31,30,31};
+static inline char *writeDigits(char *buffer, uint32_t value, uint8_t digits) {
+  for (int8_t i = digits - 1; i >= 0; i--) {
+    buffer[i] = '0' + value % 10;
+    value /= 10;
+  }
+  return buffer + digits;
+}
 
-  while((days += (LEAP_YEAR(year) ? 366 : 365)) <= rawTime)
-    year++;
-  rawTime -= days - (LEAP_YEAR(year) ? 366 : 365); // now it is days in this year, starting at 0
-  days=0;
-  for (month=0; month<12; month++) {
-    uint8_t monthLength;
-    if (month==1) { // february
-      monthLength = LEAP_YEAR(year) ? 29 : 28;
-    } else {
-      monthLength = monthDays[month];
-    }
-    if (rawTime < monthLength) break;
-    rawTime -= monthLength;
+// currently assumes UTC timezone
+size_t formatIso8601(char *buffer, size_t size, uint32_t secs) {
+  if (size < ISO8601_SIZE) {
+    return 0;
   }
-  String monthStr = ++month < 10 ? "0" + String(month) : String(month); // jan is month 1  
-  String dayStr = ++rawTime < 10 ? "0" + String(rawTime) : String(rawTime); // day of month  
-  return String(year) + "-" + monthStr + "-" + dayStr + "T" + timeClient->getFormattedTime() + "Z";
+  CIVILDATE date = civilFromDays(secs / 86400);
+  uint32_t seconds = secs % 86400;
+  char *cursor = writeDigits(buffer, date.year, 4);
+  *cursor++ = '-';
+  cursor = writeDigits(cursor, date.month, 2);
+  *cursor++ = '-';
+  cursor = writeDigits(cursor, date.day, 2);
+  *cursor++ = 'T';
+  cursor = writeDigits(cursor, seconds / 3600, 2);
+  *cursor++ = ':';
+  cursor = writeDigits(cursor, seconds / 60 % 60, 2);
+  *cursor++ = ':';
+  cursor = writeDigits(cursor, seconds % 60, 2);
+  *cursor++ = 'Z';
+  *cursor = '\0';
+  return cursor - buffer;
 }
 
 bool getLocalTime(struct tm * info, uint32_t ms) {
@@ -35,17 +35,56 @@
 
 #pragma once
 #include "esp32-hal.h"
-#include "NTPClient.h"
 #include "time.h"
 #include <Arduino.h>
 #include <sys/time.h>
-/**
-* @return secs argument (or 0 for current date) formatted to ISO 8601
-* like `2004-02-12T15:19:21+00:00`
-*/
 #define LEAP_YEAR(Y)( (Y>0) && !(Y%4) && ( (Y%100) || !(Y%400) ) )
+#define ISO8601_SIZE 21     // `2004-02-12T15:19:21Z` plus the terminator
+
+struct CIVILDATE {
+  int32_t year;
+  uint8_t month;            // 1 - 12
+  uint8_t day;              // 1 - 31
+};
+
+/**
+ * Days since 1970-01-01 of a proleptic Gregorian date, O(1).
+ * Based on http://howardhinnant.github.io/date_algorithms.html
+ */
+constexpr int32_t daysFromCivil(int32_t year, uint32_t month, uint32_t day) {
+  year -= month <= 2;
+  const int32_t era = (year >= 0 ? year : year - 399) / 400;
+  const uint32_t yearOfEra = (uint32_t)(year - era * 400);
+  const uint32_t dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  const uint32_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  return era * 146097 + (int32_t)dayOfEra - 719468;
+}
 
-String getFormattedDate(NTPClient *timeClient, unsigned long secs = 0);
+/** Inverse of daysFromCivil(), O(1) */
+constexpr CIVILDATE civilFromDays(int32_t days) {
+  days += 719468;
+  const int32_t era = (days >= 0 ? days : days - 146096) / 146097;
+  const uint32_t dayOfEra = (uint32_t)(days - era * 146097);
+  const uint32_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+  const uint32_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+  const uint32_t monthIndex = (5 * dayOfYear + 2) / 153;  // March based
+  const uint32_t month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+  return CIVILDATE {
+    (int32_t)yearOfEra + era * 400 + (month <= 2),
+    (uint8_t)month,
+    (uint8_t)(dayOfYear - (153 * monthIndex + 2) / 5 + 1)
+  };
+}
+
+static_assert(daysFromCivil(2021, 8, 8) == 18847, "daysFromCivil is broken");
+static_assert(civilFromDays(49709).year == 2106, "civilFromDays is broken");
+
+/**
+* Write secs formatted to ISO 8601 like `2004-02-12T15:19:21Z` into buffer,
+* no allocation involved.
+* @return characters written (without the terminator) or 0 if it doesn't fit
+*/
+size_t formatIso8601(char *buffer, size_t size, uint32_t secs);
 bool getLocalTime(struct tm * info, uint32_t ms);
 struct tm getTimeStruct();
 String getDateTime(bool mode);
\ No newline at end of file
@@ -0,0 +1,71 @@
+/**
+ * @file         : DhtDecoder.cpp
+ * @summary      : DHT pulse train decoder
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Decodes DHT21/DHT22 (AM2301/AM2302) frames from captured pulse widths
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "DhtDecoder.h"
+
+DhtStatus decodeDhtPulses(const DHTPULSE *pulses, size_t count, DHTREADING *reading) {
+  if (count == 0) {
+    return DHT_ERROR_TIMEOUT;
+  }
+  size_t start = 0;
+  while (start + 1 < count &&
+      !(pulses[start].level == 0 && pulses[start].micros >= DHT_RESPONSE_MIN &&
+        pulses[start + 1].level == 1 && pulses[start + 1].micros >= DHT_RESPONSE_MIN)) {
+    start++;
+  }
+  if (start + 1 >= count) {
+    return DHT_ERROR_NO_RESPONSE;
+  }
+  // Each bit is a ~50 us low followed by a high whose width is the value
+  uint8_t data[DHT_FRAME_BITS / 8] = { 0 };
+  size_t index = start + 2;
+  for (uint8_t bit = 0; bit < DHT_FRAME_BITS; bit++, index += 2) {
+    if (index + 1 >= count || pulses[index].level != 0 || pulses[index + 1].level != 1 ||
+        pulses[index + 1].micros > DHT_BIT_MAX) {
+      return DHT_ERROR_TRUNCATED;
+    }
+    data[bit / 8] = data[bit / 8] << 1 | (pulses[index + 1].micros > DHT_BIT_THRESHOLD);
+  }
+  if ((uint8_t)(data[0] + data[1] + data[2] + data[3]) != data[4]) {
+    return DHT_ERROR_CHECKSUM;
+  }
+  // Both values in tenths, temperature is sign and magnitude
+  reading->humidity = (data[0] << 8 | data[1]) / 10.0f;
+  reading->temperature = ((data[2] & 0x7F) << 8 | data[3]) / 10.0f;
+  if (data[2] & 0x80) {
+    reading->temperature = -reading->temperature;
+  }
+  return DHT_OK;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file         : DhtDecoder.h
+ * @summary      : DHT pulse train decoder
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Decodes DHT21/DHT22 (AM2301/AM2302) frames from captured pulse widths
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#define DHT_RESPONSE_MIN 60       // Sensor response low and high are ~80 us each
+#define DHT_BIT_THRESHOLD 48      // Data bit high: ~27 us for 0, ~70 us for 1
+#define DHT_BIT_MAX 100           // Anything longer isn't a data bit
+#define DHT_FRAME_BITS 40
+
+enum DhtStatus {
+  DHT_OK,
+  DHT_ERROR_TIMEOUT,        // Nothing captured
+  DHT_ERROR_NO_RESPONSE,    // No 80 us low / 80 us high response found
+  DHT_ERROR_TRUNCATED,      // Fewer than 40 bits, or a malformed bit
+  DHT_ERROR_CHECKSUM
+};
+
+struct DHTPULSE {
+  uint8_t level;            // Line level during the pulse
+  uint16_t micros;
+};
+
+struct DHTREADING {
+  float temperature;        // In degrees centigrade
+  float humidity;           // Relative humidity in percent
+};
+
+/**
+ * Decode a captured pulse train. Leading pulses before the sensor
+ * response (the tail of the start signal) are skipped.
+ * Pure C++ in a library of its own, so the native tests replay traces
+ * without pulling in the RMT driver.
+ */
+DhtStatus decodeDhtPulses(const DHTPULSE *pulses, size_t count, DHTREADING *reading);
@@ -0,0 +1,98 @@
+/**
+ * @file         : DhtReader.cpp
+ * @summary      : DHT sensor reader
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Non blocking DHT21/DHT22 acquisition through the ESP32 RMT receiver
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "DhtReader.h"
+
+DhtReader::DhtReader(uint8_t pin, rmt_channel_t channel) {
+  this->pin = (gpio_num_t)pin;
+  this->channel = channel;
+  this->ringbuffer = NULL;
+  this->startLock = portMUX_INITIALIZER_UNLOCKED;
+}
+
+bool DhtReader::begin() {
+  rmt_config_t config = {};
+  config.rmt_mode = RMT_MODE_RX;
+  config.channel = this->channel;
+  config.gpio_num = this->pin;
+  config.clk_div = 80;            // 1 us ticks
+  config.mem_block_num = 1;       // 64 items, two pulses each
+  config.rx_config.filter_en = true;
+  config.rx_config.filter_ticks_thresh = DHT_RMT_FILTER;
+  config.rx_config.idle_threshold = DHT_IDLE_THRESHOLD;
+  if (rmt_config(&config) != ESP_OK || rmt_driver_install(this->channel, 1024, 0) != ESP_OK) {
+    return false;
+  }
+  if (rmt_get_ringbuf_handle(this->channel, &this->ringbuffer) != ESP_OK) {
+    return false;
+  }
+  gpio_set_pull_mode(this->pin, GPIO_PULLUP_ONLY);
+  return true;
+}
+
+DhtStatus DhtReader::read(DHTREADING *reading) {
+  // Start signal, sleep through it instead of spinning
+  gpio_set_direction(this->pin, GPIO_MODE_INPUT_OUTPUT_OD);
+  gpio_set_level(this->pin, 0);
+  vTaskDelay(DHT_START_LOW / portTICK_PERIOD_MS + 1);
+  // Capture before the line goes up, the sensor answers 20 - 40 us after it
+  // does. Nothing may run in between, a low line held past
+  // DHT_IDLE_THRESHOLD would end the capture before the response
+  portENTER_CRITICAL(&this->startLock);
+  rmt_rx_start(this->channel, true);
+  gpio_set_level(this->pin, 1);
+  gpio_set_direction(this->pin, GPIO_MODE_INPUT);
+  portEXIT_CRITICAL(&this->startLock);
+  size_t size = 0;
+  rmt_item32_t *items = (rmt_item32_t *)xRingbufferReceive(this->ringbuffer, &size, DHT_CAPTURE_TIMEOUT / portTICK_PERIOD_MS);
+  rmt_rx_stop(this->channel);
+  if (items == NULL) {
+    return DHT_ERROR_TIMEOUT;
+  }
+  size_t count = 0;
+  for (size_t i = 0; i < size / sizeof(rmt_item32_t) && count + 2 <= DHT_MAX_PULSES; i++) {
+    // A zero duration marks the end of the capture
+    if (items[i].duration0 == 0) {
+      break;
+    }
+    this->pulses[count++] = { (uint8_t)items[i].level0, (uint16_t)items[i].duration0 };
+    if (items[i].duration1 == 0) {
+      break;
+    }
+    this->pulses[count++] = { (uint8_t)items[i].level1, (uint16_t)items[i].duration1 };
+  }
+  vRingbufferReturnItem(this->ringbuffer, items);
+  return decodeDhtPulses(this->pulses, count, reading);
+}
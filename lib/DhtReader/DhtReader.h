@@ -0,0 +1,67 @@
+/**
+ * @file         : DhtReader.h
+ * @summary      : DHT sensor reader
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Non blocking DHT21/DHT22 acquisition through the ESP32 RMT receiver
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#pragma once
+#include <Arduino.h>
+#include <driver/rmt.h>
+#include <driver/gpio.h>
+#include <freertos/ringbuf.h>
+#include "DhtDecoder.h"
+
+#define DHT_MAX_PULSES 96          // Start tail + response + 40 bits + end, with some slack
+#define DHT_START_LOW 2           // Host start signal (ms), the AM2301 wants at least 1 ms
+#define DHT_IDLE_THRESHOLD 150     // A quiet line this long ends the capture (us)
+#define DHT_RMT_FILTER 200         // Glitch filter (APB ticks, 2.5 us)
+#define DHT_CAPTURE_TIMEOUT 20     // Frame is ~5 ms long (ms)
+
+/**
+ * Reads the sensor with the RMT peripheral timestamping every edge, the
+ * calling task sleeps for the whole transfer and interrupts stay enabled,
+ * unlike the bit-banged driver.
+ */
+class DhtReader {
+  private:
+    gpio_num_t pin;
+    rmt_channel_t channel;
+    RingbufHandle_t ringbuffer;
+    portMUX_TYPE startLock;   // Keeps the capture start and the line release together
+    DHTPULSE pulses[DHT_MAX_PULSES];
+
+  public:
+    DhtReader(uint8_t pin, rmt_channel_t channel = RMT_CHANNEL_0);
+    bool begin();
+    /** Blocks the calling task (not the CPU) for about 10 ms */
+    DhtStatus read(DHTREADING *reading);
+};
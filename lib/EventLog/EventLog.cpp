@@ -0,0 +1,503 @@
+/**
+ * @file         : EventLog.cpp
+ * @summary      : Event log
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Append-only binary log of sensor samples and clock sync events on SD
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+#include "EventLog.h"
+
+EventLog::EventLog() {
+  this->fs = NULL;
+  this->lock = NULL;
+  this->next = 0;
+  this->flushed = 0;
+  this->firstSegment = 0;
+  this->indexSegment = 0;
+  this->pendingSince = 0;
+  this->flushPeriod = 0;
+  this->tailSlot = 0;
+  this->lastTime = 0;
+  this->lastMilliseconds = 0;
+  this->stats = { 0, 0, 0, 0 };
+  this->ready = false;
+  memset(this->index, 0, sizeof(this->index));
+}
+
+uint32_t EventLog::crc32(const uint8_t *data, size_t length) {
+  uint32_t crc = 0xFFFFFFFF;
+  while (length--) {
+    crc ^= *data++;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+  }
+  return ~crc;
+}
+
+void EventLog::segmentPath(char *path, uint32_t segment, const char *extension) {
+  sprintf(path, EVENTLOG_DIR "/%08lu.%s", (unsigned long)segment, extension);
+}
+
+bool EventLog::isValid(const EVENTLOGRECORD *record, uint32_t sequence) {
+  return record->sequence == sequence && record->crc == crc32((const uint8_t *)record, offsetof(EVENTLOGRECORD, crc));
+}
+
+uint8_t EventLog::countValid(const EVENTLOGRECORD *records, uint32_t start) {
+  uint8_t count = 0;
+  while (count < EVENTLOG_SECTOR_RECORDS && isValid(&records[count], start + count)) {
+    count++;
+  }
+  return count;
+}
+
+bool EventLog::readSector(uint32_t sector, EVENTLOGRECORD *records) {
+  char path[24];
+  size_t length = 0;
+  segmentPath(path, sector / EVENTLOG_SEGMENT_SECTORS, "log");
+  File file = this->fs->open(path, FILE_READ);
+  if (file) {
+    if (file.seek((sector % EVENTLOG_SEGMENT_SECTORS) * EVENTLOG_SECTOR_SIZE)) {
+      length = file.read((uint8_t *)records, EVENTLOG_SECTOR_SIZE);
+    }
+    file.close();
+  }
+  memset((uint8_t *)records + length, 0, EVENTLOG_SECTOR_SIZE - length);
+  return length == EVENTLOG_SECTOR_SIZE;
+}
+
+bool EventLog::writeSector(uint32_t sector, const EVENTLOGRECORD *records) {
+  char path[24];
+  segmentPath(path, sector / EVENTLOG_SEGMENT_SECTORS, "log");
+  // FILE_WRITE truncates. Sectors land once, whole, only one found torn
+  // by recover() is written over
+  File file = this->fs->open(path, this->fs->exists(path) ? "r+" : FILE_WRITE);
+  if (!file) {
+    return false;
+  }
+  bool written = file.seek((sector % EVENTLOG_SEGMENT_SECTORS) * EVENTLOG_SECTOR_SIZE) &&
+    file.write((const uint8_t *)records, EVENTLOG_SECTOR_SIZE) == EVENTLOG_SECTOR_SIZE;
+  // The new file size only reaches the card once the file is closed
+  file.close();
+  return written;
+}
+
+bool EventLog::readTail(uint8_t slot, EVENTLOGRECORD *records) {
+  size_t length = 0;
+  File file = this->fs->open(EVENTLOG_TAIL_PATH, FILE_READ);
+  if (file) {
+    if (file.seek(slot * EVENTLOG_SECTOR_SIZE)) {
+      length = file.read((uint8_t *)records, EVENTLOG_SECTOR_SIZE);
+    }
+    file.close();
+  }
+  memset((uint8_t *)records + length, 0, EVENTLOG_SECTOR_SIZE - length);
+  return length == EVENTLOG_SECTOR_SIZE;
+}
+
+bool EventLog::writeTail(uint8_t slot, const EVENTLOGRECORD *records) {
+  if (!this->fs->exists(EVENTLOG_TAIL_PATH)) {
+    // Laid out in full once, slots are only ever written in place after
+    uint8_t empty[EVENTLOG_SECTOR_SIZE] = {};
+    File file = this->fs->open(EVENTLOG_TAIL_PATH, FILE_WRITE);
+    if (!file) {
+      return false;
+    }
+    for (uint8_t i = 0; i < EVENTLOG_TAIL_SLOTS; i++) {
+      file.write(empty, EVENTLOG_SECTOR_SIZE);
+    }
+    file.close();
+  }
+  File file = this->fs->open(EVENTLOG_TAIL_PATH, "r+");
+  if (!file) {
+    return false;
+  }
+  bool written = file.seek(slot * EVENTLOG_SECTOR_SIZE) &&
+    file.write((const uint8_t *)records, EVENTLOG_SECTOR_SIZE) == EVENTLOG_SECTOR_SIZE;
+  file.close();
+  return written;
+}
+
+bool EventLog::readRecord(uint32_t sequence, EVENTLOGRECORD *record) {
+  char path[24];
+  size_t length = 0;
+  segmentPath(path, sequence / EVENTLOG_SEGMENT_RECORDS, "log");
+  File file = this->fs->open(path, FILE_READ);
+  if (file) {
+    if (file.seek((sequence % EVENTLOG_SEGMENT_RECORDS) * sizeof(EVENTLOGRECORD))) {
+      length = file.read((uint8_t *)record, sizeof(EVENTLOGRECORD));
+    }
+    file.close();
+  }
+  return length == sizeof(EVENTLOGRECORD) && isValid(record, sequence);
+}
+
+void EventLog::loadIndex(uint32_t segment, uint32_t *index, uint32_t end) {
+  char path[24];
+  segmentPath(path, segment, "idx");
+  File file = this->fs->open(path, FILE_READ);
+  if (file) {
+    size_t length = file.read((uint8_t *)index, EVENTLOG_SECTOR_SIZE);
+    file.close();
+    if (length == EVENTLOG_SECTOR_SIZE) {
+      return;
+    }
+  }
+  // Not sealed yet, or the power went while it was, one read per block
+  EVENTLOGRECORD record;
+  for (uint32_t block = 0; block < EVENTLOG_INDEX_ENTRIES; block++) {
+    uint32_t head = segment * EVENTLOG_SEGMENT_RECORDS + block * EVENTLOG_INDEX_STRIDE * EVENTLOG_SECTOR_RECORDS;
+    index[block] = head < end && this->readRecord(head, &record) ? record.time : 0;
+  }
+}
+
+void EventLog::sealSegment(uint32_t segment) {
+  char path[24];
+  segmentPath(path, segment, "idx");
+  File file = this->fs->open(path, FILE_WRITE);
+  if (file) {
+    file.write((const uint8_t *)this->index, EVENTLOG_SECTOR_SIZE);
+    file.close();
+  }
+  xSemaphoreTake(this->lock, portMAX_DELAY);
+  memset(this->index, 0, sizeof(this->index));
+  this->indexSegment = segment + 1;
+  xSemaphoreGive(this->lock);
+  // Make room for the segment about to be opened
+  while (segment + 2 > this->firstSegment + EVENTLOG_MAX_SEGMENTS) {
+    xSemaphoreTake(this->lock, portMAX_DELAY);
+    uint32_t oldest = this->firstSegment++;
+    xSemaphoreGive(this->lock);
+    segmentPath(path, oldest, "log");
+    this->fs->remove(path);
+    segmentPath(path, oldest, "idx");
+    this->fs->remove(path);
+  }
+}
+
+void EventLog::recover(uint32_t segment) {
+  char path[24];
+  segmentPath(path, segment, "log");
+  File file = this->fs->open(path, FILE_READ);
+  uint32_t sectors = 0;
+  if (file) {
+    sectors = file.size() / EVENTLOG_SECTOR_SIZE;
+    file.close();
+  }
+  if (sectors > EVENTLOG_SEGMENT_SECTORS) {
+    sectors = EVENTLOG_SEGMENT_SECTORS;
+  }
+  // Sectors reach the segment whole and in order, only the last one can be
+  // torn. The open sector, that one or the next, may also be in the tail.
+  EVENTLOGRECORD records[EVENTLOG_SECTOR_RECORDS];
+  EVENTLOGRECORD best[EVENTLOG_SECTOR_RECORDS];
+  uint8_t count = 0;
+  bool inTail = false;
+  uint32_t sector = segment * EVENTLOG_SEGMENT_SECTORS + sectors;
+  if (sectors > 0) {
+    this->readSector(sector - 1, records);
+    uint8_t valid = countValid(records, (sector - 1) * EVENTLOG_SECTOR_RECORDS);
+    if (valid < EVENTLOG_SECTOR_RECORDS) {
+      sector--;
+      memcpy(best, records, sizeof(best));
+      count = valid;
+    } else {
+      this->lastTime = records[valid - 1].time;
+      this->lastMilliseconds = records[valid - 1].milliseconds;
+    }
+  }
+  uint32_t start = sector * EVENTLOG_SECTOR_RECORDS;
+  for (uint8_t slot = 0; slot < EVENTLOG_TAIL_SLOTS; slot++) {
+    this->readTail(slot, records);
+    uint8_t valid = countValid(records, start);
+    if (valid > count) {
+      memcpy(best, records, sizeof(best));
+      count = valid;
+      inTail = true;
+      this->tailSlot = (slot + 1) % EVENTLOG_TAIL_SLOTS;
+    }
+  }
+  if (count > 0) {
+    memset(&best[count], 0, (EVENTLOG_SECTOR_RECORDS - count) * sizeof(EVENTLOGRECORD));
+    this->lastTime = best[count - 1].time;
+    this->lastMilliseconds = best[count - 1].milliseconds;
+  }
+  // Keep the good part in RAM, it goes to the segment with the rest of the sector
+  for (uint8_t i = 0; i < count; i++) {
+    this->buffer[(start + i) % EVENTLOG_BUFFER_RECORDS] = best[i];
+  }
+  this->next = start + count;
+  this->flushed = this->next;
+  if (count > 0 && !inTail) {
+    // The torn segment sector is about to be written over, copy what it
+    // still has to the tail first
+    if (this->writeTail(this->tailSlot, best)) {
+      this->tailSlot = (this->tailSlot + 1) % EVENTLOG_TAIL_SLOTS;
+    }
+  }
+  this->indexSegment = segment;
+  this->loadIndex(segment, this->index, this->next);
+}
+
+bool EventLog::begin(fs::FS &fs, unsigned long flushPeriod) {
+  this->fs = &fs;
+  this->flushPeriod = flushPeriod;
+  this->lock = xSemaphoreCreateMutex();
+  if (this->lock == NULL) {
+    return false;
+  }
+  if (!fs.exists(EVENTLOG_DIR) && !fs.mkdir(EVENTLOG_DIR)) {
+    return false;
+  }
+  File dir = fs.open(EVENTLOG_DIR);
+  if (!dir || !dir.isDirectory()) {
+    return false;
+  }
+  bool found = false;
+  uint32_t first = 0, last = 0;
+  File entry;
+  while ((entry = dir.openNextFile())) {
+    // Older cores report the full path
+    const char *name = strrchr(entry.name(), '/');
+    name = name != NULL ? name + 1 : entry.name();
+    char *extension;
+    uint32_t segment = strtoul(name, &extension, 10);
+    if (extension != name && strcmp(extension, ".log") == 0) {
+      first = !found || segment < first ? segment : first;
+      last = !found || segment > last ? segment : last;
+      found = true;
+    }
+    entry.close();
+  }
+  dir.close();
+  this->firstSegment = first;
+  // Even without a segment the first sector may be in the tail
+  this->recover(last);
+  this->pendingSince = millis();
+  this->ready = true;
+  return true;
+}
+
+bool EventLog::append(EventLogType type, uint8_t flags, const EVENTLOGPAYLOAD *payload) {
+  if (!this->ready) {
+    return false;
+  }
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  xSemaphoreTake(this->lock, portMAX_DELAY);
+  // The sector being flushed stays in RAM until it is complete
+  if (this->next - (this->flushed - this->flushed % EVENTLOG_SECTOR_RECORDS) >= EVENTLOG_BUFFER_RECORDS) {
+    this->stats.dropped++;
+    xSemaphoreGive(this->lock);
+    return false;
+  }
+  EVENTLOGRECORD *record = &this->buffer[this->next % EVENTLOG_BUFFER_RECORDS];
+  record->sequence = this->next;
+  uint32_t time = tv.tv_sec;
+  uint16_t milliseconds = tv.tv_usec / 1000;
+  if (time < this->lastTime || (time == this->lastTime && milliseconds < this->lastMilliseconds)) {
+    // Stepped back, hold the last stamp rather than break the time order
+    time = this->lastTime;
+    milliseconds = this->lastMilliseconds;
+  }
+  this->lastTime = time;
+  this->lastMilliseconds = milliseconds;
+  record->time = time;
+  record->milliseconds = milliseconds;
+  record->type = type;
+  record->flags = flags;
+  record->payload = *payload;
+  record->crc = crc32((const uint8_t *)record, offsetof(EVENTLOGRECORD, crc));
+  if (this->next == this->flushed) {
+    this->pendingSince = millis();
+  }
+  this->next++;
+  this->stats.records++;
+  xSemaphoreGive(this->lock);
+  return true;
+}
+
+bool EventLog::flush(bool force) {
+  if (!this->ready) {
+    return false;
+  }
+  EVENTLOGRECORD records[EVENTLOG_SECTOR_RECORDS];
+  while (true) {
+    xSemaphoreTake(this->lock, portMAX_DELAY);
+    uint32_t start = this->flushed - this->flushed % EVENTLOG_SECTOR_RECORDS;
+    uint32_t end = this->next < start + EVENTLOG_SECTOR_RECORDS ? this->next : start + EVENTLOG_SECTOR_RECORDS;
+    bool due = end == start + EVENTLOG_SECTOR_RECORDS || force || millis() - this->pendingSince >= this->flushPeriod;
+    if (end == this->flushed || !due) {
+      xSemaphoreGive(this->lock);
+      return true;
+    }
+    memset(records, 0, sizeof(records));
+    for (uint32_t sequence = start; sequence < end; sequence++) {
+      records[sequence - start] = this->buffer[sequence % EVENTLOG_BUFFER_RECORDS];
+    }
+    bool full = end == start + EVENTLOG_SECTOR_RECORDS;
+    xSemaphoreGive(this->lock);
+
+    uint32_t sector = start / EVENTLOG_SECTOR_RECORDS;
+    if (full && sector % EVENTLOG_SEGMENT_SECTORS == 0 && sector / EVENTLOG_SEGMENT_SECTORS > this->indexSegment) {
+      this->sealSegment(sector / EVENTLOG_SEGMENT_SECTORS - 1);
+    }
+    bool written = full ? this->writeSector(sector, records) : this->writeTail(this->tailSlot, records);
+
+    xSemaphoreTake(this->lock, portMAX_DELAY);
+    if (!written) {
+      // Try again in a flush period, the records keep piling up in RAM meanwhile
+      this->stats.failed++;
+      this->pendingSince = millis();
+      xSemaphoreGive(this->lock);
+      return false;
+    }
+    if (!full) {
+      // A failed write leaves the slot as is, it is tried again
+      this->tailSlot = (this->tailSlot + 1) % EVENTLOG_TAIL_SLOTS;
+    } else if (sector % EVENTLOG_INDEX_STRIDE == 0) {
+      this->index[sector % EVENTLOG_SEGMENT_SECTORS / EVENTLOG_INDEX_STRIDE] = records[0].time;
+    }
+    this->flushed = end;
+    this->stats.sectors++;
+    if (this->next > this->flushed) {
+      this->pendingSince = millis();
+    }
+    xSemaphoreGive(this->lock);
+  }
+}
+
+bool EventLog::fetch(EVENTLOGCURSOR *cursor, EVENTLOGRECORD *record) {
+  uint32_t sequence = cursor->sequence;
+  xSemaphoreTake(this->lock, portMAX_DELAY);
+  // The open sector is whole in RAM, the segment doesn't have it yet
+  if (sequence >= this->flushed - this->flushed % EVENTLOG_SECTOR_RECORDS && sequence < this->next) {
+    *record = this->buffer[sequence % EVENTLOG_BUFFER_RECORDS];
+    xSemaphoreGive(this->lock);
+    return isValid(record, sequence);
+  }
+  xSemaphoreGive(this->lock);
+  uint32_t sector = sequence / EVENTLOG_SECTOR_RECORDS;
+  EVENTLOGRECORD *cached = &cursor->records[sequence % EVENTLOG_SECTOR_RECORDS];
+  // A sector found torn at recovery may have been written whole since
+  if (!cursor->loaded || cursor->sector != sector || !isValid(cached, sequence)) {
+    this->readSector(sector, cursor->records);
+    cursor->sector = sector;
+    cursor->loaded = true;
+  }
+  *record = *cached;
+  return isValid(record, sequence);
+}
+
+bool EventLog::seek(uint32_t from, EVENTLOGCURSOR *cursor) {
+  if (!this->ready) {
+    return false;
+  }
+  xSemaphoreTake(this->lock, portMAX_DELAY);
+  uint32_t end = this->next;
+  uint32_t first = this->firstSegment;
+  xSemaphoreGive(this->lock);
+  cursor->loaded = false;
+  cursor->sequence = first * EVENTLOG_SEGMENT_RECORDS;
+  if (cursor->sequence >= end) {
+    cursor->sequence = end;
+    return true;
+  }
+  // Segments are in time order, find the last one starting at or before `from`
+  EVENTLOGRECORD record;
+  uint32_t low = first;
+  uint32_t high = (end - 1) / EVENTLOG_SEGMENT_RECORDS;
+  while (low < high) {
+    uint32_t middle = low + (high - low + 1) / 2;
+    cursor->sequence = middle * EVENTLOG_SEGMENT_RECORDS;
+    if (this->fetch(cursor, &record) && record.time <= from) {
+      low = middle;
+    } else {
+      high = middle - 1;
+    }
+  }
+  uint32_t index[EVENTLOG_INDEX_ENTRIES];
+  xSemaphoreTake(this->lock, portMAX_DELAY);
+  bool open = low == this->indexSegment;
+  if (open) {
+    memcpy(index, this->index, sizeof(index));
+  }
+  xSemaphoreGive(this->lock);
+  if (!open) {
+    this->loadIndex(low, index, end);
+  }
+  // Then the last indexed block starting at or before it, and scan from there
+  uint32_t block = 0;
+  while (block + 1 < EVENTLOG_INDEX_ENTRIES && index[block + 1] != 0 && index[block + 1] <= from) {
+    block++;
+  }
+  cursor->sequence = low * EVENTLOG_SEGMENT_RECORDS + block * EVENTLOG_INDEX_STRIDE * EVENTLOG_SECTOR_RECORDS;
+  while (cursor->sequence < end) {
+    if (this->fetch(cursor, &record) && record.time >= from) {
+      break;
+    }
+    cursor->sequence++;
+  }
+  return true;
+}
+
+bool EventLog::read(EVENTLOGCURSOR *cursor, EVENTLOGRECORD *record) {
+  if (!this->ready) {
+    return false;
+  }
+  while (true) {
+    xSemaphoreTake(this->lock, portMAX_DELAY);
+    uint32_t end = this->next;
+    uint32_t start = this->firstSegment * EVENTLOG_SEGMENT_RECORDS;
+    xSemaphoreGive(this->lock);
+    if (cursor->sequence < start) {
+      // Deleted while we were reading
+      cursor->sequence = start;
+    }
+    if (cursor->sequence >= end) {
+      return false;
+    }
+    bool valid = this->fetch(cursor, record);
+    cursor->sequence++;
+    if (valid) {
+      return true;
+    }
+  }
+}
+
+EVENTLOGSTATS EventLog::getStats() {
+  if (this->lock == NULL) {
+    return this->stats;
+  }
+  xSemaphoreTake(this->lock, portMAX_DELAY);
+  EVENTLOGSTATS stats = this->stats;
+  xSemaphoreGive(this->lock);
+  return stats;
+}
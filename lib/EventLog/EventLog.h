@@ -0,0 +1,170 @@
+/**
+ * @file         : EventLog.h
+ * @summary      : Event log
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Append-only binary log of sensor samples and clock sync events on SD
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+#pragma once
+#include <Arduino.h>
+#include <FS.h>
+#include <sys/time.h>
+
+#define EVENTLOG_DIR "/log"
+#define EVENTLOG_TAIL_PATH EVENTLOG_DIR "/tail.bin"
+#define EVENTLOG_TAIL_SLOTS 2             // Partial sector copies, written in turn
+#define EVENTLOG_SECTOR_SIZE 512
+#define EVENTLOG_SECTOR_RECORDS 16        // 32 byte records
+#define EVENTLOG_BUFFER_SECTORS 2         // Sectors held in RAM while the card is busy
+#define EVENTLOG_BUFFER_RECORDS (EVENTLOG_BUFFER_SECTORS * EVENTLOG_SECTOR_RECORDS)
+#define EVENTLOG_SEGMENT_SECTORS 2048     // 1 MiB segment files
+#define EVENTLOG_SEGMENT_RECORDS (EVENTLOG_SEGMENT_SECTORS * EVENTLOG_SECTOR_RECORDS)
+#define EVENTLOG_INDEX_STRIDE 16          // Sectors per index entry
+#define EVENTLOG_INDEX_ENTRIES (EVENTLOG_SEGMENT_SECTORS / EVENTLOG_INDEX_STRIDE)
+#define EVENTLOG_MAX_SEGMENTS 64          // Older segments are deleted
+
+enum EventLogType {
+  EVENTLOG_SENSOR = 1,      // Filtered DHT reading
+  EVENTLOG_SYNC             // NTP sample and the adjustment made, flags hold the ClockAdjustmentType
+};
+
+union EVENTLOGPAYLOAD {
+  struct {
+    float temperature;
+    float humidity;
+  } sensor;
+  struct {
+    float offset;           // Reference minus local time (s)
+    float roundTrip;        // In s
+    float residual;         // In s
+    float frequency;        // In ppm
+  } sync;
+  uint8_t bytes[16];
+};
+
+struct EVENTLOGRECORD {
+  uint32_t sequence;        // Position in the log, also tells torn sectors from stale ones
+  uint32_t time;            // Epoch (s)
+  uint16_t milliseconds;
+  uint8_t type;
+  uint8_t flags;
+  EVENTLOGPAYLOAD payload;
+  uint32_t crc;             // CRC-32 of everything above
+};
+
+static_assert(sizeof(EVENTLOGRECORD) * EVENTLOG_SECTOR_RECORDS == EVENTLOG_SECTOR_SIZE, "Records must tile a sector");
+static_assert(EVENTLOG_INDEX_ENTRIES * sizeof(uint32_t) == EVENTLOG_SECTOR_SIZE, "Segment index must fit a sector");
+
+/** Read position for range queries */
+struct EVENTLOGCURSOR {
+  uint32_t sequence;
+  uint32_t sector;          // Sector held in `records`
+  bool loaded;
+  EVENTLOGRECORD records[EVENTLOG_SECTOR_RECORDS];
+};
+
+struct EVENTLOGSTATS {
+  uint32_t records;
+  uint32_t sectors;         // Sector writes, partial sectors count every time they are written to a tail slot
+  uint32_t dropped;         // Records lost because the buffer was full
+  uint32_t failed;          // Sector writes that did not make it to the card
+};
+
+/**
+ * Fixed size records go to segment files of EVENTLOG_SEGMENT_RECORDS each,
+ * named after the segment number, so a record sequence number alone says
+ * which file and offset it lives at.
+ *
+ * append() only touches RAM. flush() writes each sector to its segment
+ * once, whole, at a sector aligned offset. A partial sector that has waited
+ * for the flush period goes to one of the two slots of the tail file
+ * instead, taking turns, so the slot being written never holds the only
+ * copy of records already on the card. Every record carries its sequence
+ * number and a CRC, begin() takes the longest good run of the open sector
+ * from its segment copy and the tail slots. A power cut costs the records
+ * still in RAM and nothing that a flush() had reported written.
+ *
+ * Record times never go backwards, seek() and the index rely on it. After
+ * the clock is stepped back records keep the last time stamped until the
+ * clock catches up with it.
+ *
+ * Each segment has an index of the first record time of every
+ * EVENTLOG_INDEX_STRIDE sectors, kept in RAM for the open segment and
+ * written next to it once full, seek() uses it to skip straight to the
+ * right block.
+ */
+class EventLog {
+  private:
+    fs::FS *fs;
+    SemaphoreHandle_t lock;
+    EVENTLOGRECORD buffer[EVENTLOG_BUFFER_RECORDS];  // Indexed by sequence
+    uint32_t next;              // Sequence of the next record
+    uint32_t flushed;           // Records below this are on the card
+    uint32_t firstSegment;      // Oldest segment on the card
+    uint32_t index[EVENTLOG_INDEX_ENTRIES];  // Of the segment being written, 0 where unknown
+    uint32_t indexSegment;
+    unsigned long pendingSince; // millis() the oldest record not on the card was added
+    unsigned long flushPeriod;  // In ms
+    uint8_t tailSlot;           // Next tail slot to write, never the one with the newest copy
+    uint32_t lastTime;          // Stamp of the newest record, appends never go below it
+    uint16_t lastMilliseconds;
+    EVENTLOGSTATS stats;
+    bool ready;
+    static uint32_t crc32(const uint8_t *data, size_t length);
+    static void segmentPath(char *path, uint32_t segment, const char *extension);
+    static bool isValid(const EVENTLOGRECORD *record, uint32_t sequence);
+    bool readSector(uint32_t sector, EVENTLOGRECORD *records);
+    bool writeSector(uint32_t sector, const EVENTLOGRECORD *records);
+    bool readTail(uint8_t slot, EVENTLOGRECORD *records);
+    bool writeTail(uint8_t slot, const EVENTLOGRECORD *records);
+    static uint8_t countValid(const EVENTLOGRECORD *records, uint32_t start);
+    bool readRecord(uint32_t sequence, EVENTLOGRECORD *record);
+    void loadIndex(uint32_t segment, uint32_t *index, uint32_t end);
+    void sealSegment(uint32_t segment);
+    void recover(uint32_t segment);
+    bool fetch(EVENTLOGCURSOR *cursor, EVENTLOGRECORD *record);
+
+  public:
+    EventLog();
+    /**
+     * Find the end of the log on `fs` and recover from a torn last write,
+     * `flushPeriod` is how long a partial sector may wait in RAM (ms).
+     */
+    bool begin(fs::FS &fs, unsigned long flushPeriod);
+    /** Add a record stamped with the current time, never blocks on the card */
+    bool append(EventLogType type, uint8_t flags, const EVENTLOGPAYLOAD *payload);
+    /** Write out full sectors, and the partial one once it is due */
+    bool flush(bool force = false);
+    /** Point `cursor` at the first record at or after `from` (epoch s) */
+    bool seek(uint32_t from, EVENTLOGCURSOR *cursor);
+    /** @return false at the end of the log */
+    bool read(EVENTLOGCURSOR *cursor, EVENTLOGRECORD *record);
+    EVENTLOGSTATS getStats();
+};
@@ -0,0 +1,101 @@
+/**
+ * @file         : FrameDiff.cpp
+ * @summary      : Frame buffer diff
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Dirty page and column tracking against the last frame sent to a paged display
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "FrameDiff.h"
+
+FrameDiff::FrameDiff(uint8_t width, uint8_t height) {
+  this->width = width < FRAMEDIFF_MAX_WIDTH ? width : FRAMEDIFF_MAX_WIDTH;
+  this->pages = (height + 7) / 8 < FRAMEDIFF_MAX_PAGES ? (height + 7) / 8 : FRAMEDIFF_MAX_PAGES;
+  memset(this->shadow, 0, sizeof(this->shadow));
+  this->invalidate();
+  this->resetStats();
+}
+
+void FrameDiff::invalidate() {
+  this->forcedPages = 0xFF;
+}
+
+bool FrameDiff::isDirty(const uint8_t *frame, uint16_t offset) {
+  return (this->forcedPages & (1 << (offset / this->width))) || frame[offset] != this->shadow[offset];
+}
+
+bool FrameDiff::next(const uint8_t *frame, uint16_t *cursor, FRAMESPAN *span) {
+  uint16_t size = this->width * this->pages;
+  uint16_t start = *cursor;
+  while (start < size && !this->isDirty(frame, start)) {
+    start++;
+  }
+  if (start >= size) {
+    *cursor = size;
+    return false;
+  }
+  // Spans never cross a page, the display wraps to the start column of the
+  // same page at the end of the column range
+  uint16_t pageEnd = (start / this->width + 1) * this->width;
+  uint16_t last = start;
+  for (uint16_t offset = start + 1; offset < pageEnd && offset - last <= FRAMEDIFF_SPAN_GAP; offset++) {
+    if (this->isDirty(frame, offset)) {
+      last = offset;
+    }
+  }
+  span->page = start / this->width;
+  span->first = start % this->width;
+  span->last = last % this->width;
+  *cursor = last + 1;
+  return true;
+}
+
+void FrameDiff::commit(const uint8_t *frame, FRAMESPAN span) {
+  uint16_t offset = span.page * this->width + span.first;
+  uint8_t length = span.last - span.first + 1;
+  memcpy(this->shadow + offset, frame + offset, length);
+  if (span.first == 0 && span.last == this->width - 1) {
+    this->forcedPages &= ~(1 << span.page);
+  }
+  this->stats.spans++;
+  this->stats.bytes += length;
+}
+
+void FrameDiff::frameSent() {
+  this->stats.frames++;
+}
+
+FRAMEDIFFSTATS FrameDiff::getStats() {
+  return this->stats;
+}
+
+void FrameDiff::resetStats() {
+  this->stats = { 0, 0, 0 };
+}
@@ -0,0 +1,88 @@
+/**
+ * @file         : FrameDiff.h
+ * @summary      : Frame buffer diff
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Dirty page and column tracking against the last frame sent to a paged display
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+#define FRAMEDIFF_MAX_WIDTH 128
+#define FRAMEDIFF_MAX_PAGES 8       // 64 rows, 8 rows per page
+#define FRAMEDIFF_SPAN_GAP 8        // Unchanged bytes worth resending to avoid a new addressing command
+
+struct FRAMESPAN {
+  uint8_t page;
+  uint8_t first;            // First column
+  uint8_t last;             // Last column, inclusive
+};
+
+struct FRAMEDIFFSTATS {
+  uint32_t frames;          // Frames that had anything to send
+  uint32_t spans;
+  uint32_t bytes;           // Frame data bytes sent
+};
+
+/**
+ * Keeps a copy of the frame the display last acknowledged and walks the
+ * new frame in SSD1306 page order, returning the column spans that
+ * changed. Changed bytes less than FRAMEDIFF_SPAN_GAP apart are merged
+ * into one span, re-sending a few unchanged bytes is cheaper than another
+ * page/column address command.
+ */
+class FrameDiff {
+  private:
+    uint8_t width;
+    uint8_t pages;
+    uint8_t shadow[FRAMEDIFF_MAX_WIDTH * FRAMEDIFF_MAX_PAGES];
+    uint8_t forcedPages;      // Pages whose display content is unknown, one bit per page
+    FRAMEDIFFSTATS stats;
+    bool isDirty(const uint8_t *frame, uint16_t offset);
+
+  public:
+    FrameDiff(uint8_t width, uint8_t height);
+    /** Forget what the display shows, the next pass resends every page */
+    void invalidate();
+    /**
+     * Find the next changed span at or after `cursor`, a byte offset into
+     * the frame that starts at 0 and is advanced past the returned span.
+     * @return false when the rest of the frame is unchanged
+     */
+    bool next(const uint8_t *frame, uint16_t *cursor, FRAMESPAN *span);
+    /** Record `span` of `frame` as shown, call once it reached the display */
+    void commit(const uint8_t *frame, FRAMESPAN span);
+    /** Count a frame with at least one span sent */
+    void frameSent();
+    FRAMEDIFFSTATS getStats();
+    void resetStats();
+};
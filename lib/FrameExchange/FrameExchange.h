@@ -0,0 +1,100 @@
+/**
+ * @file         : FrameExchange.h
+ * @summary      : Frame exchange
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Lock-free latest-frame handoff between a render task and a flush task
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+
+#define FRAME_EXCHANGE_FRESH 0x04   // Set on the spare slot index when it holds an unread frame
+#define FRAME_EXCHANGE_INDEX 0x03
+
+/**
+ * One writer, one reader, neither ever waits for the other. The writer
+ * renders into the back frame and publish() swaps it with the spare slot,
+ * the reader acquire()s the spare slot into its front frame when there is
+ * a fresh one. A frame published before the previous one was picked up
+ * replaces it, the reader always gets the newest frame.
+ *
+ * This is double buffering plus the spare slot the swap goes through,
+ * which is what lets the writer keep drawing while the front frame is
+ * still on its way to the display.
+ */
+template <size_t SIZE>
+class FrameExchange {
+  private:
+    uint8_t frames[3][SIZE];
+    uint8_t back;                   // Owned by the writer
+    uint8_t front;                  // Owned by the reader
+    std::atomic<uint32_t> spare;    // Slot index | FRAME_EXCHANGE_FRESH
+    std::atomic<uint32_t> dropped;  // Frames replaced before the reader got them
+
+  public:
+    FrameExchange() : back(0), front(1), spare(2), dropped(0) {
+      memset(this->frames, 0, sizeof(this->frames));
+    }
+
+    uint8_t *getBack() {
+      return this->frames[this->back];
+    }
+
+    /** Hand the back frame to the reader and get the spare slot to draw the next one */
+    void publish() {
+      uint32_t previous = this->spare.exchange(this->back | FRAME_EXCHANGE_FRESH, std::memory_order_acq_rel);
+      if (previous & FRAME_EXCHANGE_FRESH) {
+        this->dropped.fetch_add(1, std::memory_order_relaxed);
+      }
+      this->back = previous & FRAME_EXCHANGE_INDEX;
+    }
+
+    /** @return true when a new frame was moved to the front */
+    bool acquire() {
+      if (!(this->spare.load(std::memory_order_acquire) & FRAME_EXCHANGE_FRESH)) {
+        return false;
+      }
+      this->front = this->spare.exchange(this->front, std::memory_order_acq_rel) & FRAME_EXCHANGE_INDEX;
+      return true;
+    }
+
+    const uint8_t *getFront() {
+      return this->frames[this->front];
+    }
+
+    /** @return frames dropped since the last call */
+    uint32_t getDropped() {
+      return this->dropped.exchange(0, std::memory_order_relaxed);
+    }
+};
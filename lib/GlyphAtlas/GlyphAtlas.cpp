@@ -0,0 +1,103 @@
+/**
+ * @file         : GlyphAtlas.cpp
+ * @summary      : Glyph atlas
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Pre-rendered font glyphs in SSD1306 page format, blitted straight into the frame buffer
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "GlyphAtlas.h"
+
+GlyphAtlas::GlyphAtlas() {
+  this->scale = 1;
+  this->count = 0;
+  memset(this->index, 0, sizeof(this->index));
+  memset(this->glyphs, 0, sizeof(this->glyphs));
+}
+
+bool GlyphAtlas::begin(const char *charset, uint8_t scale) {
+  this->scale = scale < 1 ? 1 : scale > GLYPH_MAX_SCALE ? GLYPH_MAX_SCALE : scale;
+  uint8_t width = this->getWidth();
+  uint8_t pages = this->getPages();
+  GFXcanvas1 canvas(width, pages * GLYPH_HEIGHT);
+  if (canvas.getBuffer() == NULL) {
+    return false;
+  }
+  for (const char *c = charset; *c != '\0' && this->count < GLYPH_MAX_COUNT; c++) {
+    if (*c < GLYPH_FIRST_CHAR || *c > GLYPH_LAST_CHAR || this->index[*c - GLYPH_FIRST_CHAR] != 0) {
+      continue;
+    }
+    canvas.fillScreen(0);
+    canvas.drawChar(0, 0, *c, 1, 0, this->scale);
+    uint8_t *glyph = this->glyphs[this->count];
+    for (uint8_t page = 0; page < pages; page++) {
+      for (uint8_t x = 0; x < width; x++) {
+        uint8_t column = 0;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+          column |= canvas.getPixel(x, page * 8 + bit) << bit;
+        }
+        glyph[page * width + x] = column;
+      }
+    }
+    this->index[*c - GLYPH_FIRST_CHAR] = ++this->count;
+  }
+  return true;
+}
+
+uint8_t GlyphAtlas::getWidth() {
+  return GLYPH_WIDTH * this->scale;
+}
+
+uint8_t GlyphAtlas::getPages() {
+  return GLYPH_HEIGHT / 8 * this->scale;
+}
+
+int16_t GlyphAtlas::draw(uint8_t *frame, uint8_t frameWidth, uint8_t framePages, uint8_t page, int16_t x, const char *text) {
+  uint8_t width = this->getWidth();
+  uint8_t pages = this->getPages();
+  for (const char *c = text; *c != '\0'; c++, x += width) {
+    // Clip to the frame
+    int16_t first = x < 0 ? -x : 0;
+    int16_t last = x + width > frameWidth ? frameWidth - x : width;
+    if (first >= last) {
+      continue;
+    }
+    uint8_t glyph = *c >= GLYPH_FIRST_CHAR && *c <= GLYPH_LAST_CHAR ? this->index[*c - GLYPH_FIRST_CHAR] : 0;
+    for (uint8_t row = 0; row < pages && page + row < framePages; row++) {
+      uint8_t *target = frame + (page + row) * frameWidth + x + first;
+      if (glyph == 0) {
+        memset(target, 0, last - first);
+      } else {
+        memcpy(target, this->glyphs[glyph - 1] + row * width + first, last - first);
+      }
+    }
+  }
+  return x;
+}
@@ -0,0 +1,76 @@
+/**
+ * @file         : GlyphAtlas.h
+ * @summary      : Glyph atlas
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Pre-rendered font glyphs in SSD1306 page format, blitted straight into the frame buffer
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#pragma once
+#include <Arduino.h>
+#include <Adafruit_GFX.h>
+
+#define GLYPH_WIDTH 6               // Classic GFX font, 5 columns plus spacing
+#define GLYPH_HEIGHT 8
+#define GLYPH_MAX_SCALE 2
+#define GLYPH_MAX_COUNT 16
+#define GLYPH_SIZE (GLYPH_WIDTH * GLYPH_HEIGHT / 8 * GLYPH_MAX_SCALE * GLYPH_MAX_SCALE)
+#define GLYPH_FIRST_CHAR 0x20
+#define GLYPH_LAST_CHAR 0x7E
+
+/**
+ * Rasterizes a small character set once at boot with the same font and
+ * scale Adafruit_GFX print() would use and keeps it as page aligned
+ * columns (LSB = top row), the SSD1306 frame buffer layout. Drawing text
+ * is then a memcpy per glyph page, at a page aligned row only.
+ */
+class GlyphAtlas {
+  private:
+    uint8_t scale;
+    uint8_t count;
+    uint8_t index[GLYPH_LAST_CHAR - GLYPH_FIRST_CHAR + 1];  // Glyph + 1, 0 if not in the atlas
+    uint8_t glyphs[GLYPH_MAX_COUNT][GLYPH_SIZE];
+
+  public:
+    GlyphAtlas();
+    /** Render `charset`, characters past GLYPH_MAX_COUNT are left out */
+    bool begin(const char *charset, uint8_t scale = 1);
+    /** @return glyph width in pixels */
+    uint8_t getWidth();
+    /** @return glyph height in pages */
+    uint8_t getPages();
+    /**
+     * Copy `text` into `frame`, a `frameWidth` x `framePages` SSD1306
+     * buffer, starting at column `x` of page `page`. Characters missing
+     * from the atlas are drawn blank.
+     * @return column right after the last glyph
+     */
+    int16_t draw(uint8_t *frame, uint8_t frameWidth, uint8_t framePages, uint8_t page, int16_t x, const char *text);
+};
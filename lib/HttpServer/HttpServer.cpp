@@ -0,0 +1,890 @@
+/**
+ * @file         : HttpServer.cpp
+ * @summary      : HTTP server
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Single task, select() driven HTTP/1.1 server with keep-alive
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+#include "HttpServer.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <strings.h>
+
+struct HTTPMETHODNAME {
+  const char *name;
+  HTTPMethod method;
+};
+
+static const HTTPMETHODNAME methodNames[] = {
+  { "GET", HTTP_GET },
+  { "HEAD", HTTP_HEAD },
+  { "POST", HTTP_POST },
+  { "PUT", HTTP_PUT },
+  { "PATCH", HTTP_PATCH },
+  { "DELETE", HTTP_DELETE },
+  { "OPTIONS", HTTP_OPTIONS }
+};
+
+HttpServer::HttpServer(uint16_t port) {
+  this->port = port;
+  this->listener = -1;
+  this->wakeSocket = -1;
+  this->routeCount = 0;
+  this->notFoundHandler = NULL;
+  this->headerKeyCount = 0;
+  this->stats = { 0, 0, 0, 0, 0, 0, 0 };
+  this->current = NULL;
+  this->argCount = 0;
+  this->headerCount = 0;
+  for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+    this->connections[i].socket = -1;
+    this->connections[i].state = HTTP_FREE;
+  }
+}
+
+bool HttpServer::begin() {
+  this->listener = socket(AF_INET, SOCK_STREAM, 0);
+  if (this->listener < 0) {
+    return false;
+  }
+  int enable = 1;
+  setsockopt(this->listener, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(this->port);
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(this->listener, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(this->listener, HTTP_BACKLOG) < 0) {
+    ::close(this->listener);
+    this->listener = -1;
+    return false;
+  }
+  fcntl(this->listener, F_SETFL, fcntl(this->listener, F_GETFL, 0) | O_NONBLOCK);
+  // Without loopback wake() is a no-op and callers wait for the select() timeout
+  this->wakeSocket = socket(AF_INET, SOCK_DGRAM, 0);
+  if (this->wakeSocket >= 0) {
+    socklen_t length = sizeof(this->wakeAddress);
+    memset(&this->wakeAddress, 0, sizeof(this->wakeAddress));
+    this->wakeAddress.sin_family = AF_INET;
+    this->wakeAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(this->wakeSocket, (struct sockaddr *)&this->wakeAddress, sizeof(this->wakeAddress)) < 0 ||
+        getsockname(this->wakeSocket, (struct sockaddr *)&this->wakeAddress, &length) < 0) {
+      ::close(this->wakeSocket);
+      this->wakeSocket = -1;
+    } else {
+      fcntl(this->wakeSocket, F_SETFL, fcntl(this->wakeSocket, F_GETFL, 0) | O_NONBLOCK);
+    }
+  }
+  return true;
+}
+
+void HttpServer::stop() {
+  for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+    if (this->connections[i].state != HTTP_FREE) {
+      this->close(&this->connections[i]);
+    }
+  }
+  if (this->listener >= 0) {
+    ::close(this->listener);
+    this->listener = -1;
+  }
+  if (this->wakeSocket >= 0) {
+    ::close(this->wakeSocket);
+    this->wakeSocket = -1;
+  }
+}
+
+void HttpServer::wake() {
+  if (this->wakeSocket >= 0) {
+    sendto(this->wakeSocket, "", 1, MSG_DONTWAIT, (struct sockaddr *)&this->wakeAddress, sizeof(this->wakeAddress));
+  }
+}
+
+void HttpServer::on(const char *uri, std::function<void(void)> handler) {
+  this->on(uri, HTTP_ANY, handler);
+}
+
+void HttpServer::on(const char *uri, HTTPMethod method, std::function<void(void)> handler) {
+  if (this->routeCount < HTTP_MAX_ROUTES) {
+    this->routes[this->routeCount++] = { uri, method, handler };
+  }
+}
+
+void HttpServer::onNotFound(std::function<void(void)> handler) {
+  this->notFoundHandler = handler;
+}
+
+void HttpServer::collectHeaders(const char *headerKeys[], size_t count) {
+  this->headerKeyCount = 0;
+  for (size_t i = 0; i < count && i < HTTP_MAX_HEADERS; i++) {
+    this->headerKeys[this->headerKeyCount++] = headerKeys[i];
+  }
+}
+
+bool HttpServer::handle(uint32_t timeout, int extraSocket) {
+  fd_set readable;
+  fd_set writable;
+  FD_ZERO(&readable);
+  FD_ZERO(&writable);
+  int highest = -1;
+  uint8_t active = 0;
+  unsigned long now = millis();
+  for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+    HTTPCONNECTION *connection = &this->connections[i];
+    if (connection->state == HTTP_FREE) {
+      continue;
+    }
+    // A half sent request, an idle kept alive connection and a client that
+    // stopped reading each only get so long
+    unsigned long elapsed = now - connection->since;
+    if (connection->state == HTTP_READING && connection->received > 0 && elapsed >= HTTP_REQUEST_TIMEOUT) {
+      this->stats.rejected++;
+      this->close(connection);
+      continue;
+    }
+    bool pending = connection->outputSent < connection->outputLength;
+    if ((connection->state == HTTP_READING && elapsed >= HTTP_KEEPALIVE_TIMEOUT) ||
+        (connection->state == HTTP_WRITING && elapsed >= HTTP_STALL_TIMEOUT) ||
+        (connection->state == HTTP_STREAMING && pending && elapsed >= HTTP_STALL_TIMEOUT)) {
+      this->close(connection);
+      continue;
+    }
+    // Subscribers are read only to notice them leaving
+    if (connection->state != HTTP_WRITING) {
+      FD_SET(connection->socket, &readable);
+    }
+    if (connection->state == HTTP_WRITING || (connection->state == HTTP_STREAMING && pending)) {
+      FD_SET(connection->socket, &writable);
+    }
+    highest = max(highest, connection->socket);
+    active++;
+  }
+  // Leave new clients in the backlog until a slot frees up
+  if (this->listener >= 0 && active < HTTP_MAX_CONNECTIONS) {
+    FD_SET(this->listener, &readable);
+    highest = max(highest, this->listener);
+  }
+  if (extraSocket >= 0) {
+    FD_SET(extraSocket, &readable);
+    highest = max(highest, extraSocket);
+  }
+  if (this->wakeSocket >= 0) {
+    FD_SET(this->wakeSocket, &readable);
+    highest = max(highest, this->wakeSocket);
+  }
+  this->stats.active = active;
+  struct timeval wait = { (time_t)(timeout / 1000), (suseconds_t)((timeout % 1000) * 1000) };
+  if (select(highest + 1, &readable, &writable, NULL, &wait) <= 0) {
+    return false;
+  }
+  if (this->wakeSocket >= 0 && FD_ISSET(this->wakeSocket, &readable)) {
+    char discard[8];
+    while (recv(this->wakeSocket, discard, sizeof(discard), MSG_DONTWAIT) > 0);
+  }
+  // Sockets accepted here were not in the select() sets, they wait for the next round
+  if (this->listener >= 0 && FD_ISSET(this->listener, &readable)) {
+    this->accept();
+  }
+  for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+    HTTPCONNECTION *connection = &this->connections[i];
+    if (connection->state == HTTP_READING && FD_ISSET(connection->socket, &readable)) {
+      this->receive(connection);
+      this->service(connection);
+    } else if (connection->state == HTTP_WRITING && FD_ISSET(connection->socket, &writable)) {
+      this->service(connection);
+    } else if (connection->state == HTTP_STREAMING) {
+      if (FD_ISSET(connection->socket, &readable)) {
+        this->receive(connection);
+        connection->received = 0;
+      }
+      if (connection->state == HTTP_STREAMING && FD_ISSET(connection->socket, &writable)) {
+        this->pump(connection);
+      }
+    }
+  }
+  return extraSocket >= 0 && FD_ISSET(extraSocket, &readable);
+}
+
+void HttpServer::accept() {
+  struct sockaddr_in address;
+  socklen_t length = sizeof(address);
+  int client = ::accept(this->listener, (struct sockaddr *)&address, &length);
+  if (client < 0) {
+    return;
+  }
+  HTTPCONNECTION *connection = NULL;
+  for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS && connection == NULL; i++) {
+    if (this->connections[i].state == HTTP_FREE) {
+      connection = &this->connections[i];
+    }
+  }
+  if (connection == NULL) {
+    ::close(client);
+    return;
+  }
+  fcntl(client, F_SETFL, fcntl(client, F_GETFL, 0) | O_NONBLOCK);
+  // Responses go out whole, don't let Nagle hold back the tail of one
+  int enable = 1;
+  setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+  connection->socket = client;
+  connection->state = HTTP_READING;
+  connection->since = millis();
+  connection->requests = 0;
+  connection->received = 0;
+  connection->consumed = 0;
+  connection->outputLength = 0;
+  connection->outputSent = 0;
+  connection->stream = false;
+  this->stats.connections++;
+}
+
+void HttpServer::close(HTTPCONNECTION *connection) {
+  if (connection->file) {
+    connection->file.close();
+  }
+  connection->producer = nullptr;
+  ::close(connection->socket);
+  connection->socket = -1;
+  connection->state = HTTP_FREE;
+}
+
+void HttpServer::receive(HTTPCONNECTION *connection) {
+  ssize_t count = recv(connection->socket, connection->request + connection->received, HTTP_REQUEST_SIZE - connection->received, MSG_DONTWAIT);
+  if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+    return;
+  }
+  if (count <= 0) {
+    this->close(connection);
+    return;
+  }
+  // The request timeout runs from its first byte
+  if (connection->received == 0) {
+    connection->since = millis();
+  }
+  connection->received += count;
+}
+
+/** Answer every complete request buffered and push the responses out until the socket is full */
+void HttpServer::service(HTTPCONNECTION *connection) {
+  while (connection->state == HTTP_READING || connection->state == HTTP_WRITING) {
+    if (connection->state == HTTP_WRITING) {
+      if (!this->pump(connection)) {
+        return;
+      }
+      continue;
+    }
+    if (connection->received == 0) {
+      return;
+    }
+    int status = this->parse(connection);
+    if (status == 0) {
+      return;
+    }
+    if (status == 200) {
+      this->dispatch(connection);
+    } else {
+      this->reject(connection, status);
+    }
+  }
+}
+
+/**
+ * Split a complete request in place, pointing the current request fields
+ * into the connection buffer.
+ * @return 200 when parsed, 0 while incomplete, the error status otherwise
+ */
+int HttpServer::parse(HTTPCONNECTION *connection) {
+  char *request = connection->request;
+  request[connection->received] = '\0';
+  char *headerEnd = strstr(request, "\r\n\r\n");
+  if (headerEnd == NULL) {
+    return connection->received >= HTTP_REQUEST_SIZE ? 413 : 0;
+  }
+  size_t headerLength = headerEnd + 4 - request;
+  // Nothing is cut up until the body is in too, look for its length as is
+  size_t bodyLength = 0;
+  for (char *line = strstr(request, "\r\n") + 2; line < headerEnd + 2; line = strstr(line, "\r\n") + 2) {
+    if (strncasecmp(line, "Content-Length:", 15) == 0) {
+      bodyLength = strtoul(line + 15, NULL, 10);
+    }
+  }
+  if (bodyLength > HTTP_REQUEST_SIZE - headerLength) {
+    return 413;
+  }
+  if (connection->received < headerLength + bodyLength) {
+    return 0;
+  }
+  connection->consumed = headerLength + bodyLength;
+  // Terminate the body, the byte belongs to the next pipelined request if any
+  this->savedByte = request[connection->consumed];
+  request[connection->consumed] = '\0';
+  *headerEnd = '\0';
+
+  char *next = strstr(request, "\r\n");
+  if (next != NULL) {
+    *next = '\0';
+    next += 2;
+  }
+  char *target = strchr(request, ' ');
+  char *version = target != NULL ? strchr(target + 1, ' ') : NULL;
+  if (version == NULL) {
+    return 400;
+  }
+  *target++ = '\0';
+  *version++ = '\0';
+  uint8_t method = 0;
+  while (method < sizeof(methodNames) / sizeof(methodNames[0]) && strcmp(request, methodNames[method].name) != 0) {
+    method++;
+  }
+  if (method == sizeof(methodNames) / sizeof(methodNames[0])) {
+    return 501;
+  }
+  this->currentMethod = methodNames[method].method;
+  connection->http11 = strcmp(version, "HTTP/1.1") == 0;
+  connection->keepAlive = connection->http11;
+  connection->headOnly = this->currentMethod == HTTP_HEAD;
+
+  this->host = NULL;
+  this->headerCount = 0;
+  bool form = false;
+  while (next != NULL) {
+    char *line = next;
+    next = strstr(line, "\r\n");
+    if (next != NULL) {
+      *next = '\0';
+      next += 2;
+    }
+    char *value = strchr(line, ':');
+    if (value == NULL) {
+      continue;
+    }
+    *value++ = '\0';
+    while (*value == ' ' || *value == '\t') {
+      value++;
+    }
+    if (strcasecmp(line, "Host") == 0) {
+      this->host = value;
+    } else if (strcasecmp(line, "Connection") == 0) {
+      if (strcasecmp(value, "close") == 0) {
+        connection->keepAlive = false;
+      } else if (strcasecmp(value, "keep-alive") == 0) {
+        connection->keepAlive = true;
+      }
+    } else if (strcasecmp(line, "Content-Type") == 0) {
+      form = strncasecmp(value, "application/x-www-form-urlencoded", 33) == 0;
+    }
+    for (uint8_t i = 0; i < this->headerKeyCount; i++) {
+      if (this->headerCount < HTTP_MAX_HEADERS && strcasecmp(line, this->headerKeys[i]) == 0) {
+        this->headers[this->headerCount++] = { this->headerKeys[i], value };
+      }
+    }
+  }
+
+  this->argCount = 0;
+  char *query = strchr(target, '?');
+  if (query != NULL) {
+    *query++ = '\0';
+    this->parseArgs(query);
+  }
+  this->currentUri = decode(target, false);
+  if (form && bodyLength > 0) {
+    this->parseArgs(request + headerLength);
+  }
+  return 200;
+}
+
+/** Split name=value&name=value into the argument list */
+void HttpServer::parseArgs(char *query) {
+  while (query != NULL && *query != '\0') {
+    char *next = strchr(query, '&');
+    if (next != NULL) {
+      *next++ = '\0';
+    }
+    char *value = strchr(query, '=');
+    if (value != NULL) {
+      *value++ = '\0';
+    }
+    if (*query != '\0' && this->argCount < HTTP_MAX_ARGS) {
+      this->arguments[this->argCount++] = { decode(query, true), value != NULL ? decode(value, true) : "" };
+    }
+    query = next;
+  }
+}
+
+void HttpServer::dispatch(HTTPCONNECTION *connection) {
+  this->current = connection;
+  this->responseHeaders = "";
+  this->contentLength = CONTENT_LENGTH_NOT_SET;
+  this->responseStarted = false;
+  connection->chunked = false;
+  this->stats.requests++;
+  if (connection->requests++ > 0) {
+    this->stats.keepAliveReuses++;
+  }
+  HTTPROUTE *route = NULL;
+  for (uint8_t i = 0; i < this->routeCount && route == NULL; i++) {
+    HTTPMethod method = this->routes[i].method;
+    bool methodMatches = method == HTTP_ANY || method == this->currentMethod || (method == HTTP_GET && this->currentMethod == HTTP_HEAD);
+    if (methodMatches && strcmp(this->routes[i].uri, this->currentUri) == 0) {
+      route = &this->routes[i];
+    }
+  }
+  if (route != NULL) {
+    route->handler();
+  } else if (this->notFoundHandler) {
+    this->notFoundHandler();
+  } else {
+    this->send(404, "text/plain", "Not Found");
+  }
+  if (!this->responseStarted) {
+    this->send(500, "text/plain", "No response");
+  }
+  this->finish(connection);
+}
+
+/** Close the response of the handler that just returned and hand it to pump() */
+void HttpServer::finish(HTTPCONNECTION *connection) {
+  if (connection->chunked && !connection->producer) {
+    this->sendContent("", 0);
+  }
+  this->current = NULL;
+  connection->request[connection->consumed] = this->savedByte;
+  if (connection->state == HTTP_BROKEN) {
+    this->close(connection);
+    return;
+  }
+  connection->state = HTTP_WRITING;
+  connection->since = millis();
+}
+
+/**
+ * Send what the socket takes of the queued response, refilling from the
+ * file being streamed.
+ * @return true once the response is out, false while the socket is full
+ */
+bool HttpServer::pump(HTTPCONNECTION *connection) {
+  while (true) {
+    if (connection->outputSent == connection->outputLength) {
+      connection->outputSent = 0;
+      connection->outputLength = 0;
+      if (connection->file) {
+        int count = connection->file.read(connection->output, HTTP_OUTPUT_SIZE);
+        if (count > 0) {
+          connection->outputLength = count;
+        } else {
+          connection->file.close();
+        }
+      } else if (connection->producer) {
+        this->produce(connection);
+      }
+    }
+    if (connection->outputLength == 0) {
+      break;
+    }
+    ssize_t count = ::send(connection->socket, connection->output + connection->outputSent, connection->outputLength - connection->outputSent, MSG_DONTWAIT);
+    if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return false;
+    }
+    if (count <= 0) {
+      this->close(connection);
+      return true;
+    }
+    connection->outputSent += count;
+    connection->since = millis();
+  }
+  if (connection->stream) {
+    connection->state = HTTP_STREAMING;
+    return true;
+  }
+  if (!connection->keepAlive) {
+    this->close(connection);
+    return true;
+  }
+  // Keep whatever the client already sent of its next request
+  memmove(connection->request, connection->request + connection->consumed, connection->received - connection->consumed);
+  connection->received -= connection->consumed;
+  connection->consumed = 0;
+  connection->state = HTTP_READING;
+  connection->since = millis();
+  return true;
+}
+
+/** Refill the drained output buffer from the producer, framing chunks around its data */
+void HttpServer::produce(HTTPCONNECTION *connection) {
+  size_t head = connection->chunked ? HTTP_CHUNK_HEAD : 0;
+  size_t room = HTTP_OUTPUT_SIZE - head - (connection->chunked ? 2 : 0);
+  size_t count = connection->bodyLeft > 0 ? connection->producer(connection->output + head, min(room, connection->bodyLeft)) : 0;
+  if (count == 0) {
+    connection->producer = nullptr;
+    if (connection->chunked) {
+      memcpy(connection->output, "0\r\n\r\n", 5);
+      connection->outputLength = 5;
+      connection->chunked = false;
+    } else if (connection->bodyLeft > 0 && connection->bodyLeft != CONTENT_LENGTH_UNKNOWN) {
+      // Came up short of its Content-Length, only a close tells the client
+      connection->keepAlive = false;
+    }
+    return;
+  }
+  if (connection->bodyLeft != CONTENT_LENGTH_UNKNOWN) {
+    connection->bodyLeft -= count;
+  }
+  if (!connection->chunked) {
+    connection->outputLength = count;
+    return;
+  }
+  char size[HTTP_CHUNK_HEAD + 1];
+  int length = sprintf(size, "%x\r\n", (unsigned int)count);
+  // The size line goes right in front of the data, sending starts there
+  connection->outputSent = head - length;
+  memcpy(connection->output + connection->outputSent, size, length);
+  memcpy(connection->output + head + count, "\r\n", 2);
+  connection->outputLength = head + count + 2;
+}
+
+/** Answer a request that never reached a handler, and close */
+void HttpServer::reject(HTTPCONNECTION *connection, int code) {
+  this->stats.rejected++;
+  this->current = connection;
+  this->responseHeaders = "";
+  this->contentLength = CONTENT_LENGTH_NOT_SET;
+  this->responseStarted = false;
+  connection->http11 = true;
+  connection->keepAlive = false;
+  connection->chunked = false;
+  connection->headOnly = false;
+  // Whatever else is buffered is dropped with the connection
+  connection->consumed = connection->received;
+  this->savedByte = '\0';
+  this->send(code, "text/plain", reasonPhrase(code));
+  this->finish(connection);
+}
+
+/** Queue `data`, waiting on the socket while the output buffer is full */
+void HttpServer::write(const uint8_t *data, size_t length) {
+  HTTPCONNECTION *connection = this->current;
+  while (length > 0 && connection->state != HTTP_BROKEN) {
+    if (connection->outputLength == HTTP_OUTPUT_SIZE && !this->drain(connection, HTTP_WRITE_TIMEOUT)) {
+      connection->state = HTTP_BROKEN;
+      return;
+    }
+    size_t count = min(length, (size_t)(HTTP_OUTPUT_SIZE - connection->outputLength));
+    memcpy(connection->output + connection->outputLength, data, count);
+    connection->outputLength += count;
+    data += count;
+    length -= count;
+  }
+}
+
+void HttpServer::writeBody(const uint8_t *data, size_t length) {
+  if (!this->current->headOnly) {
+    this->write(data, length);
+  }
+}
+
+/** Block on this one socket until the output buffer is sent */
+bool HttpServer::drain(HTTPCONNECTION *connection, uint32_t timeout) {
+  unsigned long start = millis();
+  while (connection->outputSent < connection->outputLength) {
+    ssize_t count = ::send(connection->socket, connection->output + connection->outputSent, connection->outputLength - connection->outputSent, MSG_DONTWAIT);
+    if (count > 0) {
+      connection->outputSent += count;
+      continue;
+    }
+    if (count == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+      return false;
+    }
+    unsigned long elapsed = millis() - start;
+    if (elapsed >= timeout) {
+      return false;
+    }
+    fd_set writable;
+    FD_ZERO(&writable);
+    FD_SET(connection->socket, &writable);
+    struct timeval wait = { (time_t)((timeout - elapsed) / 1000), (suseconds_t)(((timeout - elapsed) % 1000) * 1000) };
+    select(connection->socket + 1, NULL, &writable, NULL, &wait);
+  }
+  connection->outputSent = 0;
+  connection->outputLength = 0;
+  return true;
+}
+
+void HttpServer::sendHead(int code, const char *contentType, size_t length) {
+  HTTPCONNECTION *connection = this->current;
+  if (this->responseStarted) {
+    return;
+  }
+  this->responseStarted = true;
+  String head;
+  head.reserve(128 + this->responseHeaders.length());
+  head = "HTTP/1.1 ";
+  head += code;
+  head += ' ';
+  head += reasonPhrase(code);
+  head += "\r\n";
+  if (contentType != NULL) {
+    head += "Content-Type: ";
+    head += contentType;
+    head += "\r\n";
+  }
+  if (length != CONTENT_LENGTH_UNKNOWN) {
+    head += "Content-Length: ";
+    head += length;
+    head += "\r\n";
+  } else if (connection->http11 && !connection->stream) {
+    head += "Transfer-Encoding: chunked\r\n";
+    connection->chunked = !connection->headOnly;
+  } else {
+    // HTTP/1.0 can only tell the end of an unsized body by the close
+    connection->keepAlive = false;
+  }
+  head += connection->keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+  head += this->responseHeaders;
+  head += "\r\n";
+  this->write((const uint8_t *)head.c_str(), head.length());
+}
+
+char *HttpServer::decode(char *text, bool form) {
+  char *out = text;
+  for (char *in = text; *in != '\0'; in++) {
+    if (*in == '%' && isxdigit(in[1]) && isxdigit(in[2])) {
+      char hex[3] = { in[1], in[2], '\0' };
+      *out++ = (char)strtol(hex, NULL, 16);
+      in += 2;
+    } else if (form && *in == '+') {
+      *out++ = ' ';
+    } else {
+      *out++ = *in;
+    }
+  }
+  *out = '\0';
+  return text;
+}
+
+const char *HttpServer::reasonPhrase(int code) {
+  switch (code) {
+    case 200: return "OK";
+    case 204: return "No Content";
+    case 301: return "Moved Permanently";
+    case 302: return "Found";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 413: return "Payload Too Large";
+    case 500: return "Internal Server Error";
+    case 501: return "Not Implemented";
+    case 503: return "Service Unavailable";
+    default: return "";
+  }
+}
+
+String HttpServer::uri() {
+  return String(this->currentUri);
+}
+
+HTTPMethod HttpServer::method() {
+  return this->currentMethod;
+}
+
+String HttpServer::hostHeader() {
+  return String(this->host != NULL ? this->host : "");
+}
+
+String HttpServer::header(const char *name) {
+  for (uint8_t i = 0; i < this->headerCount; i++) {
+    if (strcasecmp(this->headers[i].name, name) == 0) {
+      return String(this->headers[i].value);
+    }
+  }
+  return String();
+}
+
+bool HttpServer::hasArg(const char *name) {
+  for (uint8_t i = 0; i < this->argCount; i++) {
+    if (strcmp(this->arguments[i].name, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+String HttpServer::arg(const char *name) {
+  for (uint8_t i = 0; i < this->argCount; i++) {
+    if (strcmp(this->arguments[i].name, name) == 0) {
+      return String(this->arguments[i].value);
+    }
+  }
+  return String();
+}
+
+String HttpServer::arg(int i) {
+  return i >= 0 && i < this->argCount ? String(this->arguments[i].value) : String();
+}
+
+String HttpServer::argName(int i) {
+  return i >= 0 && i < this->argCount ? String(this->arguments[i].name) : String();
+}
+
+int HttpServer::args() {
+  return this->argCount;
+}
+
+IPAddress HttpServer::localIP() {
+  struct sockaddr_in address;
+  socklen_t length = sizeof(address);
+  if (this->current == NULL || getsockname(this->current->socket, (struct sockaddr *)&address, &length) < 0) {
+    return IPAddress();
+  }
+  return IPAddress(address.sin_addr.s_addr);
+}
+
+void HttpServer::sendHeader(const String &name, const String &value, bool first) {
+  String line = name + ": " + value + "\r\n";
+  if (first) {
+    this->responseHeaders = line + this->responseHeaders;
+  } else {
+    this->responseHeaders += line;
+  }
+}
+
+void HttpServer::setContentLength(size_t length) {
+  this->contentLength = length;
+}
+
+void HttpServer::send(int code, const char *contentType, const String &content) {
+  this->sendHead(code, contentType, this->contentLength == CONTENT_LENGTH_NOT_SET ? content.length() : this->contentLength);
+  if (content.length() > 0) {
+    this->sendContent(content.c_str(), content.length());
+  }
+}
+
+void HttpServer::send_P(int code, const char *contentType, const char *content, size_t length) {
+  this->sendHead(code, contentType, length);
+  this->writeBody((const uint8_t *)content, length);
+}
+
+void HttpServer::sendContent(const String &content) {
+  this->sendContent(content.c_str(), content.length());
+}
+
+/** Body data, chunk framed for unsized responses where an empty one ends the body */
+void HttpServer::sendContent(const char *content, size_t length) {
+  HTTPCONNECTION *connection = this->current;
+  if (!connection->chunked) {
+    this->writeBody((const uint8_t *)content, length);
+    return;
+  }
+  char size[12];
+  sprintf(size, "%x\r\n", (unsigned int)length);
+  this->write((const uint8_t *)size, strlen(size));
+  this->write((const uint8_t *)content, length);
+  this->write((const uint8_t *)"\r\n", 2);
+  if (length == 0) {
+    connection->chunked = false;
+  }
+}
+
+size_t HttpServer::streamFile(File &file, const String &contentType) {
+  size_t size = file.size();
+  // Like WebServer, a .gz file is the compressed form of `contentType`
+  String name = file.name();
+  if (name.endsWith(".gz") && contentType != "application/x-gzip" && contentType != "application/octet-stream") {
+    this->sendHeader("Content-Encoding", "gzip");
+  }
+  this->sendHead(200, contentType.c_str(), size);
+  // The copy shares the open file, pump() reads it as the socket drains
+  if (!this->current->headOnly && this->current->state != HTTP_BROKEN) {
+    this->current->file = file;
+  }
+  return size;
+}
+
+void HttpServer::sendStream(int code, const char *contentType, size_t length, HttpProducer producer) {
+  this->sendHead(code, contentType, length);
+  if (!this->current->headOnly && this->current->state != HTTP_BROKEN) {
+    this->current->producer = producer;
+    this->current->bodyLeft = length;
+  }
+}
+
+bool HttpServer::startEventStream() {
+  uint8_t streams = 0;
+  for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+    streams += this->connections[i].state != HTTP_FREE && this->connections[i].stream;
+  }
+  if (streams >= HTTP_MAX_STREAMS) {
+    this->send(503, "text/plain", "Too many event streams");
+    return false;
+  }
+  // The body runs until either side closes, no length and no chunks
+  this->current->stream = true;
+  this->current->keepAlive = false;
+  this->sendHeader("Cache-Control", "no-cache");
+  this->sendHead(200, "text/event-stream", CONTENT_LENGTH_UNKNOWN);
+  return true;
+}
+
+uint8_t HttpServer::broadcast(const char *event, size_t length) {
+  uint8_t queued = 0;
+  for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+    HTTPCONNECTION *connection = &this->connections[i];
+    if (connection->state != HTTP_STREAMING) {
+      continue;
+    }
+    if (connection->outputSent > 0) {
+      memmove(connection->output, connection->output + connection->outputSent, connection->outputLength - connection->outputSent);
+      connection->outputLength -= connection->outputSent;
+      connection->outputSent = 0;
+    }
+    if (HTTP_OUTPUT_SIZE - connection->outputLength < length) {
+      this->stats.droppedEvents++;
+      continue;
+    }
+    // The stall timeout runs from the oldest unsent event
+    if (connection->outputLength == 0) {
+      connection->since = millis();
+    }
+    memcpy(connection->output + connection->outputLength, event, length);
+    connection->outputLength += length;
+    queued++;
+    this->pump(connection);
+  }
+  return queued;
+}
+
+HTTPSERVERSTATS HttpServer::getStats() {
+  HTTPSERVERSTATS stats = this->stats;
+  stats.streams = 0;
+  for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+    stats.streams += this->connections[i].state == HTTP_STREAMING;
+  }
+  return stats;
+}
@@ -0,0 +1,238 @@
+/**
+ * @file         : HttpServer.h
+ * @summary      : HTTP server
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Single task, select() driven HTTP/1.1 server with keep-alive
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+#pragma once
+#include <Arduino.h>
+#include <FS.h>
+#include <IPAddress.h>
+#include <HTTP_Method.h>
+#include <functional>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define HTTP_MAX_CONNECTIONS 6        // Kept well under the lwIP socket limit
+#define HTTP_MAX_STREAMS 4            // Event streams, the other connections stay free for requests
+#define HTTP_MAX_ROUTES 16
+#define HTTP_MAX_ARGS 16
+#define HTTP_MAX_HEADERS 8            // Collected request headers
+#define HTTP_REQUEST_SIZE 1536        // Request line, headers and body
+#define HTTP_OUTPUT_SIZE 2048         // Per connection, fuller responses wait for the socket
+#define HTTP_REQUEST_TIMEOUT 5000     // From the first byte to a complete request (ms)
+#define HTTP_KEEPALIVE_TIMEOUT 5000   // Idle time before a kept alive connection is closed (ms)
+#define HTTP_WRITE_TIMEOUT 2000       // Longest a handler waits on a full socket (ms)
+#define HTTP_STALL_TIMEOUT 10000      // Queued responses the client stopped reading are dropped (ms)
+#define HTTP_BACKLOG 4
+#define HTTP_CHUNK_HEAD 6             // Room for a chunk size line ahead of produced body data
+
+#ifndef CONTENT_LENGTH_UNKNOWN
+#define CONTENT_LENGTH_UNKNOWN ((size_t) -1)
+#endif
+#ifndef CONTENT_LENGTH_NOT_SET
+#define CONTENT_LENGTH_NOT_SET ((size_t) -2)
+#endif
+
+enum HttpConnectionState {
+  HTTP_FREE,
+  HTTP_READING,             // Waiting for a complete request, or idle between two
+  HTTP_WRITING,             // Response queued, sent as the socket drains
+  HTTP_BROKEN,              // Write failed or timed out, closed once the handler returns
+  HTTP_STREAMING            // Event stream, only written to by broadcast()
+};
+
+/** Fill `buffer` with up to `size` bytes of body, 0 once the body is done */
+typedef std::function<size_t(uint8_t *buffer, size_t size)> HttpProducer;
+
+struct HTTPCONNECTION {
+  int socket;
+  HttpConnectionState state;
+  unsigned long since;      // millis() of the last state change or activity
+  uint16_t requests;        // Served on this connection
+  bool http11;
+  bool keepAlive;
+  bool chunked;             // Response body is chunk encoded
+  bool headOnly;            // HEAD request, the body is dropped
+  bool stream;              // Turns into an event stream once the response head is out
+  char request[HTTP_REQUEST_SIZE + 1];
+  size_t received;
+  size_t consumed;          // Bytes of `request` the current request spans
+  uint8_t output[HTTP_OUTPUT_SIZE];
+  size_t outputLength;
+  size_t outputSent;
+  File file;                // Body still streaming from the card
+  HttpProducer producer;    // Body still being generated
+  size_t bodyLeft;          // Bytes the producer still owes a sized response
+};
+
+struct HTTPROUTE {
+  const char *uri;
+  HTTPMethod method;
+  std::function<void(void)> handler;
+};
+
+struct HTTPPAIR {
+  const char *name;
+  const char *value;
+};
+
+struct HTTPSERVERSTATS {
+  uint32_t connections;     // Accepted
+  uint32_t requests;
+  uint32_t keepAliveReuses; // Requests on an already used connection
+  uint32_t rejected;        // Malformed, too large or timed out
+  uint32_t droppedEvents;   // Not queued to a subscriber that fell behind
+  uint8_t active;
+  uint8_t streams;
+};
+
+/**
+ * One task, one select() over the listening socket and every open
+ * connection, so an idle portal costs nothing and a phone that trickles
+ * its request in only holds its own slot.
+ *
+ * Each connection reads until a full request is buffered, then the route
+ * handler runs to completion and its response is queued in the
+ * connection output buffer. Files and producer generated bodies are read
+ * as the socket drains, so a large response never holds up the others.
+ * Only a handler that sends more than the output buffer in one go waits,
+ * on its own socket. The request and response calls mirror the WebServer
+ * ones the handlers were written against.
+ */
+class HttpServer {
+  private:
+    uint16_t port;
+    int listener;
+    int wakeSocket;           // Loopback UDP socket other tasks poke to end the select()
+    struct sockaddr_in wakeAddress;
+    HTTPCONNECTION connections[HTTP_MAX_CONNECTIONS];
+    HTTPROUTE routes[HTTP_MAX_ROUTES];
+    uint8_t routeCount;
+    std::function<void(void)> notFoundHandler;
+    const char *headerKeys[HTTP_MAX_HEADERS];
+    uint8_t headerKeyCount;
+    HTTPSERVERSTATS stats;
+    // Request being handled, all of it points into the connection buffer
+    HTTPCONNECTION *current;
+    HTTPMethod currentMethod;
+    const char *currentUri;
+    const char *host;
+    HTTPPAIR arguments[HTTP_MAX_ARGS];
+    uint8_t argCount;
+    HTTPPAIR headers[HTTP_MAX_HEADERS];
+    uint8_t headerCount;
+    String responseHeaders;
+    size_t contentLength;
+    bool responseStarted;
+    char savedByte;           // First byte after the request, overwritten by its terminator
+    void accept();
+    void close(HTTPCONNECTION *connection);
+    void receive(HTTPCONNECTION *connection);
+    void service(HTTPCONNECTION *connection);
+    int parse(HTTPCONNECTION *connection);
+    void parseArgs(char *query);
+    void dispatch(HTTPCONNECTION *connection);
+    void finish(HTTPCONNECTION *connection);
+    bool pump(HTTPCONNECTION *connection);
+    void produce(HTTPCONNECTION *connection);
+    void reject(HTTPCONNECTION *connection, int code);
+    void write(const uint8_t *data, size_t length);
+    void writeBody(const uint8_t *data, size_t length);
+    bool drain(HTTPCONNECTION *connection, uint32_t timeout);
+    void sendHead(int code, const char *contentType, size_t length);
+    static char *decode(char *text, bool form);
+    static const char *reasonPhrase(int code);
+
+  public:
+    HttpServer(uint16_t port = 80);
+    bool begin();
+    void stop();
+    void on(const char *uri, std::function<void(void)> handler);
+    void on(const char *uri, HTTPMethod method, std::function<void(void)> handler);
+    void onNotFound(std::function<void(void)> handler);
+    /** Request headers to keep besides Host, the rest are skipped */
+    void collectHeaders(const char *headerKeys[], size_t count);
+    /** Return from the select() in handle() early, safe from any task */
+    void wake();
+    /**
+     * Wait up to `timeout` ms for traffic on any connection, or on
+     * `extraSocket` if given, and serve whatever became ready.
+     * @return true when `extraSocket` is readable
+     */
+    bool handle(uint32_t timeout, int extraSocket = -1);
+
+    // Current request
+    String uri();
+    HTTPMethod method();
+    String hostHeader();
+    String header(const char *name);
+    bool hasArg(const char *name);
+    String arg(const char *name);
+    String arg(int i);
+    String argName(int i);
+    int args();
+    /** @return address the client reached us at */
+    IPAddress localIP();
+
+    // Response
+    void sendHeader(const String &name, const String &value, bool first = false);
+    void setContentLength(size_t length);
+    void send(int code, const char *contentType = NULL, const String &content = String(""));
+    void send_P(int code, const char *contentType, const char *content, size_t length);
+    void sendContent(const String &content);
+    void sendContent(const char *content, size_t length);
+    /** Queue `file` as the body, it is read as the client takes it */
+    size_t streamFile(File &file, const String &contentType);
+    /**
+     * Queue a body made by `producer` as the socket drains, chunk encoded
+     * when `length` is CONTENT_LENGTH_UNKNOWN. It runs after the handler
+     * returned, so it must own whatever state it needs.
+     */
+    void sendStream(int code, const char *contentType, size_t length, HttpProducer producer);
+    /**
+     * Answer with a text/event-stream head and keep the connection as a
+     * subscriber once the handler returns, anything sent before that goes
+     * to this client only.
+     * @return false, after answering 503, when every stream slot is taken
+     */
+    bool startEventStream();
+    /**
+     * Queue one serialized event to every subscriber, a subscriber whose
+     * output buffer is still full misses it. Server task only.
+     * @return subscribers it was queued to
+     */
+    uint8_t broadcast(const char *event, size_t length);
+
+    HTTPSERVERSTATS getStats();
+};
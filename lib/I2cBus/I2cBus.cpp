@@ -0,0 +1,164 @@
+/**
+ * @file         : I2cBus.cpp
+ * @summary      : I2C bus manager
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Priority and deadline scheduled I2C transactions run from a single bus task
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "I2cBus.h"
+
+I2cBus::I2cBus() {
+  this->queue = NULL;
+  this->pendingCount = 0;
+  this->deviceCount = 0;
+  this->statsSince = 0;
+}
+
+bool I2cBus::begin(BaseType_t core, UBaseType_t priority, uint32_t stackSize) {
+  this->queue = xQueueCreate(I2C_QUEUE_LEN, sizeof(I2CJOB));
+  if (this->queue == NULL) {
+    return false;
+  }
+  this->statsSince = esp_timer_get_time();
+  return xTaskCreatePinnedToCore(task, "I2C Bus", stackSize, this, priority, NULL, core) == pdPASS;
+}
+
+uint8_t I2cBus::addDevice(const char *name) {
+  if (this->deviceCount >= I2C_MAX_DEVICES) {
+    return I2C_MAX_DEVICES - 1;
+  }
+  this->devices[this->deviceCount] = { name, 0, 0, 0, 0, 0 };
+  return this->deviceCount++;
+}
+
+I2cJobResult I2cBus::run(uint8_t device, I2cPriority priority, uint32_t deadline, I2cJobStep step, void *context) {
+  I2cJobResult result = I2C_JOB_FAILED;
+  int64_t now = esp_timer_get_time();
+  I2CJOB job = {
+    device,
+    (uint8_t)priority,
+    now,
+    now + (int64_t)deadline * 1000,
+    false,
+    step,
+    context,
+    xTaskGetCurrentTaskHandle(),
+    &result
+  };
+  if (this->queue == NULL) {
+    // Bus task not running yet (setup), nobody else can be on the bus
+    while ((result = step(context)) == I2C_JOB_MORE);
+    return result;
+  }
+  // The job points into this stack frame, so wait for it no matter how long
+  xQueueSend(this->queue, &job, portMAX_DELAY);
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  return result;
+}
+
+void I2cBus::task(void *parameters) {
+  I2cBus *bus = (I2cBus *)parameters;
+  while (true) {
+    // Sleep while there is nothing to do, otherwise just pick up whatever
+    // arrived during the last step
+    bus->receive(bus->pendingCount == 0 ? portMAX_DELAY : 0);
+    if (bus->pendingCount > 0) {
+      bus->runStep(bus->next());
+    }
+  }
+}
+
+void I2cBus::receive(TickType_t timeout) {
+  while (this->pendingCount < I2C_MAX_PENDING &&
+      xQueueReceive(this->queue, &this->pending[this->pendingCount], timeout) == pdTRUE) {
+    this->pendingCount++;
+    timeout = 0;
+  }
+}
+
+uint8_t I2cBus::next() {
+  uint8_t best = 0;
+  for (uint8_t i = 1; i < this->pendingCount; i++) {
+    I2CJOB *job = &this->pending[i];
+    I2CJOB *current = &this->pending[best];
+    if (job->priority > current->priority ||
+        (job->priority == current->priority && job->deadline < current->deadline)) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+void I2cBus::runStep(uint8_t index) {
+  I2CJOB *job = &this->pending[index];
+  I2CDEVICESTATS *stats = &this->devices[job->device < this->deviceCount ? job->device : 0];
+  int64_t start = esp_timer_get_time();
+  if (!job->started) {
+    job->started = true;
+    uint32_t wait = (uint32_t)(start - job->submitted);
+    stats->jobs++;
+    if (wait > stats->maxWaitMicros) {
+      stats->maxWaitMicros = wait;
+    }
+    if (start > job->deadline) {
+      stats->missedDeadlines++;
+    }
+  }
+  I2cJobResult result = job->step(job->context);
+  stats->steps++;
+  stats->busyMicros += esp_timer_get_time() - start;
+  if (result == I2C_JOB_MORE) {
+    return;
+  }
+  *job->result = result;
+  xTaskNotifyGive(job->owner);
+  // Order doesn't matter, next() looks at every pending job
+  this->pending[index] = this->pending[--this->pendingCount];
+}
+
+uint8_t I2cBus::getDeviceCount() {
+  return this->deviceCount;
+}
+
+I2CDEVICESTATS I2cBus::getStats(uint8_t device) {
+  return this->devices[device < this->deviceCount ? device : 0];
+}
+
+int64_t I2cBus::getStatsPeriod() {
+  return esp_timer_get_time() - this->statsSince;
+}
+
+void I2cBus::resetStats() {
+  for (uint8_t i = 0; i < this->deviceCount; i++) {
+    this->devices[i] = { this->devices[i].name, 0, 0, 0, 0, 0 };
+  }
+  this->statsSince = esp_timer_get_time();
+}
@@ -0,0 +1,116 @@
+/**
+ * @file         : I2cBus.h
+ * @summary      : I2C bus manager
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Priority and deadline scheduled I2C transactions run from a single bus task
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#pragma once
+#include <Arduino.h>
+#include <esp_timer.h>
+
+#define I2C_MAX_DEVICES 8
+#define I2C_MAX_PENDING 8         // Jobs the bus task holds while picking the next one
+#define I2C_QUEUE_LEN 8
+
+enum I2cPriority {
+  I2C_PRIORITY_LOW,         // Bulk transfers, e.g. display frames
+  I2C_PRIORITY_NORMAL,
+  I2C_PRIORITY_HIGH         // Time critical, e.g. tube output and RTC second boundaries
+};
+
+enum I2cJobResult {
+  I2C_JOB_DONE,
+  I2C_JOB_MORE,             // Step again, other jobs may run in between
+  I2C_JOB_FAILED
+};
+
+/** One bus transaction, or one chunk of a larger transfer */
+typedef I2cJobResult (*I2cJobStep)(void *context);
+
+struct I2CJOB {
+  uint8_t device;
+  uint8_t priority;
+  int64_t submitted;        // esp_timer time (us)
+  int64_t deadline;         // esp_timer time (us) the job should have started by
+  bool started;
+  I2cJobStep step;
+  void *context;
+  TaskHandle_t owner;       // Notified once the job is done
+  I2cJobResult *result;
+};
+
+struct I2CDEVICESTATS {
+  const char *name;
+  uint32_t jobs;
+  uint32_t steps;
+  uint64_t busyMicros;      // Time spent running this device steps
+  uint32_t maxWaitMicros;   // Worst time from submission to first step
+  uint32_t missedDeadlines;
+};
+
+/**
+ * Every I2C access goes through one task so the bus is never held by a
+ * low priority transfer when something urgent shows up. Jobs run in
+ * priority order, earliest deadline first within a priority, and a job
+ * that returns I2C_JOB_MORE goes back into the pending set so a higher
+ * priority job can run between its chunks.
+ */
+class I2cBus {
+  private:
+    QueueHandle_t queue;
+    I2CJOB pending[I2C_MAX_PENDING];
+    uint8_t pendingCount;
+    I2CDEVICESTATS devices[I2C_MAX_DEVICES];
+    uint8_t deviceCount;
+    int64_t statsSince;
+    static void task(void *parameters);
+    void receive(TickType_t timeout);
+    uint8_t next();
+    void runStep(uint8_t index);
+
+  public:
+    I2cBus();
+    bool begin(BaseType_t core, UBaseType_t priority = 3, uint32_t stackSize = 3072);
+    /** @return device id for run() and getStats() */
+    uint8_t addDevice(const char *name);
+    /**
+     * Queue a job and wait for it to finish, `step` is called from the bus
+     * task until it returns I2C_JOB_DONE or I2C_JOB_FAILED.
+     * @param deadline ms from now the job should start by
+     */
+    I2cJobResult run(uint8_t device, I2cPriority priority, uint32_t deadline, I2cJobStep step, void *context);
+    uint8_t getDeviceCount();
+    I2CDEVICESTATS getStats(uint8_t device);
+    /** @return us elapsed since the statistics were last reset */
+    int64_t getStatsPeriod();
+    void resetStats();
+};
@@ -0,0 +1,148 @@
+/**
+ * @file         : McpOutput.cpp
+ * @summary      : MCP23017 output layer
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Shadowed MCP23017 registers with diffed, coalesced I2C burst writes
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "McpOutput.h"
+
+// Device address + register address + one data byte, what a naive driver
+// sends per register update
+#define MCP23017_SINGLE_WRITE_BYTES 3
+
+McpOutput::McpOutput(TwoWire &wire, uint8_t address) {
+  this->wire = &wire;
+  this->address = address;
+  // Power on state
+  for (uint8_t port = 0; port < MCP23017_PORTS; port++) {
+    this->iodir[port] = 0xFF;
+    this->gpio[port] = 0x00;
+  }
+  this->dirtyIodir = 0;
+  this->dirtyGpio = 0;
+  this->updates = 0;
+  this->stats = { 0, 0, 0, 0, 0 };
+}
+
+bool McpOutput::begin() {
+  // The device may not have been reset since the last boot, don't trust it
+  // to match the shadow
+  this->dirtyGpio = 0x03;
+  this->dirtyIodir = 0x03;
+  return this->flush();
+}
+
+void McpOutput::update(uint8_t *shadow, uint8_t *dirty, uint8_t port, uint8_t value) {
+  this->updates++;
+  if (shadow[port] == value) {
+    this->stats.skipped++;
+    return;
+  }
+  shadow[port] = value;
+  *dirty |= 1 << port;
+}
+
+void McpOutput::pinMode(uint8_t pin, uint8_t mode) {
+  uint8_t port = pin >> 3 & 1;
+  uint8_t bit = 1 << (pin & 7);
+  uint8_t value = mode == OUTPUT ? this->iodir[port] & ~bit : this->iodir[port] | bit;
+  this->update(this->iodir, &this->dirtyIodir, port, value);
+}
+
+void McpOutput::digitalWrite(uint8_t pin, uint8_t value) {
+  uint16_t mask = 1 << (pin & 15);
+  this->writeMasked(mask, value ? mask : 0);
+}
+
+void McpOutput::writeMasked(uint16_t mask, uint16_t value) {
+  for (uint8_t port = 0; port < MCP23017_PORTS; port++) {
+    uint8_t portMask = mask >> (port * 8);
+    if (portMask == 0) {
+      continue;
+    }
+    uint8_t portValue = (this->gpio[port] & ~portMask) | (value >> (port * 8) & portMask);
+    this->update(this->gpio, &this->dirtyGpio, port, portValue);
+  }
+}
+
+void McpOutput::writeGPIOAB(uint16_t value) {
+  this->writeMasked(0xFFFF, value);
+}
+
+uint16_t McpOutput::getOutput() {
+  return this->gpio[0] | this->gpio[1] << 8;
+}
+
+bool McpOutput::isDirty() {
+  return this->dirtyIodir != 0 || this->dirtyGpio != 0;
+}
+
+bool McpOutput::writeRegisters(uint8_t reg, const uint8_t *values, uint8_t dirty) {
+  if (dirty == 0) {
+    return true;
+  }
+  // Only port B changed, start the burst there
+  uint8_t first = dirty & 0x01 ? 0 : 1;
+  uint8_t last = dirty & 0x02 ? 1 : 0;
+  this->wire->beginTransmission(this->address);
+  this->wire->write(reg + first);
+  for (uint8_t port = first; port <= last; port++) {
+    this->wire->write(values[port]);
+  }
+  bool sent = this->wire->endTransmission() == 0;
+  this->stats.transactions++;
+  this->stats.bytes += 2 + last - first + 1;
+  return sent;
+}
+
+bool McpOutput::flush() {
+  if (!this->isDirty()) {
+    return true;
+  }
+  // Output latches first, a pin drives OLAT as soon as its IODIR bit
+  // clears so it never glitches to the old level
+  bool sent = this->writeRegisters(MCP23017_GPIOA, this->gpio, this->dirtyGpio);
+  sent = this->writeRegisters(MCP23017_IODIRA, this->iodir, this->dirtyIodir) && sent;
+  if (sent) {
+    this->dirtyGpio = 0;
+    this->dirtyIodir = 0;
+  }
+  return sent;
+}
+
+MCPOUTPUTSTATS McpOutput::getStats() {
+  MCPOUTPUTSTATS stats = this->stats;
+  uint32_t naiveBytes = this->updates * MCP23017_SINGLE_WRITE_BYTES;
+  stats.savedTransactions = this->updates > stats.transactions ? this->updates - stats.transactions : 0;
+  stats.savedBytes = naiveBytes > stats.bytes ? naiveBytes - stats.bytes : 0;
+  return stats;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file         : McpOutput.h
+ * @summary      : MCP23017 output layer
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Shadowed MCP23017 registers with diffed, coalesced I2C burst writes
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#pragma once
+#include <Arduino.h>
+#include <Wire.h>
+
+#define MCP23017_DEFAULT_ADDRESS 0x20
+#define MCP23017_IODIRA 0x00        // IODIRB follows, IOCON.BANK = 0 keeps A/B registers paired
+#define MCP23017_GPIOA 0x12         // GPIOB follows
+#define MCP23017_PORTS 2
+
+struct MCPOUTPUTSTATS {
+  uint32_t transactions;    // I2C transactions sent
+  uint32_t bytes;           // Bytes on the wire, device address included
+  uint32_t skipped;         // Port updates that changed nothing and were never sent
+  uint32_t savedTransactions;   // Compared to one register write per port update
+  uint32_t savedBytes;
+};
+
+/**
+ * Keeps a copy of IODIRA/B and GPIOA/B so updates only touch the shadow.
+ * flush() sends whatever changed since the last flush, both ports of a
+ * register pair go out in one sequential-address burst, so any number of
+ * pinMode()/digitalWrite() calls cost at most two transactions.
+ */
+class McpOutput {
+  private:
+    TwoWire *wire;
+    uint8_t address;
+    uint8_t iodir[MCP23017_PORTS];
+    uint8_t gpio[MCP23017_PORTS];
+    uint8_t dirtyIodir;       // One bit per port
+    uint8_t dirtyGpio;
+    uint32_t updates;         // Port updates requested so far
+    MCPOUTPUTSTATS stats;
+    void update(uint8_t *shadow, uint8_t *dirty, uint8_t port, uint8_t value);
+    bool writeRegisters(uint8_t reg, const uint8_t *values, uint8_t dirty);
+
+  public:
+    McpOutput(TwoWire &wire, uint8_t address = MCP23017_DEFAULT_ADDRESS);
+    /** Bring the device to the shadow state (all inputs, all low), call with the bus held */
+    bool begin();
+    void pinMode(uint8_t pin, uint8_t mode);
+    void digitalWrite(uint8_t pin, uint8_t value);
+    /** Replace the bits of `mask` in GPIOA (low byte) and GPIOB (high byte) */
+    void writeMasked(uint16_t mask, uint16_t value);
+    void writeGPIOAB(uint16_t value);
+    uint16_t getOutput();
+    /** @return true when there are register changes waiting for flush() */
+    bool isDirty();
+    /** Send the pending changes, call with the bus held */
+    bool flush();
+    MCPOUTPUTSTATS getStats();
+};
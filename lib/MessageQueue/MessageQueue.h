@@ -0,0 +1,64 @@
+/**
+ * @file         : MessageQueue.h
+ * @summary      : Typed FreeRTOS queues
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Queue helpers that only accept trivially copyable messages
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#pragma once
+#include <Arduino.h>
+#include <type_traits>
+
+/**
+ * FreeRTOS queues memcpy their items, so anything owning heap memory (String,
+ * std::vector, ...) would be shallow copied and freed under the receiver.
+ * Going through these helpers turns that into a compile error.
+ */
+#define ASSERT_MESSAGE_TYPE(T) \
+  static_assert(std::is_trivially_copyable<T>::value, #T " is queued and must be trivially copyable")
+
+template <typename T>
+QueueHandle_t createMessageQueue(UBaseType_t length) {
+  ASSERT_MESSAGE_TYPE(T);
+  return xQueueCreate(length, sizeof(T));
+}
+
+template <typename T>
+BaseType_t sendMessage(QueueHandle_t queue, const T *message, TickType_t ticksToWait) {
+  ASSERT_MESSAGE_TYPE(T);
+  return xQueueSend(queue, (const void *)message, ticksToWait);
+}
+
+template <typename T>
+BaseType_t receiveMessage(QueueHandle_t queue, T *message, TickType_t ticksToWait) {
+  ASSERT_MESSAGE_TYPE(T);
+  return xQueueReceive(queue, (void *)message, ticksToWait);
+}
@@ -4,7 +4,7 @@
  * @summary      : Nixie handler based on the 74141 driver
  * @version      : 1.0.0
  * @project      : Nixie Clock
- * @description  : Nixie handler based on the 74141 driver
+ * @description  : Multiplexed nixie display driver refreshed from a hardware timer
  * @author       : Benjamin Maggi
  * @email        : benjaminmaggi@gmail.com
  * @date         : 08 Aug 2021
@@ -36,6 +36,346 @@
 
 #include "Nixie.h"
 
-Nixie::Nixie(unsigned long epoch) {
-  this->epoch = epoch;
-}
\ No newline at end of file
+template <size_t N>
+struct NIXIECURVE {
+  uint16_t values[N];
+};
+
+/**
+ * CIE 1931 lightness to luminance, so equal brightness steps look equal.
+ * Nixies are close enough to linear in duty cycle for this to hold.
+ */
+constexpr NIXIECURVE<NIXIE_BRIGHTNESS_LEVELS> makeLightnessCurve() {
+  NIXIECURVE<NIXIE_BRIGHTNESS_LEVELS> curve = {};
+  for (size_t i = 0; i < NIXIE_BRIGHTNESS_LEVELS; i++) {
+    double lightness = i * 100.0 / (NIXIE_BRIGHTNESS_LEVELS - 1);
+    double k = (lightness + 16) / 116;
+    double luminance = lightness <= 8 ? lightness / 903.3 : k * k * k;
+    curve.values[i] = (uint16_t)(luminance * 65535 + 0.5);
+  }
+  return curve;
+}
+
+/** Smoothstep, share of the lit time given to the incoming digit */
+constexpr NIXIECURVE<NIXIE_FADE_STEPS> makeFadeCurve() {
+  NIXIECURVE<NIXIE_FADE_STEPS> curve = {};
+  for (size_t i = 0; i < NIXIE_FADE_STEPS; i++) {
+    double t = (double)i / (NIXIE_FADE_STEPS - 1);
+    curve.values[i] = (uint16_t)(t * t * (3 - 2 * t) * 65535 + 0.5);
+  }
+  return curve;
+}
+
+static_assert(makeLightnessCurve().values[0] == 0, "Lightness curve must start dark");
+static_assert(makeLightnessCurve().values[NIXIE_BRIGHTNESS_LEVELS - 1] == 65535, "Lightness curve must end at full duty");
+static_assert(makeFadeCurve().values[NIXIE_FADE_STEPS - 1] == 65535, "Fade curve must end on the incoming digit");
+
+// The ISR runs while the flash cache may be off, keep its tables in RAM
+static const DRAM_ATTR NIXIECURVE<NIXIE_BRIGHTNESS_LEVELS> lightnessCurve = makeLightnessCurve();
+static const DRAM_ATTR NIXIECURVE<NIXIE_FADE_STEPS> fadeCurve = makeFadeCurve();
+
+Nixie *Nixie::instance = NULL;
+
+Nixie::Nixie(const uint8_t *bcdPins, const uint8_t *anodePins, uint8_t tubeCount) {
+  this->timer = NULL;
+  this->timerNumber = 0;
+  this->tubeCount = tubeCount < NIXIE_MAX_TUBES ? tubeCount : NIXIE_MAX_TUBES;
+  this->slotTicks = 0;
+  this->bcdMask = { 0, 0 };
+  this->anodeMask = { 0, 0 };
+  // Precompute the set masks so the ISR is down to a few register writes
+  for (uint8_t digit = 0; digit < 16; digit++) {
+    this->digitMasks[digit] = { 0, 0 };
+    for (uint8_t bit = 0; bit < NIXIE_BCD_PINS; bit++) {
+      NIXIEGPIOMASK mask = pinMask(bcdPins[bit]);
+      if (digit & (1 << bit)) {
+        this->digitMasks[digit].low |= mask.low;
+        this->digitMasks[digit].high |= mask.high;
+      }
+    }
+  }
+  for (uint8_t bit = 0; bit < NIXIE_BCD_PINS; bit++) {
+    NIXIEGPIOMASK mask = pinMask(bcdPins[bit]);
+    this->bcdMask.low |= mask.low;
+    this->bcdMask.high |= mask.high;
+  }
+  for (uint8_t tube = 0; tube < this->tubeCount; tube++) {
+    this->anodeMasks[tube] = pinMask(anodePins[tube]);
+    this->anodeMask.low |= this->anodeMasks[tube].low;
+    this->anodeMask.high |= this->anodeMasks[tube].high;
+  }
+  memset(this->frames, NIXIE_BLANK, sizeof(this->frames));
+  memset(this->from, NIXIE_BLANK, sizeof(this->from));
+  memset(this->to, NIXIE_BLANK, sizeof(this->to));
+  this->front = 0;
+  this->published = 0;
+  this->active = 0;
+  this->shown = 0;
+  this->fadePosition = 0;
+  this->fadeStep = 0;
+  this->brightness = NIXIE_BRIGHTNESS_LEVELS - 1;
+  this->nightBrightness = NIXIE_BRIGHTNESS_LEVELS - 1;
+  this->night = false;
+  this->updateDuty();
+  this->slot = 0;
+  this->phaseCount = 0;
+  this->phaseIndex = 0;
+  this->cyclesPerTick = 0;
+  this->expectedCycles = 0;
+  this->lastCycles = 0;
+  this->maxJitter = 0;
+  this->interrupts = 0;
+  this->isrCycles = 0;
+  this->maxIsrCycles = 0;
+  this->statsSince = 0;
+}
+
+NIXIEGPIOMASK Nixie::pinMask(uint8_t pin) {
+  NIXIEGPIOMASK mask = { 0, 0 };
+  if (pin < 32) {
+    mask.low = 1UL << pin;
+  } else if (pin < 40) {
+    mask.high = 1UL << (pin - 32);
+  }
+  return mask;
+}
+
+bool Nixie::begin(uint32_t refreshRate, uint8_t timerNumber) {
+  if (instance != NULL || refreshRate == 0 || this->tubeCount == 0) {
+    return false;
+  }
+  for (uint8_t pin = 0; pin < 40; pin++) {
+    NIXIEGPIOMASK mask = pinMask(pin);
+    if ((mask.low & (this->bcdMask.low | this->anodeMask.low)) || (mask.high & (this->bcdMask.high | this->anodeMask.high))) {
+      pinMode(pin, OUTPUT);
+      digitalWrite(pin, LOW);
+    }
+  }
+  uint32_t slotTicks = 1000000UL / (refreshRate * this->tubeCount);
+  this->slotTicks = slotTicks < NIXIE_MIN_PHASE + NIXIE_BLANKING ? NIXIE_MIN_PHASE + NIXIE_BLANKING : slotTicks > UINT16_MAX ? UINT16_MAX : slotTicks;
+  this->timerNumber = timerNumber;
+  this->setFadeTime(NIXIE_DEFAULT_FADE);
+  this->phaseCount = 0;
+  this->phaseIndex = 0;
+  this->cyclesPerTick = getCpuFrequencyMhz();
+  this->expectedCycles = this->slotTicks * this->cyclesPerTick;
+  this->lastCycles = XTHAL_GET_CCOUNT();
+  this->statsSince = esp_timer_get_time();
+  instance = this;
+  this->timer = timerBegin(timerNumber, NIXIE_TIMER_DIVIDER, true);
+  if (this->timer == NULL) {
+    instance = NULL;
+    return false;
+  }
+  timerAttachInterrupt(this->timer, &Nixie::onTimer, true);
+  timerAlarmWrite(this->timer, this->slotTicks, true);
+  timerAlarmEnable(this->timer);
+  return true;
+}
+
+void Nixie::end() {
+  if (this->timer != NULL) {
+    timerAlarmDisable(this->timer);
+    timerDetachInterrupt(this->timer);
+    timerEnd(this->timer);
+    this->timer = NULL;
+  }
+  GPIO.out_w1tc = this->anodeMask.low;
+  GPIO.out1_w1tc.val = this->anodeMask.high;
+  instance = NULL;
+}
+
+void IRAM_ATTR Nixie::onTimer() {
+  if (instance != NULL) {
+    instance->refresh();
+  }
+}
+
+void IRAM_ATTR Nixie::setAlarm(uint16_t ticks) {
+  // The timer auto reloads, so this is the length of the phase that just
+  // started. The Arduino timer calls aren't all in IRAM, write the alarm
+  // registers directly. An alarm below the running count fires at once
+  timg_dev_t *group = this->timerNumber < 2 ? &TIMERG0 : &TIMERG1;
+  group->hw_timer[this->timerNumber & 1].alarm_high = 0;
+  group->hw_timer[this->timerNumber & 1].alarm_low = ticks;
+}
+
+void IRAM_ATTR Nixie::show(uint8_t tube, uint8_t digit) {
+  // Anodes off before the cathodes change, otherwise the old digit ghosts
+  // the new one
+  GPIO.out_w1tc = this->anodeMask.low;
+  GPIO.out1_w1tc.val = this->anodeMask.high;
+  if (digit == NIXIE_BLANK) {
+    return;
+  }
+  GPIO.out_w1tc = this->bcdMask.low & ~this->digitMasks[digit].low;
+  GPIO.out1_w1tc.val = this->bcdMask.high & ~this->digitMasks[digit].high;
+  GPIO.out_w1ts = this->digitMasks[digit].low;
+  GPIO.out1_w1ts.val = this->digitMasks[digit].high;
+  GPIO.out_w1ts = this->anodeMasks[tube].low;
+  GPIO.out1_w1ts.val = this->anodeMasks[tube].high;
+}
+
+void IRAM_ATTR Nixie::planSlot() {
+  if (this->slot == 0) {
+    // Read before `front`, swap() stores them the other way round
+    uint32_t published = this->published;
+    if (published != this->shown) {
+      // New frame, fade from whatever each tube was heading to
+      this->shown = published;
+      this->active = this->front;
+      for (uint8_t tube = 0; tube < this->tubeCount; tube++) {
+        this->from[tube] = this->to[tube];
+        this->to[tube] = this->frames[this->active][tube] & 0x0F;
+      }
+      this->fadePosition = 0;
+    } else if (this->fadePosition < (NIXIE_FADE_STEPS - 1) << 16) {
+      this->fadePosition += this->fadeStep;
+      if (this->fadePosition > (NIXIE_FADE_STEPS - 1) << 16) {
+        this->fadePosition = (NIXIE_FADE_STEPS - 1) << 16;
+      }
+    }
+  }
+  uint8_t from = this->from[this->slot];
+  uint8_t to = this->to[this->slot];
+  // Full duty still leaves the blanking interval before the next tube
+  uint32_t lit = ((uint32_t)(this->slotTicks - NIXIE_BLANKING) * this->duty) >> 16;
+  if (this->duty > 0 && lit < NIXIE_MIN_PHASE) {
+    // Dimmest the timer can do
+    lit = NIXIE_MIN_PHASE;
+  }
+  uint32_t incoming = lit;
+  if (from != to) {
+    incoming = (lit * fadeCurve.values[this->fadePosition >> 16]) >> 16;
+  }
+  uint32_t outgoing = lit - incoming;
+  uint32_t blank = this->slotTicks - lit;
+  // Phases too short to time reliably go to their neighbour
+  if (outgoing < NIXIE_MIN_PHASE) {
+    incoming += outgoing;
+    outgoing = 0;
+  } else if (incoming < NIXIE_MIN_PHASE) {
+    outgoing += incoming;
+    incoming = 0;
+  }
+  if (blank < NIXIE_MIN_PHASE && blank < outgoing + incoming) {
+    if (incoming > 0) {
+      incoming += blank;
+    } else {
+      outgoing += blank;
+    }
+    blank = 0;
+  } else if (outgoing + incoming < NIXIE_MIN_PHASE) {
+    blank = this->slotTicks;
+    outgoing = 0;
+    incoming = 0;
+  }
+  this->phaseCount = 0;
+  if (outgoing > 0) {
+    this->phases[this->phaseCount++] = { from, (uint16_t)outgoing };
+  }
+  if (incoming > 0) {
+    this->phases[this->phaseCount++] = { to, (uint16_t)incoming };
+  }
+  if (blank > 0) {
+    this->phases[this->phaseCount++] = { NIXIE_BLANK, (uint16_t)blank };
+  }
+  this->phaseIndex = 0;
+}
+
+void IRAM_ATTR Nixie::refresh() {
+  uint32_t cycles = XTHAL_GET_CCOUNT();
+  uint32_t elapsed = cycles - this->lastCycles;
+  uint32_t jitter = elapsed > this->expectedCycles ? elapsed - this->expectedCycles : this->expectedCycles - elapsed;
+  this->lastCycles = cycles;
+  if (jitter > this->maxJitter) {
+    this->maxJitter = jitter;
+  }
+  if (this->phaseIndex >= this->phaseCount) {
+    if (this->phaseCount > 0 && ++this->slot >= this->tubeCount) {
+      this->slot = 0;
+    }
+    this->planSlot();
+  }
+  NIXIEPHASE *phase = &this->phases[this->phaseIndex++];
+  this->show(this->slot, phase->digit);
+  this->setAlarm(phase->ticks);
+  this->expectedCycles = phase->ticks * this->cyclesPerTick;
+  this->interrupts++;
+  uint32_t spent = XTHAL_GET_CCOUNT() - cycles;
+  this->isrCycles += spent;
+  if (spent > this->maxIsrCycles) {
+    this->maxIsrCycles = spent;
+  }
+}
+
+void Nixie::setDigit(uint8_t tube, uint8_t digit) {
+  if (tube < this->tubeCount) {
+    this->frames[this->front ^ 1][tube] = digit;
+  }
+}
+
+void Nixie::setNumber(uint32_t value) {
+  for (int8_t tube = this->tubeCount - 1; tube >= 0; tube--) {
+    this->setDigit(tube, value % 10);
+    value /= 10;
+  }
+}
+
+void Nixie::swap() {
+  uint8_t back = this->front ^ 1;
+  // A single byte store, the ISR sees either the old or the new frame
+  this->front = back;
+  // Comparing the index alone would miss a frame when two swaps land
+  // between refresh cycles
+  this->published = this->published + 1;
+  // Start the next back frame from what is being shown
+  memcpy(this->frames[back ^ 1], this->frames[back], NIXIE_MAX_TUBES);
+}
+
+void Nixie::getFrame(uint8_t *digits) {
+  memcpy(digits, this->frames[this->front], this->tubeCount);
+}
+
+void Nixie::setFadeTime(uint16_t milliseconds) {
+  uint32_t cycles = this->slotTicks > 0 ? (uint32_t)milliseconds * 1000 / (this->slotTicks * this->tubeCount) : 0;
+  this->fadeStep = cycles > 0 ? ((NIXIE_FADE_STEPS - 1) << 16) / cycles : (NIXIE_FADE_STEPS - 1) << 16;
+}
+
+void Nixie::setBrightness(uint8_t day, uint8_t night) {
+  this->brightness = day;
+  this->nightBrightness = night;
+  this->updateDuty();
+}
+
+void Nixie::setNight(bool night) {
+  this->night = night;
+  this->updateDuty();
+}
+
+void Nixie::updateDuty() {
+  // A single 16 bit store, picked up by the next slot
+  this->duty = lightnessCurve.values[this->night ? this->nightBrightness : this->brightness];
+}
+
+uint8_t Nixie::getTubeCount() {
+  return this->tubeCount;
+}
+
+NIXIESTATS Nixie::getStats() {
+  NIXIESTATS stats = { 0, 0, 0, 0 };
+  uint32_t mhz = getCpuFrequencyMhz();
+  int64_t now = esp_timer_get_time();
+  int64_t period = now - this->statsSince;
+  stats.interrupts = this->interrupts;
+  stats.maxIsrNanos = this->maxIsrCycles * 1000 / mhz;
+  stats.isrLoad = period > 0 ? this->isrCycles * 100.0 / ((double)period * mhz) : 0;
+  stats.maxJitter = this->maxJitter / mhz;
+  // Races with the ISR can lose one interrupt worth of counts, fine for stats
+  this->interrupts = 0;
+  this->isrCycles = 0;
+  this->maxIsrCycles = 0;
+  this->maxJitter = 0;
+  this->statsSince = now;
+  return stats;
+}
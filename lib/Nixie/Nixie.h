@@ -4,7 +4,7 @@
  * @summary      : Nixie handler based on the 74141 driver
  * @version      : 1.0.0
  * @project      : Nixie Clock
- * @description  : Nixie handler based on the 74141 driver
+ * @description  : Multiplexed nixie display driver refreshed from a hardware timer
  * @author       : Benjamin Maggi
  * @email        : benjaminmaggi@gmail.com
  * @date         : 08 Aug 2021
@@ -36,16 +36,125 @@
 
 #pragma once
 #include "Arduino.h"
-#include <Udp.h>
+#include <esp_timer.h>
+#include <soc/gpio_struct.h>
+#include <soc/timer_group_struct.h>
+#include <xtensa/core-macros.h>
 
-#define SEVENZYYEARS 2208988800UL
-#define NTP_PACKET_SIZE 48
-#define NTP_DEFAULT_LOCAL_PORT 1337
+#define NIXIE_MAX_TUBES 8
+#define NIXIE_BCD_PINS 4
+#define NIXIE_BLANK 0x0F              // The 74141 turns every cathode off for BCD codes 10 - 15
+#define NIXIE_DEFAULT_REFRESH 1000    // Times per second each tube is lit (Hz)
+#define NIXIE_TIMER_DIVIDER 80        // 80 MHz APB clock / 80 = 1 us timer ticks
+#define NIXIE_BRIGHTNESS_LEVELS 256
+#define NIXIE_FADE_STEPS 64
+#define NIXIE_DEFAULT_FADE 250        // Crossfade duration (ms)
+#define NIXIE_MIN_PHASE 8             // Shorter lit or blank phases are merged into their neighbour (us)
+#define NIXIE_MAX_PHASES 3            // Outgoing digit, incoming digit, blank
+#define NIXIE_BLANKING 20             // Dark time at the end of every slot, even at full brightness (us)
+#define NIXIE_ISR_BUDGET 4000         // Longest acceptable ISR run, half the shortest phase (ns)
 
+struct NIXIEGPIOMASK {
+  uint32_t low;         // GPIO 0 - 31
+  uint32_t high;        // GPIO 32 - 39
+};
+
+struct NIXIEPHASE {
+  uint8_t digit;        // NIXIE_BLANK turns the anodes off
+  uint16_t ticks;       // In us
+};
+
+struct NIXIESTATS {
+  uint32_t interrupts;
+  uint32_t maxIsrNanos;     // Longest ISR run
+  float isrLoad;            // Share of one core spent in the ISR (%)
+  uint32_t maxJitter;       // Worst deviation from the programmed phase length (us)
+};
+
+/**
+ * Drives N tubes through one shared 74141 BCD decoder and one anode driver
+ * per tube. A hardware timer ISR gives each tube one slot per refresh
+ * cycle, so each tube is refreshed `refreshRate` times per second. Digits
+ * are written to a back frame and published with swap(), the ISR only picks
+ * up a new frame at the start of a refresh cycle so a cycle never mixes two
+ * frames. Each swap() bumps a counter the ISR compares, two swaps within one
+ * cycle leave `front` where it was but still deliver the second frame.
+ *
+ * A slot is split into up to three phases: the outgoing digit, the incoming
+ * digit and blank. The ISR reprograms the timer alarm with the length of
+ * the phase it just started, so crossfades and dimming cost at most three
+ * interrupts per slot. Every slot ends with at least NIXIE_BLANKING us
+ * blank: the anode drivers turn off slower than the 74141 switches, and
+ * without the gap the next tube's digit ghosts on the previous tube. All duty cycles come from fixed-point tables built at
+ * compile time, the ISR does no floating point.
+ */
 class Nixie {
   private:
-    unsigned long epoch;      // In s
+    static Nixie *instance;   // Timer ISRs take no argument
+    hw_timer_t *timer;
+    uint8_t timerNumber;
+    uint8_t tubeCount;
+    uint16_t slotTicks;       // In us
+    NIXIEGPIOMASK bcdMask;    // Every BCD pin
+    NIXIEGPIOMASK anodeMask;  // Every anode pin
+    NIXIEGPIOMASK digitMasks[16];
+    NIXIEGPIOMASK anodeMasks[NIXIE_MAX_TUBES];
+    uint8_t frames[2][NIXIE_MAX_TUBES];
+    volatile uint8_t front;   // Frame published to the ISR
+    volatile uint32_t published;    // Bumped by every swap()
+    uint8_t active;           // Frame the ISR is currently showing
+    uint32_t shown;           // Value of `published` the active frame came with
+    // Everything below belongs to the ISR
+    uint8_t from[NIXIE_MAX_TUBES];
+    uint8_t to[NIXIE_MAX_TUBES];
+    uint32_t fadePosition;    // Index into the fade curve, 16.16 fixed point
+    volatile uint32_t fadeStep;     // Per refresh cycle, 16.16 fixed point
+    volatile uint16_t duty;         // Lit share of a slot, 0.16 fixed point
+    uint8_t brightness;
+    uint8_t nightBrightness;
+    bool night;
+    uint8_t slot;             // Tube of the current slot
+    NIXIEPHASE phases[NIXIE_MAX_PHASES];
+    uint8_t phaseCount;
+    uint8_t phaseIndex;
+    uint32_t cyclesPerTick;   // CPU cycles per timer tick
+    uint32_t expectedCycles;  // CPU cycles the running phase should last
+    uint32_t lastCycles;
+    volatile uint32_t maxJitter;
+    volatile uint32_t interrupts;
+    volatile uint64_t isrCycles;
+    volatile uint32_t maxIsrCycles;
+    int64_t statsSince;
+    static void IRAM_ATTR onTimer();
+    void IRAM_ATTR refresh();
+    void IRAM_ATTR planSlot();
+    void IRAM_ATTR show(uint8_t tube, uint8_t digit);
+    void IRAM_ATTR setAlarm(uint16_t ticks);
+    void updateDuty();
+    static NIXIEGPIOMASK pinMask(uint8_t pin);
 
   public:
-    Nixie(unsigned long epoch);
+    Nixie(const uint8_t *bcdPins, const uint8_t *anodePins, uint8_t tubeCount);
+    /**
+     * Start refreshing from hardware timer `timerNumber`. The interrupt is
+     * allocated on the calling core, call it from the core WiFi doesn't use.
+     */
+    bool begin(uint32_t refreshRate = NIXIE_DEFAULT_REFRESH, uint8_t timerNumber = 0);
+    void end();
+    /** Write `digit` (0 - 9 or NIXIE_BLANK) of `tube` into the back frame */
+    void setDigit(uint8_t tube, uint8_t digit);
+    /** Write the last tubeCount decimal digits of `value` into the back frame */
+    void setNumber(uint32_t value);
+    /** Publish the back frame, changed digits crossfade from the next refresh cycle */
+    void swap();
+    /** Copy the last published frame, tubeCount digits, into `digits` */
+    void getFrame(uint8_t *digits);
+    /** Crossfade duration, 0 switches digits at once */
+    void setFadeTime(uint16_t milliseconds);
+    /** Perceived brightness, 0 - 255, for day and night */
+    void setBrightness(uint8_t day, uint8_t night);
+    void setNight(bool night);
+    uint8_t getTubeCount();
+    /** @return ISR timing since the last call */
+    NIXIESTATS getStats();
 };
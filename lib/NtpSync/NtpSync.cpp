@@ -0,0 +1,342 @@
+/**
+ * @file         : NtpSync.cpp
+ * @summary      : Non blocking NTP client
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Multi server NTP client with sample filtering and source selection
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "NtpSync.h"
+
+NtpSync::NtpSync(UDP &udp, const char *const *serverNames, uint8_t serverCount, long timeOffset) {
+  this->udp = &udp;
+  this->peerCount = serverCount < NTP_MAX_SERVERS ? serverCount : NTP_MAX_SERVERS;
+  for (uint8_t i = 0; i < this->peerCount; i++) {
+    memset(&this->peers[i], 0, sizeof(NTPPEER));
+    this->peers[i].serverName = serverNames[i];
+  }
+  this->timeOffset = timeOffset;
+  this->state = NTP_IDLE;
+  this->burstStep = 0;
+  this->pollExponent = NTP_MIN_POLL;
+  this->stableCount = 0;
+  this->backoff = NTP_MIN_BACKOFF;
+  this->stateSince = 0;
+  this->stateDelay = 0; // First poll goes out right away
+  this->nonceSeed = 0;
+}
+
+void NtpSync::begin(unsigned int port) {
+  this->udp->begin(port);
+}
+
+void NtpSync::setTimeOffset(long timeOffset) {
+  this->timeOffset = timeOffset;
+}
+
+unsigned long NtpSync::getPollInterval() {
+  return 1UL << this->pollExponent;
+}
+
+NtpSyncState NtpSync::getState() {
+  return this->state;
+}
+
+int64_t NtpSync::localMicros() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+void NtpSync::enter(NtpSyncState state, unsigned long now, unsigned long delay) {
+  this->state = state;
+  this->stateSince = now;
+  this->stateDelay = delay;
+}
+
+void NtpSync::backOff(unsigned long now) {
+  // Retry the whole poll later without touching the poll interval
+  this->burstStep = 0;
+  this->enter(NTP_BACKOFF, now, this->backoff);
+  this->backoff = min(this->backoff * 2, this->getPollInterval() * 1000UL);
+}
+
+bool NtpSync::poll(unsigned long now, NTPSAMPLE *sample) {
+  switch (this->state) {
+    case NTP_IDLE:
+    case NTP_BACKOFF:
+      if (now - this->stateSince < this->stateDelay) {
+        return false;
+      }
+      if (this->burstStep == 0) {
+        // New poll, start with empty sample windows
+        for (uint8_t i = 0; i < this->peerCount; i++) {
+          this->peers[i].count = 0;
+        }
+        this->resolvePeers();
+      }
+      if (this->sendRequests(now)) {
+        this->enter(NTP_REQUEST_SENT, now, NTP_REQUEST_TIMEOUT);
+      } else {
+        this->backOff(now);
+      }
+      return false;
+    case NTP_REQUEST_SENT:
+    case NTP_AWAITING_REPLY:
+      if (!this->readReplies() && now - this->stateSince < this->stateDelay) {
+        this->state = NTP_AWAITING_REPLY;
+        return false;
+      }
+      // Every server replied or the rest of the requests timed out
+      if (++this->burstStep < NTP_BURST_SIZE) {
+        this->enter(NTP_IDLE, now, NTP_BURST_SPACING);
+        return false;
+      }
+      this->burstStep = 0;
+      if (!this->selectSources(sample)) {
+        this->backOff(now);
+        return false;
+      }
+      this->adaptPollInterval(sample->offset);
+      this->backoff = NTP_MIN_BACKOFF;
+      this->enter(NTP_IDLE, now, this->getPollInterval() * 1000UL);
+      return true;
+  }
+  return false;
+}
+
+unsigned long NtpSync::nextPollDelay(unsigned long now) {
+  if (this->state == NTP_REQUEST_SENT || this->state == NTP_AWAITING_REPLY) {
+    return NTP_REPLY_CHECK_DELAY;
+  }
+  unsigned long elapsed = now - this->stateSince;
+  return elapsed < this->stateDelay ? this->stateDelay - elapsed : 0;
+}
+
+/**
+ * Look the servers up once for the whole burst. Pool names hand out a
+ * different host per lookup, samples of one window must come from one.
+ * The lookups block, the requests of the burst no longer do.
+ */
+void NtpSync::resolvePeers() {
+  for (uint8_t i = 0; i < this->peerCount; i++) {
+    IPAddress address;
+    this->peers[i].address = WiFi.hostByName(this->peers[i].serverName, address) == 1 ? (uint32_t)address : 0;
+  }
+}
+
+bool NtpSync::sendRequests(unsigned long now) {
+  bool sent = false;
+  // Drop late replies to previous requests
+  while (this->udp->parsePacket() > 0) {
+    this->udp->flush();
+  }
+  for (uint8_t i = 0; i < this->peerCount; i++) {
+    NTPPEER *peer = &this->peers[i];
+    memset(this->packetBuffer, 0, NTP_PACKET_SIZE);
+    this->packetBuffer[0] = 0b11100011;   // LI = unsynchronized, Version = 4, Mode = client
+    this->packetBuffer[2] = NTP_MIN_POLL; // Polling Interval
+    this->packetBuffer[3] = 0xEC;         // Peer Clock Precision
+    // The transmit timestamp is only checked against the reply originate timestamp
+    this->nonceSeed = (now ^ this->nonceSeed) * 2654435761UL + i + 1;
+    peer->nonce = this->nonceSeed;
+    this->packetBuffer[40] = peer->nonce >> 24;
+    this->packetBuffer[41] = peer->nonce >> 16;
+    this->packetBuffer[42] = peer->nonce >> 8;
+    this->packetBuffer[43] = peer->nonce;
+    peer->pending = false;
+    if (peer->address == 0 || !this->udp->beginPacket(IPAddress(peer->address), NTP_SERVER_PORT)) {
+      continue;
+    }
+    this->udp->write(this->packetBuffer, NTP_PACKET_SIZE);
+    peer->originTime = localMicros();
+    if (this->udp->endPacket()) {
+      peer->pending = true;
+      sent = true;
+    }
+  }
+  return sent;
+}
+
+static uint32_t readUint32(const uint8_t *buffer) {
+  return (uint32_t)buffer[0] << 24 | (uint32_t)buffer[1] << 16 | (uint32_t)buffer[2] << 8 | buffer[3];
+}
+
+int64_t NtpSync::toMicros(const uint8_t *timestamp) {
+  // 32.32 fixed point seconds since 1900, the unsigned subtraction keeps
+  // working across the 2036 era rollover
+  uint32_t seconds = readUint32(timestamp) - SEVENZYYEARS;
+  uint32_t fraction = readUint32(timestamp + 4);
+  return ((int64_t)seconds + this->timeOffset) * 1000000 + (((uint64_t)fraction * 1000000) >> 32);
+}
+
+bool NtpSync::readReplies() {
+  while (this->udp->parsePacket() > 0) {
+    int64_t destinationTime = localMicros();
+    uint32_t source = this->udp->remoteIP();
+    int size = this->udp->read(this->packetBuffer, NTP_PACKET_SIZE);
+    this->udp->flush();
+    if (size < NTP_PACKET_SIZE) {
+      continue;
+    }
+    uint8_t leap = this->packetBuffer[0] >> 6;
+    uint8_t mode = this->packetBuffer[0] & 0x07;
+    uint8_t stratum = this->packetBuffer[1];
+    // Ignore unsynchronized servers and kiss-o'-death packets
+    if (leap == 3 || mode != 4 || stratum == 0) {
+      continue;
+    }
+    uint32_t nonce = readUint32(this->packetBuffer + 24);
+    for (uint8_t i = 0; i < this->peerCount; i++) {
+      NTPPEER *peer = &this->peers[i];
+      if (!peer->pending || peer->nonce != nonce || peer->address != source) {
+        continue;
+      }
+      peer->pending = false;
+      // t1 origin, t2 server receive, t3 server transmit, t4 destination.
+      // Assuming a symmetric path the reply spent half the round trip in flight
+      int64_t receiveTime = this->toMicros(this->packetBuffer + 32);
+      int64_t transmitTime = this->toMicros(this->packetBuffer + 40);
+      int64_t offset = ((receiveTime - peer->originTime) + (transmitTime - destinationTime)) / 2;
+      int64_t delay = (destinationTime - peer->originTime) - (transmitTime - receiveTime);
+      // Long round trips mean queuing somewhere, and an asymmetric one at that
+      if (delay <= NTP_MAX_DELAY * 1000LL && peer->count < NTP_BURST_SIZE) {
+        NTPPEERSAMPLE *sample = &peer->samples[peer->count++];
+        sample->offset = offset / 1e6;
+        sample->delay = delay > 0 ? delay / 1e6 : 0;
+      }
+      break;
+    }
+  }
+  for (uint8_t i = 0; i < this->peerCount; i++) {
+    if (this->peers[i].pending) {
+      return false;
+    }
+  }
+  return true;
+}
+
+struct NTPENDPOINT {
+  double value;
+  int8_t type;    // +1 lower bound, -1 upper bound
+};
+
+bool NtpSync::selectSources(NTPSAMPLE *sample) {
+  NTPENDPOINT endpoints[2 * NTP_MAX_SERVERS];
+  uint8_t candidates = 0;
+  uint8_t count = 0;
+  // Clock filter: the lowest delay sample of each window is the one least
+  // affected by queuing on the way
+  for (uint8_t i = 0; i < this->peerCount; i++) {
+    NTPPEER *peer = &this->peers[i];
+    peer->truechimer = false;
+    if (peer->count == 0) {
+      continue;
+    }
+    peer->best = peer->samples[0];
+    for (uint8_t j = 1; j < peer->count; j++) {
+      if (peer->samples[j].delay < peer->best.delay) {
+        peer->best = peer->samples[j];
+      }
+    }
+    double bound = peer->best.delay / 2 + NTP_TIMESTAMP_PRECISION;
+    endpoints[count++] = { peer->best.offset - bound, 1 };
+    endpoints[count++] = { peer->best.offset + bound, -1 };
+    candidates++;
+  }
+  if (candidates == 0) {
+    return false;
+  }
+  // Marzullo: sort the interval endpoints, lower bounds first on ties
+  for (uint8_t i = 1; i < count; i++) {
+    NTPENDPOINT endpoint = endpoints[i];
+    int8_t j = i - 1;
+    while (j >= 0 && (endpoints[j].value > endpoint.value ||
+        (endpoints[j].value == endpoint.value && endpoints[j].type < endpoint.type))) {
+      endpoints[j + 1] = endpoints[j];
+      j--;
+    }
+    endpoints[j + 1] = endpoint;
+  }
+  // The interval contained in the most source intervals is the best guess
+  int8_t overlap = 0, bestOverlap = 0;
+  double low = 0, high = 0;
+  for (uint8_t i = 0; i + 1 < count; i++) {
+    overlap += endpoints[i].type;
+    if (overlap > bestOverlap) {
+      bestOverlap = overlap;
+      low = endpoints[i].value;
+      high = endpoints[i + 1].value;
+    }
+  }
+  // Without a majority there is no telling truechimers from falsetickers
+  if (bestOverlap * 2 <= candidates) {
+    return false;
+  }
+  // Combine the truechimers, trusting the ones with tighter bounds more
+  double weights = 0, offset = 0;
+  sample->roundTrip = NTP_MAX_DELAY / 1000.0;
+  sample->truechimers = 0;
+  for (uint8_t i = 0; i < this->peerCount; i++) {
+    NTPPEER *peer = &this->peers[i];
+    if (peer->count == 0) {
+      continue;
+    }
+    double bound = peer->best.delay / 2 + NTP_TIMESTAMP_PRECISION;
+    if (peer->best.offset - bound > high || peer->best.offset + bound < low) {
+      continue;
+    }
+    peer->truechimer = true;
+    weights += 1 / bound;
+    offset += peer->best.offset / bound;
+    sample->roundTrip = min(sample->roundTrip, peer->best.delay);
+    sample->truechimers++;
+  }
+  sample->offset = offset / weights;
+  int64_t reference = localMicros() + (int64_t)(sample->offset * 1e6);
+  sample->epochTime = (unsigned long)(reference / 1000000);
+  sample->epochMicros = (uint32_t)(reference % 1000000);
+  sample->peers = candidates;
+  return true;
+}
+
+void NtpSync::adaptPollInterval(double offset) {
+  if (fabs(offset) <= NTP_STABLE_OFFSET) {
+    if (++this->stableCount >= NTP_STABLE_SAMPLES && this->pollExponent < NTP_MAX_POLL) {
+      this->pollExponent++;
+      this->stableCount = 0;
+    }
+  } else {
+    this->stableCount = 0;
+    if (this->pollExponent > NTP_MIN_POLL) {
+      this->pollExponent--;
+    }
+  }
+}
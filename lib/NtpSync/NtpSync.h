@@ -0,0 +1,135 @@
+/**
+ * @file         : NtpSync.h
+ * @summary      : Non blocking NTP client
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Multi server NTP client with sample filtering and source selection
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#pragma once
+#include <Arduino.h>
+#include <Udp.h>
+#include <WiFi.h>
+#include <time.h>
+#include <sys/time.h>
+
+#define SEVENZYYEARS 2208988800UL
+#define NTP_PACKET_SIZE 48
+#define NTP_DEFAULT_LOCAL_PORT 1337
+#define NTP_SERVER_PORT 123
+
+#define NTP_MAX_SERVERS 4
+#define NTP_BURST_SIZE 4              // Requests per server per poll, also the sample window size
+#define NTP_BURST_SPACING 2000        // Delay between requests of a burst (ms)
+#define NTP_MAX_DELAY 1000            // Samples with a longer round trip are dropped (ms)
+#define NTP_TIMESTAMP_PRECISION 0.005 // Worst case timestamp error (s), mostly reply check latency
+
+#define NTP_MIN_POLL 6                // 2^6 = 64 s
+#define NTP_MAX_POLL 10               // 2^10 = 1024 s
+#define NTP_STABLE_SAMPLES 4          // Consecutive stable samples before the poll interval grows
+#define NTP_STABLE_OFFSET 0.128       // Max |offset| (s) for a sample to count as stable
+#define NTP_REQUEST_TIMEOUT 2000      // Per request reply timeout (ms)
+#define NTP_REPLY_CHECK_DELAY 2       // Reply polling period while requests are in flight (ms)
+#define NTP_MIN_BACKOFF 2000          // First retry delay after a failed poll (ms)
+
+enum NtpSyncState {
+  NTP_IDLE,             // Waiting for the next poll or the next request of a burst
+  NTP_REQUEST_SENT,     // Requests handed to the UDP stack, replies not checked yet
+  NTP_AWAITING_REPLY,   // Waiting for the server replies or the request timeout
+  NTP_BACKOFF           // Last poll failed, waiting before retrying
+};
+
+struct NTPSAMPLE {
+  unsigned long epochTime;  // Reference time (s) with the time offset applied
+  uint32_t epochMicros;     // Reference time fraction (us)
+  double offset;            // Reference time minus local time (s)
+  double roundTrip;         // Round trip of the best truechimer (s)
+  uint8_t peers;            // Servers with at least one usable sample
+  uint8_t truechimers;      // Servers that agree with the selected interval
+};
+
+struct NTPPEERSAMPLE {
+  double offset;            // ((t2 - t1) + (t3 - t4)) / 2 in s
+  double delay;             // (t4 - t1) - (t3 - t2) in s
+};
+
+struct NTPPEER {
+  const char *serverName;
+  uint32_t address;         // Resolved once per poll so a burst stays on one host, 0 if the lookup failed
+  uint32_t nonce;           // Sent as transmit timestamp, echoed back as originate timestamp
+  int64_t originTime;       // Local time the pending request was sent (t1, us)
+  bool pending;
+  uint8_t count;
+  NTPPEERSAMPLE samples[NTP_BURST_SIZE];
+  NTPPEERSAMPLE best;       // Lowest delay sample of the window
+  bool truechimer;
+};
+
+class NtpSync {
+  private:
+    UDP *udp;
+    NTPPEER peers[NTP_MAX_SERVERS];
+    uint8_t peerCount;
+    long timeOffset;          // In s
+    NtpSyncState state;
+    uint8_t burstStep;
+    uint8_t pollExponent;     // Poll interval is 2^pollExponent s
+    uint8_t stableCount;
+    unsigned long backoff;    // In ms
+    unsigned long stateSince; // millis() when the current state was entered
+    unsigned long stateDelay; // In ms
+    uint32_t nonceSeed;
+    uint8_t packetBuffer[NTP_PACKET_SIZE];
+    int64_t toMicros(const uint8_t *timestamp);
+    void resolvePeers();
+    bool sendRequests(unsigned long now);
+    bool readReplies();
+    bool selectSources(NTPSAMPLE *sample);
+    void adaptPollInterval(double offset);
+    void backOff(unsigned long now);
+    void enter(NtpSyncState state, unsigned long now, unsigned long delay);
+
+  public:
+    NtpSync(UDP &udp, const char *const *serverNames, uint8_t serverCount, long timeOffset = 0);
+    void begin(unsigned int port = NTP_DEFAULT_LOCAL_PORT);
+    void setTimeOffset(long timeOffset);
+    /**
+     * Advance the state machine, never blocks on the network.
+     * @return true when a new sample was written to `sample`
+     */
+    bool poll(unsigned long now, NTPSAMPLE *sample);
+    /** @return ms until poll() has work to do */
+    unsigned long nextPollDelay(unsigned long now);
+    /** @return current poll interval in s */
+    unsigned long getPollInterval();
+    NtpSyncState getState();
+    /** @return local wall clock time in us */
+    static int64_t localMicros();
+};
@@ -0,0 +1,225 @@
+/**
+ * @file         : SensorHistory.cpp
+ * @summary      : Sensor history
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Multi resolution in-memory time-series of the room sensor readings
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+#include "SensorHistory.h"
+
+SensorHistory::SensorHistory() {
+  HISTORYBUCKET *buckets[] = { this->minutes, this->quarters };
+  const uint16_t sizes[] = { HISTORY_MINUTE_SIZE, HISTORY_QUARTER_SIZE };
+  const uint32_t steps[] = { HISTORY_MINUTE_STEP, HISTORY_QUARTER_STEP };
+  this->lock = NULL;
+  this->rawHead = 0;
+  this->rawCount = 0;
+  this->rawLast = 0;
+  for (uint8_t i = 0; i < HISTORY_TIERS - 1; i++) {
+    HISTORYTIER *tier = &this->tiers[i];
+    tier->buckets = buckets[i];
+    tier->size = sizes[i];
+    tier->step = steps[i];
+    tier->first = 0;
+    tier->head = 0;
+    tier->started = false;
+  }
+}
+
+bool SensorHistory::begin() {
+  this->lock = xSemaphoreCreateMutex();
+  return this->lock != NULL;
+}
+
+int16_t SensorHistory::toFixed(float value) {
+  if (isnan(value)) {
+    return HISTORY_EMPTY;
+  }
+  float scaled = roundf(value * HISTORY_SCALE);
+  // HISTORY_EMPTY itself is reserved
+  if (scaled > INT16_MAX) {
+    return INT16_MAX;
+  } else if (scaled < INT16_MIN + 1) {
+    return INT16_MIN + 1;
+  }
+  return (int16_t)scaled;
+}
+
+uint32_t SensorHistory::rawTime(uint16_t slot) {
+  // Raw samples are never kept longer than 2 * HISTORY_RAW_SPAN, well within 16 bits
+  return this->rawLast - (uint16_t)((uint16_t)this->rawLast - this->raw[slot].time);
+}
+
+void SensorHistory::clear(HISTORYTIER *tier, uint32_t from, uint32_t to) {
+  for (uint32_t number = from; number <= to; number++) {
+    HISTORYBUCKET *bucket = &tier->buckets[number % tier->size];
+    for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++) {
+      bucket->min[ch] = HISTORY_EMPTY;
+      bucket->avg[ch] = HISTORY_EMPTY;
+      bucket->max[ch] = HISTORY_EMPTY;
+    }
+  }
+  for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++) {
+    tier->sum[ch] = 0;
+    tier->count[ch] = 0;
+  }
+}
+
+void SensorHistory::fold(HISTORYTIER *tier, uint32_t time, const int16_t *value) {
+  uint32_t number = time / tier->step;
+  if (!tier->started || number + tier->size <= tier->head || number >= tier->head + tier->size) {
+    // First sample, or the clock moved by more than the whole tier (first
+    // NTP sync after a dead RTC), nothing held so far lines up any more
+    this->clear(tier, number, number);
+    tier->started = true;
+    tier->first = number;
+    tier->head = number;
+  } else if (number > tier->head) {
+    // Close the open bucket, buckets skipped over were not sampled
+    this->clear(tier, tier->head + 1, number);
+    tier->head = number;
+  }
+  // A sample slightly in the past (clock stepped back) lands in the open bucket
+  HISTORYBUCKET *bucket = &tier->buckets[tier->head % tier->size];
+  for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++) {
+    if (value[ch] == HISTORY_EMPTY) {
+      continue;
+    }
+    if (tier->count[ch] == 0 || value[ch] < tier->min[ch]) {
+      tier->min[ch] = value[ch];
+    }
+    if (tier->count[ch] == 0 || value[ch] > tier->max[ch]) {
+      tier->max[ch] = value[ch];
+    }
+    tier->sum[ch] += value[ch];
+    tier->count[ch]++;
+    bucket->min[ch] = tier->min[ch];
+    bucket->avg[ch] = (int16_t)lroundf((float)tier->sum[ch] / tier->count[ch]);
+    bucket->max[ch] = tier->max[ch];
+  }
+}
+
+void SensorHistory::insert(uint32_t time, const float *value) {
+  int16_t fixed[HISTORY_CHANNELS];
+  for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++) {
+    fixed[ch] = toFixed(value[ch]);
+  }
+  if (this->lock == NULL || xSemaphoreTake(this->lock, portMAX_DELAY) != pdTRUE) {
+    return;
+  }
+  uint32_t sampleTime = time;
+  if (this->rawCount > 0) {
+    if (time > this->rawLast + HISTORY_RAW_SPAN || time + HISTORY_RAW_SPAN < this->rawLast) {
+      // Clock stepped, the raw ring would no longer be in order
+      this->rawCount = 0;
+    } else if (time < this->rawLast) {
+      sampleTime = this->rawLast;
+    }
+  }
+  HISTORYSAMPLE *sample = &this->raw[this->rawHead];
+  sample->time = (uint16_t)sampleTime;
+  memcpy(sample->value, fixed, sizeof(fixed));
+  this->rawHead = (this->rawHead + 1) % HISTORY_RAW_SIZE;
+  if (this->rawCount < HISTORY_RAW_SIZE) {
+    this->rawCount++;
+  }
+  this->rawLast = sampleTime;
+  while (this->rawCount > 1) {
+    uint16_t oldest = (this->rawHead + HISTORY_RAW_SIZE - this->rawCount) % HISTORY_RAW_SIZE;
+    if (this->rawLast - this->rawTime(oldest) <= HISTORY_RAW_SPAN) {
+      break;
+    }
+    this->rawCount--;
+  }
+  for (uint8_t i = 0; i < HISTORY_TIERS - 1; i++) {
+    this->fold(&this->tiers[i], time, fixed);
+  }
+  xSemaphoreGive(this->lock);
+}
+
+uint16_t SensorHistory::getCount(SensorHistoryTier tier) {
+  if (tier >= HISTORY_TIERS || this->lock == NULL || xSemaphoreTake(this->lock, portMAX_DELAY) != pdTRUE) {
+    return 0;
+  }
+  uint16_t count = this->countPoints(tier);
+  xSemaphoreGive(this->lock);
+  return count;
+}
+
+uint16_t SensorHistory::countPoints(SensorHistoryTier tier) {
+  if (tier == HISTORY_RAW) {
+    return this->rawCount;
+  }
+  HISTORYTIER *aggregate = &this->tiers[tier - HISTORY_MINUTE];
+  if (!aggregate->started) {
+    return 0;
+  }
+  uint32_t count = aggregate->head - aggregate->first + 1;
+  return count < aggregate->size ? count : aggregate->size;
+}
+
+uint32_t SensorHistory::getStep(SensorHistoryTier tier) {
+  return tier == HISTORY_RAW ? 0 : this->tiers[tier - HISTORY_MINUTE].step;
+}
+
+uint16_t SensorHistory::read(SensorHistoryTier tier, uint16_t index, HISTORYPOINT *points, uint16_t count) {
+  if (tier >= HISTORY_TIERS || this->lock == NULL || xSemaphoreTake(this->lock, portMAX_DELAY) != pdTRUE) {
+    return 0;
+  }
+  uint16_t available = this->countPoints(tier);
+  if (index >= available) {
+    count = 0;
+  } else if (count > available - index) {
+    count = available - index;
+  }
+  if (tier == HISTORY_RAW) {
+    uint16_t oldest = (this->rawHead + HISTORY_RAW_SIZE - available) % HISTORY_RAW_SIZE;
+    for (uint16_t i = 0; i < count; i++) {
+      uint16_t slot = (oldest + index + i) % HISTORY_RAW_SIZE;
+      points[i].time = this->rawTime(slot);
+      memcpy(points[i].min, this->raw[slot].value, sizeof(points[i].min));
+      memcpy(points[i].avg, this->raw[slot].value, sizeof(points[i].avg));
+      memcpy(points[i].max, this->raw[slot].value, sizeof(points[i].max));
+    }
+  } else {
+    HISTORYTIER *aggregate = &this->tiers[tier - HISTORY_MINUTE];
+    uint32_t oldest = aggregate->head - available + 1;
+    for (uint16_t i = 0; i < count; i++) {
+      uint32_t number = oldest + index + i;
+      HISTORYBUCKET *bucket = &aggregate->buckets[number % aggregate->size];
+      points[i].time = number * aggregate->step;
+      memcpy(points[i].min, bucket->min, sizeof(points[i].min));
+      memcpy(points[i].avg, bucket->avg, sizeof(points[i].avg));
+      memcpy(points[i].max, bucket->max, sizeof(points[i].max));
+    }
+  }
+  xSemaphoreGive(this->lock);
+  return count;
+}
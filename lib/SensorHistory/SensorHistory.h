@@ -0,0 +1,130 @@
+/**
+ * @file         : SensorHistory.h
+ * @summary      : Sensor history
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Multi resolution in-memory time-series of the room sensor readings
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+#pragma once
+#include <Arduino.h>
+
+#define HISTORY_CHANNELS 2            // Temperature and relative humidity
+#define HISTORY_SCALE 100             // Fixed point factor, 0.01 resolution
+#define HISTORY_EMPTY INT16_MIN       // Bucket without samples
+
+#define HISTORY_RAW_SIZE 1800         // One hour at the fastest DHT rate
+#define HISTORY_RAW_SPAN 3600         // Raw samples older than this (s) are not reported
+#define HISTORY_MINUTE_SIZE 1440      // 24 h of 1 minute buckets
+#define HISTORY_MINUTE_STEP 60
+#define HISTORY_QUARTER_SIZE 2880     // 30 days of 15 minute buckets
+#define HISTORY_QUARTER_STEP 900
+
+enum SensorHistoryTier {
+  HISTORY_RAW,
+  HISTORY_MINUTE,
+  HISTORY_QUARTER,
+  HISTORY_TIERS
+};
+
+struct HISTORYSAMPLE {
+  uint16_t time;                      // Low 16 bits of the epoch, the ring spans less than 2^16 s
+  int16_t value[HISTORY_CHANNELS];
+};
+
+struct HISTORYBUCKET {
+  int16_t min[HISTORY_CHANNELS];
+  int16_t avg[HISTORY_CHANNELS];      // HISTORY_EMPTY when the channel was not sampled
+  int16_t max[HISTORY_CHANNELS];
+};
+
+/** Aggregate tier, bucket n covers [n * step, (n + 1) * step) */
+struct HISTORYTIER {
+  HISTORYBUCKET *buckets;
+  uint16_t size;
+  uint32_t step;                      // In s
+  uint32_t first;                     // Number of the oldest bucket ever written
+  uint32_t head;                      // Number of the newest bucket
+  bool started;
+  // Running aggregate of the head bucket
+  int16_t min[HISTORY_CHANNELS];
+  int16_t max[HISTORY_CHANNELS];
+  int32_t sum[HISTORY_CHANNELS];
+  uint16_t count[HISTORY_CHANNELS];
+};
+
+/** What queries hand out, raw samples have min == avg == max */
+struct HISTORYPOINT {
+  uint32_t time;                      // Epoch of the sample or bucket start
+  int16_t min[HISTORY_CHANNELS];
+  int16_t avg[HISTORY_CHANNELS];
+  int16_t max[HISTORY_CHANNELS];
+};
+
+/**
+ * Ring buffers of 16 bit fixed point readings at three resolutions, about
+ * 62 KB all together so the whole month sits in internal RAM.
+ *
+ * Every insert folds the sample into the open bucket of each aggregate
+ * tier, there is no downsampling pass and a query is a plain copy out of
+ * the tier. Aggregate buckets carry no timestamp, their time follows from
+ * their position, minutes the sensor was not read stay HISTORY_EMPTY.
+ */
+class SensorHistory {
+  private:
+    SemaphoreHandle_t lock;
+    HISTORYSAMPLE raw[HISTORY_RAW_SIZE];
+    uint16_t rawHead;                 // Next slot to write
+    uint16_t rawCount;
+    uint32_t rawLast;                 // Epoch of the newest raw sample
+    HISTORYBUCKET minutes[HISTORY_MINUTE_SIZE];
+    HISTORYBUCKET quarters[HISTORY_QUARTER_SIZE];
+    HISTORYTIER tiers[HISTORY_TIERS - 1]; // From HISTORY_MINUTE on
+    uint32_t rawTime(uint16_t slot);
+    static int16_t toFixed(float value);
+    void clear(HISTORYTIER *tier, uint32_t from, uint32_t to);
+    void fold(HISTORYTIER *tier, uint32_t time, const int16_t *value);
+    uint16_t countPoints(SensorHistoryTier tier);   // Caller holds the lock
+
+  public:
+    SensorHistory();
+    bool begin();
+    /** Add a reading, `time` is the epoch in s, NAN values are stored as empty */
+    void insert(uint32_t time, const float *value);
+    /** @return points currently held by `tier` */
+    uint16_t getCount(SensorHistoryTier tier);
+    /** @return bucket length of `tier` in s, 0 for raw */
+    uint32_t getStep(SensorHistoryTier tier);
+    /**
+     * Copy up to `count` points of `tier` starting at `index`, 0 being the
+     * oldest, so a large tier can be sent out a block at a time.
+     * @return points copied
+     */
+    uint16_t read(SensorHistoryTier tier, uint16_t index, HISTORYPOINT *points, uint16_t count);
+};
@@ -7,8 +7,8 @@
   static const BaseType_t app_cpu = 1;
 #endif
 
-DNSServer dnsServer;
-WebServer server(80);
+CaptiveDns dnsServer;
+HttpServer server(80);
 
 const char *softAP_ssid = "nixie";
 const char *softAP_password = "12345678";
@@ -59,6 +59,51 @@ WIFI_CREDENTIAL* loadCredentials() {
 }
 
 
+/** Load POSIX TZ string from Preferences, returns 0 if none was stored */
+size_t loadTimeZone(char *timeZone, size_t size) {
+  size_t length = preferences.getString("tz", timeZone, size);
+  Serial.print("Recovered time zone: ");
+  Serial.println(length > 0 ? timeZone : "<none>");
+  return length;
+}
+
+/**
+ * GET the stored POSIX TZ string, POST tz= to replace it. It is only stored
+ * once it parses, and takes effect on the next boot.
+ */
+void handleTimeZone() {
+  // Portal task only, keeps the transition table off its stack
+  static TimeZone candidate;
+  char tz[TIMEZONE_STRING_SIZE];
+  int32_t year = civilFromDays(time(NULL) / 86400).year;
+  if (server.method() == HTTP_POST) {
+    String value = server.arg("tz");
+    if (value.length() == 0 || value.length() >= sizeof(tz) || !candidate.begin(value.c_str(), year)) {
+      server.send(400, "text/plain", "Invalid POSIX TZ string");
+      return;
+    }
+    if (preferences.putString("tz", value) != value.length()) {
+      server.send(500, "text/plain", "Time zone not saved");
+      return;
+    }
+    Serial.print("Saved time zone: ");
+    Serial.println(value);
+  }
+  if (loadTimeZone(tz, sizeof(tz)) == 0 || !candidate.begin(tz, year)) {
+    strcpy(tz, DEFAULT_TIMEZONE);
+    candidate.begin(tz, year);
+  }
+  bool dst;
+  StaticJsonDocument<192> document;
+  String response;
+  document["tz"] = tz;
+  document["offset"] = candidate.getOffset(time(NULL), &dst);
+  document["dst"] = dst;
+  document["name"] = candidate.getName(dst);
+  serializeJson(document, response);
+  server.send(200, "application/json", response);
+}
+
 /** Store WLAN credentials to Preference */
 WIFI_CREDENTIAL* saveCredentials() {
   size_t size = 0;
@@ -105,7 +150,7 @@ void initSDCard() {
   Serial.printf("SD Free Size: %lluMB\n", freeSize);
 }
 
-void setupHanlder() {
+void setupHanlder(SensorHistory *history, EventLog *eventLog) {
   BaseType_t result = pdFALSE;
   preferences.begin("CapPortAdv", false);
   Serial.print("Configuring access point...");
@@ -117,8 +162,9 @@ void setupHanlder() {
   Serial.println(WiFi.softAPIP());
 
   /* Setup the DNS server redirecting all the domains to the apIP */  
-  dnsServer.setErrorReplyCode(DNSReplyCode::NoError);
-  dnsServer.start(DNS_PORT, "*", apIP);
+  if (!dnsServer.begin(DNS_PORT, apIP)) {
+    Serial.println("DNS server failed to start");
+  }
 
   if (!MDNS.begin(myHostname))  {
     Serial.println("Error setting up MDNS responder!");
@@ -132,6 +178,9 @@ void setupHanlder() {
   
   initSDCard();
 
+  server.on("/tz", handleTimeZone);
+  httpHandler.setHistory(history);
+  httpHandler.setEventLog(eventLog);
   httpHandler.begin();
 
   Serial.println("HTTP server started");
@@ -150,7 +199,7 @@ void setupHanlder() {
   // Start AP Captive Portal and Wifi Setup task
   result = xTaskCreatePinnedToCore(handleApRequestTask,
     "AP Captive Portal and Wifi Setup",
-    2560,
+    4096,
     NULL,
     2,
     NULL,
@@ -170,9 +219,15 @@ void connectWifi() {
   Serial.println ( connRes );
 }
 
+/** Push a clock sync to the event stream subscribers, called from the NTP task */
+void publishSyncEvent(uint8_t adjustment, const EVENTLOGPAYLOAD *payload) {
+  httpHandler.notifySync(adjustment, payload);
+}
+
 void handleApRequestTask(void *parameters) {
   /** Current WLAN status */
   wl_status_t oldWifiStatus = WL_IDLE_STATUS;
+  uint32_t wait = PORTAL_WAIT;
   while(true) {
     // if (connect) {
     //   Serial.println("Connect requested");
@@ -216,12 +271,11 @@ void handleApRequestTask(void *parameters) {
       Serial.println(newWifiStatus);
       oldWifiStatus = newWifiStatus;
     }
-    // Do work:
-    //DNS
-    dnsServer.processNextRequest();
-    //HTTP
-    server.handleClient();
-
-    vTaskDelay(2 / portTICK_PERIOD_MS);
+    // Sleep until a client, a DNS query or the next event tick, the wait
+    // also caps how late a status change is logged
+    if (server.handle(wait, dnsServer.getSocket())) {
+      dnsServer.processNextRequest();
+    }
+    wait = min((uint32_t)PORTAL_WAIT, httpHandler.publishEvents());
   }
 }
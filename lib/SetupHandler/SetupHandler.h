@@ -39,26 +39,32 @@
 
 #include <WiFi.h>
 #include <WiFiClient.h>
-#include <WebServer.h>
-#include <DNSServer.h>
+#include "HttpServer.h"
+#include "CaptiveDns.h"
 #include <ESPmDNS.h>
 #include <Preferences.h>
 #include <FS.h>
 #include <SD.h>
 #include <SPI.h>
 #include "HttpHandler.h"
+#include "TimeZone.h"
 #include "utils.h"
 
 // DNS server
 #define DNS_PORT 53
+// Longest the portal task sleeps in select() with no traffic (ms)
+#define PORTAL_WAIT 1000
 struct WIFI_CREDENTIAL {
   /* Don't set this wifi credentials. They are configurated at runtime and stored on EEPROM */
   char ssid[32];
   char password[32];
 };
 
-void setupHanlder();
+void setupHanlder(SensorHistory *history, EventLog *eventLog);
+size_t loadTimeZone(char *timeZone, size_t size);
+void handleTimeZone();
 void handleApRequestTask(void *parameters);
+void publishSyncEvent(uint8_t adjustment, const EVENTLOGPAYLOAD *payload);
 
 #endif
 
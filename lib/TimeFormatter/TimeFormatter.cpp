@@ -0,0 +1,131 @@
+/**
+ * @file         : TimeFormatter.cpp
+ * @summary      : Incremental time formatter
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Caches the rendered date and time and only redraws the fields that changed
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "TimeFormatter.h"
+
+static const char *const dayNames[7] = {"Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday"};
+static const char *const monthNames[12] = {"January", "February", "March", "April", "May", "June", "July",
+  "August", "September", "October", "November", "December"};
+
+static inline void writeTwoDigits(char *buffer, uint8_t value) {
+  buffer[0] = '0' + value / 10;
+  buffer[1] = '0' + value % 10;
+}
+
+TimeFormatter::TimeFormatter() {
+  this->valid = false;
+  this->secs = 0;
+  this->day = -1;
+  this->hour = 0;
+  this->minute = 0;
+  this->second = 0;
+  this->timeIndex = 0;
+  this->date[0] = '\0';
+  this->dateTime[0] = '\0';
+}
+
+void TimeFormatter::renderDate() {
+  CIVILDATE civil = civilFromDays(this->day);
+  // 1970-01-01 was a Thursday
+  uint8_t weekDay = (uint8_t)((this->day % 7 + 11) % 7);
+  int length = snprintf(this->date, sizeof(this->date), "%s, %s %02u %04d",
+    dayNames[weekDay], monthNames[civil.month - 1], civil.day, civil.year);
+  memcpy(this->dateTime, this->date, length);
+  this->dateTime[length] = ' ';
+  this->timeIndex = length + 1;
+  memcpy(this->dateTime + this->timeIndex, "00:00:00", TIME_FORMATTER_TIME_SIZE);
+}
+
+uint8_t TimeFormatter::update(uint32_t secs) {
+  if (this->valid && secs == this->secs) {
+    return 0;
+  }
+  uint8_t changed = 0;
+  int32_t day = secs / 86400;
+  uint32_t seconds = secs % 86400;
+  uint8_t hour = seconds / 3600;
+  uint8_t minute = seconds / 60 % 60;
+  uint8_t second = seconds % 60;
+  char *time = this->dateTime + this->timeIndex;
+  if (!this->valid || day != this->day) {
+    this->day = day;
+    this->renderDate();
+    time = this->dateTime + this->timeIndex;
+    changed |= TIME_CHANGED_DAY | TIME_CHANGED_HOUR | TIME_CHANGED_MINUTE | TIME_CHANGED_SECOND;
+  } else {
+    changed |= hour != this->hour ? TIME_CHANGED_HOUR : 0;
+    changed |= minute != this->minute ? TIME_CHANGED_MINUTE : 0;
+    changed |= second != this->second ? TIME_CHANGED_SECOND : 0;
+  }
+  if (changed & TIME_CHANGED_HOUR) {
+    writeTwoDigits(time, hour);
+  }
+  if (changed & TIME_CHANGED_MINUTE) {
+    writeTwoDigits(time + 3, minute);
+  }
+  if (changed & TIME_CHANGED_SECOND) {
+    writeTwoDigits(time + 6, second);
+  }
+  this->valid = true;
+  this->secs = secs;
+  this->hour = hour;
+  this->minute = minute;
+  this->second = second;
+  return changed;
+}
+
+const char *TimeFormatter::getDateTime() {
+  return this->dateTime;
+}
+
+const char *TimeFormatter::getDate() {
+  return this->date;
+}
+
+const char *TimeFormatter::getTime() {
+  return this->dateTime + this->timeIndex;
+}
+
+uint8_t TimeFormatter::getHour() {
+  return this->hour;
+}
+
+uint8_t TimeFormatter::getMinute() {
+  return this->minute;
+}
+
+uint8_t TimeFormatter::getSecond() {
+  return this->second;
+}
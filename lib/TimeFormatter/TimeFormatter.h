@@ -0,0 +1,82 @@
+/**
+ * @file         : TimeFormatter.h
+ * @summary      : Incremental time formatter
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Caches the rendered date and time and only redraws the fields that changed
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#pragma once
+#include <Arduino.h>
+#include "DateTime.h"
+
+#define TIME_CHANGED_SECOND 0x01
+#define TIME_CHANGED_MINUTE 0x02
+#define TIME_CHANGED_HOUR   0x04
+#define TIME_CHANGED_DAY    0x08
+
+#define TIME_FORMATTER_DATE_SIZE 32   // `Wednesday, September 30 2021` plus the terminator
+#define TIME_FORMATTER_TIME_SIZE 9    // `12:34:56` plus the terminator
+
+/**
+ * Renders `%A, %B %d %Y %H:%M:%S` into preallocated buffers. The date is
+ * only rebuilt when the day changes and the time only rewrites the two
+ * digits of each field that changed. Not thread safe, use one per task.
+ */
+class TimeFormatter {
+  private:
+    bool valid;
+    uint32_t secs;
+    int32_t day;              // Days since 1970-01-01
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+    uint8_t timeIndex;        // Where the time starts within dateTime
+    char date[TIME_FORMATTER_DATE_SIZE];
+    char dateTime[TIME_FORMATTER_DATE_SIZE + TIME_FORMATTER_TIME_SIZE];
+    void renderDate();
+
+  public:
+    TimeFormatter();
+    /**
+     * Bring the buffers up to date with `secs`.
+     * @return TIME_CHANGED_* flags of the fields that changed, 0 if none
+     */
+    uint8_t update(uint32_t secs);
+    /** @return `Sunday, August 08 2021 12:34:56` */
+    const char *getDateTime();
+    /** @return `Sunday, August 08 2021` */
+    const char *getDate();
+    /** @return `12:34:56` */
+    const char *getTime();
+    uint8_t getHour();
+    uint8_t getMinute();
+    uint8_t getSecond();
+};
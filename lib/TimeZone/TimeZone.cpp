@@ -0,0 +1,295 @@
+/**
+ * @file         : TimeZone.cpp
+ * @summary      : POSIX TZ rule engine
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Parses a POSIX TZ string once and precomputes its UTC offset transitions
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "TimeZone.h"
+
+static const char *parseName(const char *cursor, char *name) {
+  const char *end;
+  uint8_t length = 0;
+  if (*cursor == '<') {
+    // Quoted form, allows digits and signs like `<-03>`
+    end = strchr(++cursor, '>');
+    if (end == NULL) {
+      return NULL;
+    }
+    length = end - cursor;
+    end++;
+  } else {
+    end = cursor;
+    while (isalpha((unsigned char)*end)) {
+      end++;
+    }
+    length = end - cursor;
+  }
+  if (length < 3 || length >= TIMEZONE_NAME_SIZE) {
+    return NULL;
+  }
+  memcpy(name, cursor, length);
+  name[length] = '\0';
+  return end;
+}
+
+/** Parses [+|-]hh[:mm[:ss]] into seconds */
+static const char *parseTime(const char *cursor, int32_t *seconds) {
+  int32_t sign = 1;
+  if (*cursor == '+' || *cursor == '-') {
+    sign = *cursor++ == '-' ? -1 : 1;
+  }
+  if (!isdigit((unsigned char)*cursor)) {
+    return NULL;
+  }
+  int32_t value = 0;
+  for (uint8_t field = 0; field < 3; field++) {
+    int32_t number = 0;
+    if (!isdigit((unsigned char)*cursor)) {
+      return NULL;
+    }
+    while (isdigit((unsigned char)*cursor)) {
+      number = number * 10 + (*cursor++ - '0');
+    }
+    value += number * (field == 0 ? 3600 : field == 1 ? 60 : 1);
+    if (*cursor != ':') {
+      break;
+    }
+    cursor++;
+  }
+  *seconds = sign * value;
+  return cursor;
+}
+
+static const char *parseNumber(const char *cursor, uint16_t *number) {
+  if (!isdigit((unsigned char)*cursor)) {
+    return NULL;
+  }
+  *number = 0;
+  while (isdigit((unsigned char)*cursor)) {
+    *number = *number * 10 + (*cursor++ - '0');
+  }
+  return cursor;
+}
+
+static const char *parseRule(const char *cursor, TZRULE *rule) {
+  uint16_t number;
+  if (*cursor == 'M') {
+    rule->type = TZ_RULE_MONTH;
+    if ((cursor = parseNumber(cursor + 1, &number)) == NULL || number < 1 || number > 12 || *cursor != '.') {
+      return NULL;
+    }
+    rule->month = number;
+    if ((cursor = parseNumber(cursor + 1, &number)) == NULL || number < 1 || number > 5 || *cursor != '.') {
+      return NULL;
+    }
+    rule->week = number;
+    if ((cursor = parseNumber(cursor + 1, &number)) == NULL || number > 6) {
+      return NULL;
+    }
+    rule->day = number;
+  } else if (*cursor == 'J') {
+    rule->type = TZ_RULE_JULIAN;
+    if ((cursor = parseNumber(cursor + 1, &number)) == NULL || number < 1 || number > 365) {
+      return NULL;
+    }
+    rule->day = number;
+  } else {
+    rule->type = TZ_RULE_DAY;
+    if ((cursor = parseNumber(cursor, &number)) == NULL || number > 365) {
+      return NULL;
+    }
+    rule->day = number;
+  }
+  rule->time = 2 * 3600;
+  if (*cursor == '/') {
+    cursor = parseTime(cursor + 1, &rule->time);
+  }
+  return cursor;
+}
+
+TimeZone::TimeZone() {
+  this->reset();
+}
+
+void TimeZone::reset() {
+  strcpy(this->stdName, "UTC");
+  strcpy(this->dstName, "UTC");
+  this->stdOffset = 0;
+  this->dstOffset = 0;
+  this->hasDst = false;
+  this->transitionCount = 0;
+  this->tableStart = 0;
+  this->tableEnd = 0;
+  this->initialOffset = 0;
+  this->initialDst = false;
+}
+
+bool TimeZone::begin(const char *tz, int32_t fromYear) {
+  const char *cursor = tz;
+  int32_t offset;
+  this->reset();
+  if ((cursor = parseName(cursor, this->stdName)) == NULL || (cursor = parseTime(cursor, &offset)) == NULL) {
+    this->reset();
+    return false;
+  }
+  this->stdOffset = this->dstOffset = -offset;
+  if (*cursor != '\0') {
+    if ((cursor = parseName(cursor, this->dstName)) == NULL) {
+      this->reset();
+      return false;
+    }
+    this->hasDst = true;
+    this->dstOffset = this->stdOffset + 3600;
+    if (*cursor != ',' && *cursor != '\0') {
+      if ((cursor = parseTime(cursor, &offset)) == NULL) {
+        this->reset();
+        return false;
+      }
+      this->dstOffset = -offset;
+    }
+    if (*cursor == ',') {
+      if ((cursor = parseRule(cursor + 1, &this->dstStart)) == NULL || *cursor != ',' ||
+          (cursor = parseRule(cursor + 1, &this->dstEnd)) == NULL || *cursor != '\0') {
+        this->reset();
+        return false;
+      }
+    } else {
+      // No rule given, POSIX leaves it to the implementation, use the US one
+      this->dstStart = { TZ_RULE_MONTH, 0, 2, 3, 2 * 3600 };
+      this->dstEnd = { TZ_RULE_MONTH, 0, 1, 11, 2 * 3600 };
+    }
+  } else {
+    strcpy(this->dstName, this->stdName);
+  }
+  if (!this->hasDst) {
+    return true;
+  }
+  // Transitions ordered by time, two per year
+  for (int32_t year = fromYear; year < fromYear + TIMEZONE_YEARS; year++) {
+    int64_t start, end;
+    this->yearTransitions(year, &start, &end);
+    TZTRANSITION dst = { (uint32_t)start, this->dstOffset, true };
+    TZTRANSITION std = { (uint32_t)end, this->stdOffset, false };
+    this->transitions[this->transitionCount++] = start < end ? dst : std;
+    this->transitions[this->transitionCount++] = start < end ? std : dst;
+  }
+  // Southern hemisphere zones start the year in DST
+  this->initialDst = !this->transitions[0].dst;
+  this->initialOffset = this->initialDst ? this->dstOffset : this->stdOffset;
+  this->tableStart = (uint32_t)(daysFromCivil(fromYear, 1, 1) * 86400LL);
+  int64_t tableEnd = daysFromCivil(fromYear + TIMEZONE_YEARS, 1, 1) * 86400LL;
+  this->tableEnd = tableEnd > UINT32_MAX ? UINT32_MAX : (uint32_t)tableEnd;
+  return true;
+}
+
+int64_t TimeZone::transitionTime(const TZRULE *rule, int32_t year, int32_t offset) {
+  int32_t days = daysFromCivil(year, 1, 1);
+  switch (rule->type) {
+    case TZ_RULE_JULIAN:
+      days += rule->day - 1 + (LEAP_YEAR(year) && rule->day >= 60 ? 1 : 0);
+      break;
+    case TZ_RULE_DAY:
+      days += rule->day;
+      break;
+    case TZ_RULE_MONTH: {
+      int32_t first = daysFromCivil(year, rule->month, 1);
+      int32_t length = daysFromCivil(rule->month == 12 ? year + 1 : year, rule->month == 12 ? 1 : rule->month + 1, 1) - first;
+      // 1970-01-01 was a Thursday
+      int32_t weekDay = (first % 7 + 11) % 7;
+      int32_t day = (rule->day - weekDay + 7) % 7 + (rule->week - 1) * 7;
+      // Week 5 means the last one, which may be the 4th
+      while (day >= length) {
+        day -= 7;
+      }
+      days = first + day;
+      break;
+    }
+  }
+  // Rule times are in the local time in effect before the transition
+  return days * 86400LL + rule->time - offset;
+}
+
+void TimeZone::yearTransitions(int32_t year, int64_t *start, int64_t *end) {
+  *start = this->transitionTime(&this->dstStart, year, this->stdOffset);
+  *end = this->transitionTime(&this->dstEnd, year, this->dstOffset);
+}
+
+int32_t TimeZone::ruleOffset(uint32_t utc, bool *dst) {
+  // Slow path outside the table, evaluate the rules for that year
+  int64_t start, end;
+  this->yearTransitions(civilFromDays(utc / 86400).year, &start, &end);
+  bool inDst = start < end ? utc >= start && utc < end : utc >= start || utc < end;
+  if (dst != NULL) {
+    *dst = inDst;
+  }
+  return inDst ? this->dstOffset : this->stdOffset;
+}
+
+int32_t TimeZone::getOffset(uint32_t utc, bool *dst) {
+  if (!this->hasDst) {
+    if (dst != NULL) {
+      *dst = false;
+    }
+    return this->stdOffset;
+  }
+  if (utc < this->tableStart || utc >= this->tableEnd) {
+    return this->ruleOffset(utc, dst);
+  }
+  // Last transition at or before utc
+  int16_t low = 0, high = this->transitionCount;
+  while (low < high) {
+    int16_t middle = (low + high) / 2;
+    if (this->transitions[middle].utc <= utc) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  if (low == 0) {
+    if (dst != NULL) {
+      *dst = this->initialDst;
+    }
+    return this->initialOffset;
+  }
+  if (dst != NULL) {
+    *dst = this->transitions[low - 1].dst;
+  }
+  return this->transitions[low - 1].offset;
+}
+
+uint32_t TimeZone::toLocal(uint32_t utc, bool *dst) {
+  return utc + this->getOffset(utc, dst);
+}
+
+const char *TimeZone::getName(bool dst) {
+  return dst ? this->dstName : this->stdName;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file         : TimeZone.h
+ * @summary      : POSIX TZ rule engine
+ * @version      : 1.0.0
+ * @project      : Nixie Clock
+ * @description  : Parses a POSIX TZ string once and precomputes its UTC offset transitions
+ * @author       : Benjamin Maggi
+ * @email        : benjaminmaggi@gmail.com
+ * @date         : 17 Oct 2026
+ * @license:     : MIT
+ *
+ * Copyright 2021 Benjamin Maggi <benjaminmaggi@gmail.com>
+ *
+ *
+ * License:
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#pragma once
+#include <Arduino.h>
+#include "DateTime.h"
+
+#define TIMEZONE_YEARS 16                         // Years covered by the transition table
+#define TIMEZONE_MAX_TRANSITIONS (TIMEZONE_YEARS * 2)
+#define TIMEZONE_NAME_SIZE 16
+#define TIMEZONE_STRING_SIZE 64
+#define DEFAULT_TIMEZONE "<-03>3"                 // Argentina, no DST
+
+enum TimeZoneRuleType {
+  TZ_RULE_JULIAN,       // Jn, 1 - 365, February 29 is never counted
+  TZ_RULE_DAY,          // n, 0 - 365, February 29 is counted
+  TZ_RULE_MONTH         // Mm.w.d, day d of week w of month m
+};
+
+struct TZRULE {
+  TimeZoneRuleType type;
+  uint16_t day;
+  uint8_t week;
+  uint8_t month;
+  int32_t time;         // Local time of day the transition happens at (s)
+};
+
+struct TZTRANSITION {
+  uint32_t utc;         // First second the new offset applies
+  int32_t offset;       // Local minus UTC (s)
+  bool dst;
+};
+
+class TimeZone {
+  private:
+    char stdName[TIMEZONE_NAME_SIZE];
+    char dstName[TIMEZONE_NAME_SIZE];
+    int32_t stdOffset;    // Local minus UTC (s), note POSIX TZ strings use the opposite sign
+    int32_t dstOffset;
+    bool hasDst;
+    TZRULE dstStart;
+    TZRULE dstEnd;
+    TZTRANSITION transitions[TIMEZONE_MAX_TRANSITIONS];
+    uint8_t transitionCount;
+    uint32_t tableStart;  // UTC range covered by the transition table
+    uint32_t tableEnd;
+    int32_t initialOffset;
+    bool initialDst;
+    void reset();
+    int64_t transitionTime(const TZRULE *rule, int32_t year, int32_t offset);
+    void yearTransitions(int32_t year, int64_t *start, int64_t *end);
+    int32_t ruleOffset(uint32_t utc, bool *dst);
+
+  public:
+    TimeZone();
+    /**
+     * Parse a POSIX TZ string like `CET-1CEST,M3.5.0,M10.5.0/3` and build the
+     * transition table for TIMEZONE_YEARS years starting at `fromYear`.
+     * @return false if the string is malformed, the zone is left as UTC
+     */
+    bool begin(const char *tz, int32_t fromYear);
+    /** @return local minus UTC (s) at `utc` */
+    int32_t getOffset(uint32_t utc, bool *dst = NULL);
+    /** @return `utc` converted to local time */
+    uint32_t toLocal(uint32_t utc, bool *dst = NULL);
+    /** @return zone abbreviation, e.g. `CET` or `CEST` */
+    const char *getName(bool dst);
+};
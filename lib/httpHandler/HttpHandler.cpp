@@ -1,9 +1,16 @@
 #include "httpHandler.h"
 
-HttpHandler::HttpHandler(WebServer *server, const char *hostname, IPAddress *accessPointIp) {
+HttpHandler::HttpHandler(HttpServer *server, const char *hostname, IPAddress *accessPointIp) {
   this->server = server;
   this->hostname = hostname;
   this->accessPointIp = accessPointIp;
+  this->history = NULL;
+  this->eventLog = NULL;
+  this->syncEvents = NULL;
+  this->lastTick = 0;
+  // The server drops every request header it wasn't asked to keep
+  static const char *headers[] = { "Accept-Encoding", "If-None-Match" };
+  this->server->collectHeaders(headers, 2);
 
 /* Setup web pages: root, wifi config pages, SO captive portal detectors and not found. */
   this->server->on("/", [this]() {
@@ -15,18 +22,40 @@ HttpHandler::HttpHandler(WebServer *server, const char *hostname, IPAddress *acc
   this->server->on("/rtc", HTTP_GET, [this]() {
     return this->getRtcTime();
   });
+  this->server->on("/history", HTTP_GET, [this]() {
+    return this->getHistory();
+  });
+  this->server->on("/log", HTTP_GET, [this]() {
+    return this->getLog();
+  });
+  this->server->on("/cache", HTTP_GET, [this]() {
+    return this->getCacheStats();
+  });
+  this->server->on("/events", HTTP_GET, [this]() {
+    return this->getEvents();
+  });
   this->server->on("/inline", [this]() {
     this->server->send(200, "text/plain", "this works as well");
   });
   this->server->onNotFound([this](){
     return this->handleNotFound();
   });
-  this->server->serveStatic("/", SD, "/");
 }
 
 
+void HttpHandler::setHistory(SensorHistory *history) {
+  this->history = history;
+}
+
+void HttpHandler::setEventLog(EventLog *eventLog) {
+  this->eventLog = eventLog;
+}
+
 void HttpHandler::begin() {
-  return this->server->begin(); // Web server start
+  this->syncEvents = createMessageQueue<SYNCEVENT>(EVENT_QUEUE_LENGTH);
+  if (!this->server->begin()) { // Web server start
+    Serial.println("HTTP server failed to listen");
+  }
 }
 
 void HttpHandler::stop() {
@@ -35,13 +64,9 @@ void HttpHandler::stop() {
 
 /** Redirect to captive portal if we got a request for another domain. Return true in that case so the page handler do not try to handle the request again. */
 boolean HttpHandler::captivePortal() {
-  Serial.print("hostHeader: ");
-  Serial.println(this->server->hostHeader());
   if (!isIp(this->server->hostHeader()) && this->server->hostHeader() != (String(this->hostname)+".local")) {
-    Serial.print("Request redirected to captive portal");
-    this->server->sendHeader("Location", String("http://") + toStringIp(server->client().localIP()), true);
-    this->server->send ( 302, "text/plain", ""); // Empty content inhibits Content-length header so we have to close the socket ourselves.
-    this->server->client().stop(); // Stop is needed because we sent no content length
+    this->server->sendHeader("Location", String("http://") + toStringIp(this->server->localIP()), true);
+    this->server->send ( 302, "text/plain", "");
     return true;
   }
   return false;
@@ -52,50 +77,340 @@ void HttpHandler::handleRoot() {
   if (this->captivePortal()) { // If caprive portal redirect instead of displaying the page.
     return;
   }
-  fs::FS &fs = SD;
-  String path = server->uri(); //saves the to a string server uri ex.(192.168.100.110/edit server uri is "/edit")
-  Serial.print("path ");
-  Serial.println(path);
+  if (!this->serveFile(this->server->uri())) {
+    this->sendNotFound();
+  }
+}
+
+/** Answer a conditional request whose validator still matches */
+boolean HttpHandler::notModified(const char *etag) {
+  if (this->server->header("If-None-Match") != etag) {
+    return false;
+  }
+  this->server->sendHeader("ETag", etag);
+  this->server->send(304);
+  this->assets.countNotModified();
+  return true;
+}
 
-  //To send the index.html when the serves uri is "/"
+/** Send a file from the card, through the asset cache. Return false if there is no such file. */
+boolean HttpHandler::serveFile(String path) {
   if (path.endsWith("/")) {
     path += "index.html";
   }
-  String contentType = getContentType(server, path);
-  Serial.print("contentType ");
-  Serial.println(contentType);
-  File file = fs.open(path, "r"); //Open the File with file name = to path with intention to read it. For other modes see <a href="https://arduino-esp8266.readthedocs.io/en/latest/filesystem.html" style="font-size: 13.5px;"> https://arduino-esp8266.readthedocs.io/en/latest/...</a>
-  size_t sent = this->server->streamFile(file, contentType); //sends the file to the server references from <a href="https://github.com/espressif/arduino-esp32/blob/master/libraries/WebServer/src/WebServer.h" style="font-size: 13.5px;"> https://arduino-esp8266.readthedocs.io/en/latest/...</a>
-  if (sent != file.size()) {
-    Serial.println("Sent less data than expected!");
+  const char *contentType = getContentType(this->server, std::string_view(path.c_str(), path.length()));
+  boolean acceptsGzip = this->server->header("Accept-Encoding").indexOf("gzip") >= 0 && !path.endsWith(".gz");
+  const ASSETENTRY *entry = this->assets.get(path.c_str(), acceptsGzip);
+  File file;
+  boolean gzip = false;
+  char etag[ASSET_CACHE_ETAG_SIZE];
+  if (entry == NULL) {
+    fs::FS &fs = SD;
+    // Prefer the precompressed copy, it is smaller to keep and to send
+    gzip = acceptsGzip && fs.exists(path + ".gz");
+    file = fs.open(gzip ? path + ".gz" : path, FILE_READ);
+    if (!file || file.isDirectory()) {
+      return false;
+    }
+    AssetCache::makeETag(etag, file);
+    entry = this->assets.put(path.c_str(), acceptsGzip, gzip, etag, file);
   }
-  Serial.print("sent: ");
-  Serial.println(sent);
-  file.close(); //Close the file
+  if (this->notModified(entry != NULL ? entry->etag : etag)) {
+    file.close();
+    return true;
+  }
+  this->server->sendHeader("ETag", entry != NULL ? entry->etag : etag);
+  // Pages are always revalidated, the rest is good for a while
+  this->server->sendHeader("Cache-Control", strcmp(contentType, "text/html") == 0 ? "no-cache" : "max-age=" HTTP_ASSET_MAX_AGE);
+  if (acceptsGzip) {
+    this->server->sendHeader("Vary", "Accept-Encoding");
+  }
+  if (entry != NULL) {
+    file.close();
+    if (entry->gzip) {
+      this->server->sendHeader("Content-Encoding", "gzip");
+    }
+    // The response holds its own reference, eviction can't pull the data from under it
+    std::shared_ptr<uint8_t> data = entry->data;
+    size_t size = entry->size;
+    size_t offset = 0;
+    this->server->sendStream(200, contentType, size, [data, size, offset](uint8_t *buffer, size_t room) mutable {
+      size_t count = min(room, size - offset);
+      memcpy(buffer, data.get() + offset, count);
+      offset += count;
+      return count;
+    });
+    this->assets.countSent(this->server->method() == HTTP_HEAD ? 0 : size, true);
+    return true;
+  }
+  // Too big to keep, streamFile() adds Content-Encoding for .gz files itself
+  // The server keeps the file open and closes it once the body is out
+  size_t sent = this->server->streamFile(file, contentType);
+  this->assets.countSent(this->server->method() == HTTP_HEAD ? 0 : sent, false);
+  return true;
 }
 
 void HttpHandler::getIp() {
   // To get an approximate value for the document site go to: https://arduinojson.org/v6/assistant/
   StaticJsonDocument<128> document;
   String response;
-  document["apIP"] = this->server->client().localIP();
+  document["apIP"] = this->server->localIP();
   document["localIP"] = this->accessPointIp->toString();
   serializeJson(document, response);
   this->server->send(200, "application/json", response);
 }
 
 void HttpHandler::getRtcTime() {
-  StaticJsonDocument<32> document;
+  StaticJsonDocument<96> document;   // Two members and a copy of the ISO string
   String response;
-  document["rtc"] = esp32Time.getEpoch();
+  char iso[ISO8601_SIZE];
+  uint32_t now = esp32Time.getEpoch();
+  formatIso8601(iso, sizeof(iso), now);
+  document["rtc"] = now;
+  document["iso"] = iso;
   serializeJson(document, response);
   this->server->send(200, "application/json", response);
 }
 
+/** Where a /history response is at, kept with the connection until the body is out */
+struct HISTORYSTREAM {
+  SensorHistory *history;
+  const char *name;
+  uint8_t tier;
+  uint8_t phase;                       // Head, points, tail, done
+  uint16_t index;
+};
+
+/** Fill `buffer` with as much of the history body as whole points fit */
+static size_t produceHistory(HISTORYSTREAM *stream, uint8_t *buffer, size_t size) {
+  char *out = (char *)buffer;
+  size_t length = 0;
+  if (stream->phase == 0) {
+    length = snprintf(out, size, "{\"tier\":\"%s\",\"step\":%lu,\"scale\":%d,\"channels\":[\"temperature\",\"humidity\"],\"points\":[",
+      stream->name, (unsigned long)stream->history->getStep((SensorHistoryTier)stream->tier), HISTORY_SCALE);
+    stream->phase = 1;
+  }
+  HISTORYPOINT points[HISTORY_BLOCK_SIZE];
+  while (stream->phase == 1 && size - length >= HISTORY_POINT_SIZE) {
+    // Copy out no more than there is room to print, the rest waits for the socket
+    uint16_t count = min((size_t)HISTORY_BLOCK_SIZE, (size - length) / HISTORY_POINT_SIZE);
+    count = stream->history->read((SensorHistoryTier)stream->tier, stream->index, points, count);
+    if (count == 0) {
+      stream->phase = 2;
+    }
+    for (uint16_t i = 0; i < count; i++) {
+      HISTORYPOINT *point = &points[i];
+      length += sprintf(out + length, "%s[%lu", stream->index + i > 0 ? ",": "", (unsigned long)point->time);
+      for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++) {
+        if (point->avg[ch] == HISTORY_EMPTY) {
+          length += sprintf(out + length, stream->tier == HISTORY_RAW ? ",null" : ",null,null,null");
+        } else if (stream->tier == HISTORY_RAW) {
+          length += sprintf(out + length, ",%d", point->avg[ch]);
+        } else {
+          length += sprintf(out + length, ",%d,%d,%d", point->min[ch], point->avg[ch], point->max[ch]);
+        }
+      }
+      out[length++] = ']';
+    }
+    stream->index += count;
+  }
+  if (stream->phase == 2 && size - length >= 2) {
+    memcpy(out + length, "]}", 2);
+    length += 2;
+    stream->phase = 3;
+  }
+  return length;
+}
+
+/** Stream one tier of the sensor history, ?tier=raw|minute|quarter, values are fixed point */
+void HttpHandler::getHistory() {
+  static const char *const tierNames[HISTORY_TIERS] = { "raw", "minute", "quarter" };
+  if (this->history == NULL) {
+    this->server->send(503, "text/plain", "History not available");
+    return;
+  }
+  String name = this->server->hasArg("tier") ? this->server->arg("tier") : String(tierNames[HISTORY_QUARTER]);
+  uint8_t tier = 0;
+  while (tier < HISTORY_TIERS && name != tierNames[tier]) {
+    tier++;
+  }
+  if (tier == HISTORY_TIERS) {
+    this->server->send(400, "text/plain", "Unknown tier");
+    return;
+  }
+  // A month of buckets is way past any JsonDocument, the server asks for it
+  // a buffer at a time as the socket drains. Raw points are
+  // [time, temperature, humidity], buckets are
+  // [time, min, avg, max, min, avg, max], null where nothing was sampled
+  std::shared_ptr<HISTORYSTREAM> stream(new HISTORYSTREAM { this->history, tierNames[tier], tier, 0, 0 });
+  this->server->sendStream(200, "application/json", CONTENT_LENGTH_UNKNOWN, [stream](uint8_t *buffer, size_t size) {
+    return produceHistory(stream.get(), buffer, size);
+  });
+}
+
+/** Where a /log response is at, kept with the connection until the body is out */
+struct LOGSTREAM {
+  EventLog *eventLog;
+  uint32_t to;
+  uint16_t count;
+  uint8_t phase;                       // Head, records, tail, done
+  EVENTLOGCURSOR cursor;
+};
+
+/** Fill `buffer` with as many whole log records as fit */
+static size_t produceLog(LOGSTREAM *stream, uint8_t *buffer, size_t size) {
+  char *out = (char *)buffer;
+  size_t length = 0;
+  if (stream->phase == 0) {
+    length = sprintf(out, "{\"records\":[");
+    stream->phase = 1;
+  }
+  EVENTLOGRECORD record;
+  while (stream->phase == 1 && size - length >= LOG_RECORD_SIZE) {
+    if (stream->count >= LOG_MAX_RECORDS || !stream->eventLog->read(&stream->cursor, &record) || record.time > stream->to) {
+      stream->phase = 2;
+      break;
+    }
+    // Printed apart so a record that somehow runs long is cut, not overflowing
+    char line[LOG_RECORD_SIZE];
+    int used = snprintf(line, sizeof(line), "%s[%lu,%u,%u", stream->count++ > 0 ? "," : "",
+      (unsigned long)record.time, (unsigned int)record.milliseconds, (unsigned int)record.type);
+    if (record.type == EVENTLOG_SENSOR) {
+      used += snprintf(line + used, sizeof(line) - used, ",%.2f,%.2f", record.payload.sensor.temperature, record.payload.sensor.humidity);
+    } else if (record.type == EVENTLOG_SYNC) {
+      used += snprintf(line + used, sizeof(line) - used, ",%u,%.6f,%.6f,%.6f,%.3f", (unsigned int)record.flags,
+        record.payload.sync.offset, record.payload.sync.roundTrip, record.payload.sync.residual, record.payload.sync.frequency);
+    }
+    used = min(used, (int)sizeof(line) - 1);
+    memcpy(out + length, line, used);
+    length += used;
+    out[length++] = ']';
+  }
+  if (stream->phase == 2 && size - length >= 2) {
+    memcpy(out + length, "]}", 2);
+    length += 2;
+    stream->phase = 3;
+  }
+  return length;
+}
+
+/** Stream the event log records in ?from=&to= (epoch s), the last day by default */
+void HttpHandler::getLog() {
+  uint32_t now = esp32Time.getEpoch();
+  uint32_t from = this->server->hasArg("from") ? strtoul(this->server->arg("from").c_str(), NULL, 10) : now - 86400;
+  uint32_t to = this->server->hasArg("to") ? strtoul(this->server->arg("to").c_str(), NULL, 10) : UINT32_MAX;
+  // A cursor holds a whole sector, keep it off the task stack. It lives with
+  // the connection until the last record is out
+  std::shared_ptr<LOGSTREAM> stream((LOGSTREAM *)malloc(sizeof(LOGSTREAM)), free);
+  if (!stream || this->eventLog == NULL || !this->eventLog->seek(from, &stream->cursor)) {
+    this->server->send(503, "text/plain", "Event log not available");
+    return;
+  }
+  stream->eventLog = this->eventLog;
+  stream->to = to;
+  stream->count = 0;
+  stream->phase = 0;
+  // Sensor records are [time, ms, 1, temperature, humidity], sync records
+  // [time, ms, 2, adjustment, offset, round trip, residual, frequency]
+  this->server->sendStream(200, "application/json", CONTENT_LENGTH_UNKNOWN, [stream](uint8_t *buffer, size_t size) {
+    return produceLog(stream.get(), buffer, size);
+  });
+}
+
+void HttpHandler::getCacheStats() {
+  StaticJsonDocument<256> document;
+  String response;
+  ASSETCACHESTATS stats = this->assets.getStats();
+  uint32_t lookups = stats.hits + stats.misses;
+  document["hits"] = stats.hits;
+  document["misses"] = stats.misses;
+  document["hitRate"] = lookups > 0 ? (float)stats.hits / lookups : 0;
+  document["notModified"] = stats.notModified;
+  document["cacheBytes"] = stats.cacheBytes;
+  document["cardBytes"] = stats.cardBytes;
+  document["usedBytes"] = stats.usedBytes;
+  document["entries"] = stats.entries;
+  serializeJson(document, response);
+  this->server->send(200, "application/json", response);
+}
+
+/** Serialize the tick event, sensor values are fixed point like /history and null until sampled */
+size_t HttpHandler::formatTick(char *event, uint32_t time) {
+  HISTORYPOINT point;
+  uint16_t count = this->history != NULL ? this->history->getCount(HISTORY_RAW) : 0;
+  bool sampled = count > 0 && this->history->read(HISTORY_RAW, count - 1, &point, 1) == 1;
+  char value[HISTORY_CHANNELS][8];
+  for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++) {
+    if (sampled && point.avg[ch] != HISTORY_EMPTY) {
+      sprintf(value[ch], "%d", point.avg[ch]);
+    } else {
+      strcpy(value[ch], "null");
+    }
+  }
+  return snprintf(event, EVENT_SIZE, "event: tick\ndata: {\"time\":%lu,\"temperature\":%s,\"humidity\":%s}\n\n",
+    (unsigned long)time, value[0], value[1]);
+}
+
+/** Subscribe to the event stream, a tick every second and a sync event on each NTP update */
+void HttpHandler::getEvents() {
+  if (!this->server->startEventStream()) {
+    return;
+  }
+  // Don't leave a new dashboard blank until the next tick
+  char event[EVENT_SIZE];
+  size_t length = this->formatTick(event, esp32Time.getEpoch());
+  this->server->sendContent("retry: " EVENT_RETRY "\n\n");
+  this->server->sendContent(event, length);
+}
+
+void HttpHandler::notifySync(uint8_t adjustment, const EVENTLOGPAYLOAD *payload) {
+  if (this->syncEvents == NULL) {
+    return;
+  }
+  SYNCEVENT event = { (uint32_t)esp32Time.getEpoch(), adjustment, payload->sync.offset,
+    payload->sync.roundTrip, payload->sync.residual, payload->sync.frequency };
+  // Never hold up the clock for a dashboard, a full queue drops the event
+  if (sendMessage(this->syncEvents, &event, 0) == pdTRUE) {
+    this->server->wake();
+  }
+}
+
+uint32_t HttpHandler::publishEvents() {
+  // Each event is serialized once whatever the number of subscribers
+  char event[EVENT_SIZE];
+  bool subscribed = this->server->getStats().streams > 0;
+  SYNCEVENT sync;
+  while (this->syncEvents != NULL && receiveMessage(this->syncEvents, &sync, 0) == pdTRUE) {
+    if (subscribed) {
+      size_t length = snprintf(event, EVENT_SIZE,
+        "event: sync\ndata: {\"time\":%lu,\"adjustment\":%u,\"offset\":%.6f,\"roundTrip\":%.6f,\"residual\":%.6f,\"frequency\":%.3f}\n\n",
+        (unsigned long)sync.time, sync.adjustment, sync.offset, sync.roundTrip, sync.residual, sync.frequency);
+      this->server->broadcast(event, length);
+    }
+  }
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  if (subscribed && (uint32_t)now.tv_sec != this->lastTick) {
+    this->lastTick = now.tv_sec;
+    this->server->broadcast(event, this->formatTick(event, now.tv_sec));
+  }
+  // Wake just past the second boundary so ticks follow the clock
+  return 1000 - now.tv_usec / 1000;
+}
+
 void HttpHandler::handleNotFound() {
   if (this->captivePortal()) { // If caprive portal redirect instead of displaying the error page.
     return;
   }
+  // Everything on the card that isn't a route of its own
+  HTTPMethod method = this->server->method();
+  if ((method == HTTP_GET || method == HTTP_HEAD) && this->serveFile(this->server->uri())) {
+    return;
+  }
+  this->sendNotFound();
+}
+
+void HttpHandler::sendNotFound() {
   String message = "File Not Found\n\n";
   message += "URI: ";
   message += this->server->uri();
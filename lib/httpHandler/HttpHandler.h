@@ -1,25 +1,72 @@
 #pragma once
 #define ARDUINOJSON_USE_LONG_LONG 1
-#include <WebServer.h>
+#include "HttpServer.h"
 #include <FS.h>
 #include <SD.h>
 #include <ArduinoJson.h>
 #include <ESP32Time.h>
 #include "utils.h"
+#include "SensorHistory.h"
+#include "EventLog.h"
+#include "AssetCache.h"
+#include "MessageQueue.h"
+#include "DateTime.h"
+
+#define HISTORY_BLOCK_SIZE 16          // Points copied out of the history at a time
+#define HISTORY_POINT_SIZE 64          // Longest point as printed
+#define LOG_RECORD_SIZE 160            // Room kept for a record as printed
+#define LOG_MAX_RECORDS 4096           // Per request, ask again from the last time for more
+#define HTTP_ASSET_MAX_AGE "3600"      // Cache lifetime of everything but pages (s)
+#define EVENT_SIZE 192                 // One serialized event stream message
+#define EVENT_QUEUE_LENGTH 4           // Sync events waiting for the portal task
+#define EVENT_RETRY "3000"             // Reconnect delay asked of EventSource clients (ms)
+
+/** Clock sync as handed over by the NTP task */
+struct SYNCEVENT {
+  uint32_t time;
+  uint8_t adjustment;                  // ClockAdjustmentType
+  float offset;
+  float roundTrip;
+  float residual;
+  float frequency;
+};
 
 class HttpHandler {
   private:
-    WebServer* server;
+    HttpServer* server;
     const char *hostname;
     IPAddress *accessPointIp;
     boolean captivePortal();
+    boolean notModified(const char *etag);
+    boolean serveFile(String path);
+    void sendNotFound();
     ESP32Time esp32Time;
+    SensorHistory *history;
+    EventLog *eventLog;
+    AssetCache assets;
+    QueueHandle_t syncEvents;
+    uint32_t lastTick;                 // Epoch of the last tick event
+    size_t formatTick(char *event, uint32_t time);
   public:
-    HttpHandler(WebServer *server, const char *hostname, IPAddress *accessPointIp);
+    HttpHandler(HttpServer *server, const char *hostname, IPAddress *accessPointIp);
     void handleRoot();
     void getIp();
     void getRtcTime();
+    void getHistory();
+    void getLog();
+    void getCacheStats();
+    void getEvents();
     void handleNotFound();
+    void setHistory(SensorHistory *history);
+    void setEventLog(EventLog *eventLog);
     void begin();
+    /** Queue a sync event for the subscribers, safe from any task */
+    void notifySync(uint8_t adjustment, const EVENTLOGPAYLOAD *payload);
+    /**
+     * Send the queued sync events and, on a new second, the tick event.
+     * Portal task only.
+     * @return ms until the next tick is due
+     */
+    uint32_t publishEvents();
     void stop();
 };
@@ -21,34 +21,72 @@ String toStringIp(IPAddress ip) {
   return res;
 }
 
-//This functions returns a String of content type
-String getContentType(WebServer *server, String filename) {
+// The seed that spreads mimeTypes over the table without collisions is
+// searched for at compile time
+static constexpr size_t mimeTypeCount = sizeof(mimeTypes) / sizeof(mimeTypes[0]);
+static constexpr size_t mimeTableSize = 32;   // Power of two, about twice the types keeps the search short
+static_assert(mimeTypeCount < mimeTableSize && mimeTypeCount < 256, "Grow mimeTableSize");
+
+struct MIMETABLE {
+  uint32_t seed;
+  uint8_t slots[mimeTableSize];   // Index into mimeTypes plus one, 0 for none
+};
+
+static constexpr size_t constLength(const char *text) {
+  size_t length = 0;
+  while (text[length] != '\0') {
+    length++;
+  }
+  return length;
+}
+
+/** Seeded FNV-1a, folded so the low bits see the whole word */
+static constexpr uint32_t mimeHash(const char *extension, size_t length, uint32_t seed) {
+  uint32_t hash = seed;
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ (uint8_t)extension[i]) * 16777619u;
+  }
+  return (hash ^ (hash >> 16)) & (mimeTableSize - 1);
+}
+
+static constexpr MIMETABLE buildMimeTable() {
+  for (uint32_t seed = 2166136261u; ; seed++) {
+    MIMETABLE table = { seed, {} };
+    size_t placed = 0;
+    while (placed < mimeTypeCount) {
+      const char *extension = mimeTypes[placed].extension;
+      uint8_t &slot = table.slots[mimeHash(extension, constLength(extension), seed)];
+      if (slot != 0) {
+        break;
+      }
+      slot = placed + 1;
+      placed++;
+    }
+    if (placed == mimeTypeCount) {
+      return table;
+    }
+  }
+}
+
+static constexpr MIMETABLE mimeTable = buildMimeTable();
+
+/** Mime type of `filename` from its extension, without allocating */
+const char *getContentType(std::string_view filename) {
+  size_t dot = filename.rfind('.');
+  if (dot == std::string_view::npos) {
+    return "text/plain";
+  }
+  std::string_view extension = filename.substr(dot + 1);
+  uint8_t slot = mimeTable.slots[mimeHash(extension.data(), extension.size(), mimeTable.seed)];
+  if (slot != 0 && extension == mimeTypes[slot - 1].extension) {
+    return mimeTypes[slot - 1].type;
+  }
+  return "text/plain";
+}
+
+const char *getContentType(HttpServer *server, std::string_view filename) {
   if (server->hasArg("download")) { // check if the parameter "download" exists
     return "application/octet-stream";
-  } else if (filename.endsWith(".htm")) { //check if the string filename ends with ".htm"
-    return "text/html";
-  } else if (filename.endsWith(".html")) {
-    return "text/html";
-  } else if (filename.endsWith(".css")) {
-    return "text/css";
-  } else if (filename.endsWith(".js")) {
-    return "application/javascript";
-  } else if (filename.endsWith(".png")) {
-    return "image/png";
-  } else if (filename.endsWith(".gif")) {
-    return "image/gif";
-  } else if (filename.endsWith(".jpg")) {
-    return "image/jpeg";
-  } else if (filename.endsWith(".ico")) {
-    return "image/x-icon";
-  } else if (filename.endsWith(".xml")) {
-    return "text/xml";
-  } else if (filename.endsWith(".pdf")) {
-    return "application/x-pdf";
-  } else if (filename.endsWith(".zip")) {
-    return "application/x-zip";
-  } else if (filename.endsWith(".gz")) {
-    return "application/x-gzip";
   }
-  return "text/plain";
-}
\ No newline at end of file
+  return getContentType(filename);
+}
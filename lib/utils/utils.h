@@ -1,11 +1,39 @@
 #pragma once
 #include <WiFi.h>
-#include <WebServer.h>
+#include "HttpServer.h"
+#include <string_view>
+
+struct MIMETYPE {
+  const char *extension;        // Without the dot
+  const char *type;
+};
+
+/** Served extensions, add new ones here **/
+inline constexpr MIMETYPE mimeTypes[] = {
+  { "htm", "text/html" },
+  { "html", "text/html" },
+  { "css", "text/css" },
+  { "js", "application/javascript" },
+  { "json", "application/json" },
+  { "png", "image/png" },
+  { "gif", "image/gif" },
+  { "jpg", "image/jpeg" },
+  { "svg", "image/svg+xml" },
+  { "ico", "image/x-icon" },
+  { "woff2", "font/woff2" },
+  { "wasm", "application/wasm" },
+  { "xml", "text/xml" },
+  { "pdf", "application/x-pdf" },
+  { "zip", "application/x-zip" },
+  { "gz", "application/x-gzip" }
+};
 
 /** Is this an IP? */
 boolean isIp(String str);
 
 /** IP to String? */
 String toStringIp(IPAddress ip);
-/** very crude extension type to mime type resolver **/
-String getContentType(WebServer *server, String filename);
+/** Extension to mime type through a perfect hash built at compile time, text/plain when unknown **/
+const char *getContentType(std::string_view filename);
+/** Same, but application/octet-stream when the request has a "download" argument **/
+const char *getContentType(HttpServer *server, std::string_view filename);
@@ -37,7 +37,6 @@
 #include "main.h"
 
 #include <WiFi.h>
-#include <NTPClient.h>
 // change next line to use with another board/shield
 #include <WiFiUdp.h>
 
@@ -46,9 +45,15 @@
 
 WiFiUDP ntpUDP;
 
-// By default 'pool.ntp.org' is used with 60 seconds update interval and
-// no offset
-NTPClient timeClient(ntpUDP);
+// Several independent servers so a falseticker can be outvoted, the poll
+// interval adapts between 64 and 1024 seconds depending on clock stability
+const char *const ntp_servers[] = {
+  "0.pool.ntp.org",
+  "1.pool.ntp.org",
+  "2.pool.ntp.org",
+  "3.pool.ntp.org"
+};
+NtpSync ntpSync(ntpUDP, ntp_servers, sizeof(ntp_servers) / sizeof(ntp_servers[0]));
 
 void setup() {
   BaseType_t result = pdFALSE;
@@ -82,89 +87,127 @@ void setup() {
   // January 21, 2014 at 3am you would call:
   // rtc.adjust(DateTime(2014, 1, 21, 3, 0, 0));
   
-  mcp.begin();
-  // configure pin for output
+  // configure pin for output, the whole shadow goes out in one burst per
+  // register pair
   mcp.pinMode(0, OUTPUT);
   mcp.pinMode(1, OUTPUT);
   mcp.pinMode(2, OUTPUT);
   mcp.pinMode(3, OUTPUT);
+  if (!mcp.begin()) {
+    Serial.println("Couldn't find MCP23017");
+  }
+
 
+  if (!sensorHistory.begin()) {
+    Serial.println("Could not set up the sensor history");
+  }
 
   // Setup AP captive portal and wifi setup
-  setupHanlder();
+  setupHanlder(&sensorHistory, &eventLog);
+
+  // The card is mounted by now
+  if (!eventLog.begin(SD, event_log_flush_period)) {
+    Serial.println("Could not open the SD event log");
+  }
   
   // WiFi.begin(ssid, password);
 
-  if (!display.begin(SSD1306_SWITCHCAPVCC, 0x3C)) { // Address 0x3D for 128x64
+  if (!display.begin(SSD1306_SWITCHCAPVCC, SCREEN_ADDRESS)) {
     Serial.println(F("SSD1306 allocation failed"));
     for(;;);
   } else {
     display.clearDisplay();
+    if (!timeGlyphs.begin(DISPLAY_TIME_CHARSET, DISPLAY_TIME_SCALE)) {
+      Serial.println(F("Glyph atlas allocation failed"));
+    }
+    // Frames are sent by flushDisplaySpan() from now on, and every device on
+    // the bus is good for fast mode
+    Wire.setClock(400000);
   }
 
-  // Set offset time in seconds to adjust for your timezone, for example:
-  // GMT +1 = 3600
-  // GTM -3 = -10800
-  // GMT +8 = 28800
-  // GMT -1 = -3600
-  // GMT 0 = 0
-  timeClient.setTimeOffset(-10800);
-  timeClient.begin();
+  // The clocks run on UTC, local time comes from the POSIX TZ rules stored
+  // in preferences, for example:
+  // Argentina = <-03>3
+  // Central Europe = CET-1CEST,M3.5.0,M10.5.0/3
+  // US Eastern = EST5EDT,M3.2.0,M11.1.0
+  char tz[TIMEZONE_STRING_SIZE];
+  int32_t year = civilFromDays(time(NULL) / 86400).year;
+  if (loadTimeZone(tz, sizeof(tz)) == 0 || !timeZone.begin(tz, year)) {
+    timeZone.begin(DEFAULT_TIMEZONE, year);
+  }
+  ntpSync.begin();
   
   // Initialize device.
-  dht.begin();
-  sensor_t sensor;
-  // Dumy read to get sensor info
-  dht.humidity().getSensor(&sensor);
-  // Set delay between sensor readings based on sensor details.
-  const TickType_t dht_sense_interval = sensor.min_delay / 1000 / portTICK_PERIOD_MS;
-  printDhtSensorData();
-
-  i2c_mutex = xSemaphoreCreateMutex();
-  if (i2c_mutex == NULL) {
-    Serial.println(F("Error insufficient heap memory to create i2c_mutex mutex"));
-  }
-
-  ntp_datetime_queue = xQueueCreate(ntp_datetime_queue_len, sizeof(DATETIME));
-  dht_queue = xQueueCreate(dht_queue_len, sizeof(DHTSENSORDATA));
-
-  // Create a one-shot timer
-  ntp_sync_timer = xTimerCreate(
-    "Sync NTP Date Time",       // Name of timer
-    ntp_sync_delay,             // Period of timer (in ticks)
-    pdTRUE,                     // Auto-reload
-    (void *)0,                  // Timer ID
-    syncNtpDateTimeCallback);   // Callback function
-  
-  // Check to make sure timers were created
-  if (ntp_sync_timer == NULL) {
-    Serial.println("Could not create ntp_sync_timer");
-  } else {
-    Serial.println("Starting timers...");
-    // Start timers (max block time if command queue is full)
-    xTimerStart(ntp_sync_timer, portMAX_DELAY);
+  if (!dht.begin()) {
+    Serial.println("Could not set up the DHT RMT receiver");
   }
 
-  // Create DHT sesor sync timer
-  dht_event_timer = xTimerCreate(
-    "Read DHT Sensor",            // Name of timer
-    dht_sense_interval,           // Set delay between sensor readings based on sensor details.
-    pdTRUE,                       // Auto-reload
-    (void *)1,                    // Timer ID
-    syncDhtSensorCallback);       // Callback function
+  // The timer interrupt is allocated on the calling core, setup() runs on
+  // app_cpu so WiFi interrupts on the other core can't delay the refresh
+  if (!nixie.begin(nixie_refresh_rate, nixie_timer)) {
+    Serial.println("Could not start nixie refresh timer");
+  }
+  nixie.setFadeTime(nixie_fade_time);
+  nixie.setBrightness(nixie_brightness, nixie_night_brightness);
+  // A slow ISR makes every phase run late, check it against the budget
+  // after a few refresh cycles
+  delay(50);
+  NIXIESTATS nixieStats = nixie.getStats();
+  if (nixieStats.maxIsrNanos > NIXIE_ISR_BUDGET) {
+    Serial.printf("Nixie ISR too slow: %u ns, budget %u ns in a %u us slot\n",
+      nixieStats.maxIsrNanos, NIXIE_ISR_BUDGET, (unsigned)(1000000UL / (nixie_refresh_rate * nixie_tube_count)));
+  }
+  if (!cathodeScheduler.begin()) {
+    Serial.println("Could not load cathode usage counters");
+  }
 
-  if (dht_event_timer == NULL) {
-    Serial.println("Could not create dht_event_timer");
-  } else {
-    Serial.println("Starting timers dht_event_timer...");
-    // Start timers (max block time if command queue is full)
-    xTimerStart(dht_event_timer, portMAX_DELAY);
+  if (!CpuMonitor::begin()) {
+    Serial.println("Could not register CPU monitor hooks");
+  }
+
+  // Every task talks to the I2C devices through the bus task from here on
+  rtc_device = i2cBus.addDevice("RTC");
+  display_device = i2cBus.addDevice("Display");
+  expander_device = i2cBus.addDevice("Expander");
+  if (!i2cBus.begin(io_cpu, i2c_bus_priority)) {
+    Serial.println(F("I2C Bus Task creation failed."));
+  }
+
+  ntp_datetime_queue = createMessageQueue<DATETIME>(ntp_datetime_queue_len);
+  dht_queue = createMessageQueue<DHTSENSORDATA>(dht_queue_len);
+
+  // Start NTP client task, it never runs on the timer service task so a
+  // lost packet or a slow DNS lookup can't stall the software timers
+  result = xTaskCreatePinnedToCore(syncNtpDateTimeTask,
+    "Sync NTP Date Time",
+    3072,
+    NULL,
+    1,
+    NULL,
+    app_cpu);
+
+  if (result != pdPASS) {
+    Serial.println("Sync NTP Date Time Task creation failed.");
+  }
+
+  // Start DHT sensor task, a read takes a few ms and must not hold up
+  // the timer service task
+  result = xTaskCreatePinnedToCore(syncDhtSensorTask,
+    "Read DHT Sensor",
+    2048,
+    NULL,
+    tskIDLE_PRIORITY,
+    NULL,
+    app_cpu);
+
+  if (result != pdPASS) {
+    Serial.println("Read DHT Sensor Task creation failed.");
   }
 
   // Start printMessages task
   result = xTaskCreatePinnedToCore(printMessages,
     "Serial Print Service",
-    1024,
+    3072,
     NULL,
     1,
     NULL,
@@ -175,22 +218,37 @@ void setup() {
   }
 
     // Start printMessages task
+  // Renders the whole screen with printf style formatting, the stats
+  // report how much of the stack it actually needs
   result = xTaskCreatePinnedToCore(displayMessages,
     "Display Print Service",
-    1024,
+    3072,
     NULL,
     tskIDLE_PRIORITY,
-    NULL,
+    &display_messages_task,
     app_cpu);
   
   if (result != pdPASS) {
     Serial.println("Display Print Service Task creation failed.");
   }
 
+  // Start display flush task, away from the render side
+  result = xTaskCreatePinnedToCore(flushDisplayTask,
+    "Display Flush",
+    1536,
+    NULL,
+    1,
+    NULL,
+    io_cpu);
+
+  if (result != pdPASS) {
+    Serial.println("Display Flush Task creation failed.");
+  }
+
   // Start RTC Synctonization with NTP task
   result = xTaskCreatePinnedToCore(syncRtckWithNtp,
     "RTC Synctonization with NTP",
-    1664,
+    3072,
     NULL,
     tskIDLE_PRIORITY,
     NULL,
@@ -200,17 +258,30 @@ void setup() {
     Serial.println("RTC Synctonization with NTP Task creation failed.");
   }
 
-  // Start RTC Synctonization with NTP task
-  result = xTaskCreatePinnedToCore(testOutput,
-    "Test Output",
-    1664,
+  // Start nixie display task
+  result = xTaskCreatePinnedToCore(nixieDisplayTask,
+    "Nixie Display",
+    1536,
     NULL,
-    1,
+    2,
     NULL,
     app_cpu);
 
   if (result != pdPASS) {
-    Serial.println("Test output Task creation failed.");
+    Serial.println("Nixie Display Task creation failed.");
+  }
+
+  // Start SD event log writer task, the card can stall for a while
+  result = xTaskCreatePinnedToCore(eventLogTask,
+    "Event Log Writer",
+    3072,
+    NULL,
+    tskIDLE_PRIORITY,
+    NULL,
+    app_cpu);
+
+  if (result != pdPASS) {
+    Serial.println("Event Log Writer Task creation failed.");
   }
 
   // // Start AP Captive Portal and Wifi Setup task
@@ -230,67 +301,65 @@ void setup() {
   vTaskDelete(NULL);
 }
 
-void printDhtSensorData() {
-  Serial.println(F("DHTxx Unified Sensor Example"));
-  // Print temperature sensor details.
-  sensor_t sensor;
-  dht.temperature().getSensor(&sensor);
-  Serial.println(F("------------------------------------"));
-  Serial.println(F("Temperature Sensor"));
-  Serial.print  (F("Sensor Type: ")); Serial.println(sensor.name);
-  Serial.print  (F("Driver Ver:  ")); Serial.println(sensor.version);
-  Serial.print  (F("Unique ID:   ")); Serial.println(sensor.sensor_id);
-  Serial.print  (F("Max Value:   ")); Serial.print(sensor.max_value); Serial.println(F("°C"));
-  Serial.print  (F("Min Value:   ")); Serial.print(sensor.min_value); Serial.println(F("°C"));
-  Serial.print  (F("Resolution:  ")); Serial.print(sensor.resolution); Serial.println(F("°C"));
-  Serial.println(F("------------------------------------"));
-  // Print humidity sensor details.
-  dht.humidity().getSensor(&sensor);
-  Serial.println(F("Humidity Sensor"));
-  Serial.print  (F("Sensor Type: ")); Serial.println(sensor.name);
-  Serial.print  (F("Driver Ver:  ")); Serial.println(sensor.version);
-  Serial.print  (F("Unique ID:   ")); Serial.println(sensor.sensor_id);
-  Serial.print  (F("Max Value:   ")); Serial.print(sensor.max_value); Serial.println(F("%"));
-  Serial.print  (F("Min Value:   ")); Serial.print(sensor.min_value); Serial.println(F("%"));
-  Serial.print  (F("Resolution:  ")); Serial.print(sensor.resolution); Serial.println(F("%"));
-  Serial.println(F("------------------------------------"));
-}
-
-void syncNtpDateTimeCallback(TimerHandle_t xTimer) {
+void syncNtpDateTimeTask(void *parameters) {
   struct DATETIME dateTime;
-  while (WiFi.status() != WL_CONNECTED) {
-    vTaskDelay(500 / portTICK_PERIOD_MS);
-    Serial.print( "." );
-  }
-  while (!timeClient.update()) {
-    timeClient.forceUpdate();
-  }
-  // Variables to save date and time
-  dateTime.epochTime = timeClient.getEpochTime();
-  dateTime.formattedDate = getFormattedDate(&timeClient);
-  int splitT = dateTime.formattedDate.indexOf("T");
-  dateTime.dateStamp = dateTime.formattedDate.substring(0, splitT);
-  dateTime.timeStamp = dateTime.formattedDate.substring(splitT+1, dateTime.formattedDate.length()-1);
-  // Try to add item to queue for 10 ticks, fail if queue is full
-  if (xQueueSend(ntp_datetime_queue, (void *)&dateTime, 10) != pdTRUE) {
-    Serial.println("ntp_datetime_queue queue full");
+  NTPSAMPLE sample;
+  while (true) {
+    if (WiFi.status() != WL_CONNECTED) {
+      vTaskDelay(ntp_link_check_delay);
+      continue;
+    }
+    unsigned long now = millis();
+    if (ntpSync.poll(now, &sample)) {
+      // Variables to save date and time
+      dateTime.epochTime = sample.epochTime;
+      dateTime.epochMicros = sample.epochMicros;
+      dateTime.offset = sample.offset;
+      dateTime.roundTrip = sample.roundTrip;
+      // Don't wait for the consumer, the next sample will carry fresher time anyway
+      if (sendMessage(ntp_datetime_queue, &dateTime, 0) != pdTRUE) {
+        Serial.println("ntp_datetime_queue queue full");
+      }
+    }
+    TickType_t delay = ntpSync.nextPollDelay(millis()) / portTICK_PERIOD_MS;
+    vTaskDelay(delay > 0 ? delay : 1);
   }
 }
 
-void syncDhtSensorCallback(TimerHandle_t xTimer) {
+void syncDhtSensorTask(void *parameters) {
   struct DHTSENSORDATA dhtSensorData;
-  sensors_event_t event;
-  // Get temperature event
-  dht.temperature().getEvent(&event);
-  dhtSensorData.temperature = event.temperature;
-  // Get humidity event
-  dht.humidity().getEvent(&event);
-  dhtSensorData.relative_humidity = event.relative_humidity;
-
-  // Test if sensor data is valid
-  if (isnan(dhtSensorData.temperature) || isnan(dhtSensorData.relative_humidity)) {
-    Serial.println("Error reading temperature or humidity!");
-  } else {
+  DHTREADING reading;
+  // Room temperature moves over minutes, only sample fast while it does
+  AdaptiveSampler sampler(2, dht_min_interval, dht_max_interval);
+  sampler.setThreshold(0, dht_temperature_rate, 0.1);
+  sampler.setThreshold(1, dht_humidity_rate, 0.1);
+  unsigned long interval = dht_min_interval;
+  while (true) {
+    vTaskDelay(interval / portTICK_PERIOD_MS);
+    // The RMT receiver times the pulses, this task just sleeps meanwhile
+    DhtStatus status = dht.read(&reading);
+    if (status != DHT_OK) {
+      Serial.printf("Error reading temperature or humidity! (%d)\n", status);
+      interval = dht_min_interval;
+      continue;
+    }
+    // Median then EMA, a single glitched sample never reaches the display
+    float raw[2] = { reading.temperature, reading.humidity };
+    float filtered[2];
+    interval = sampler.update(raw, filtered, millis());
+    uint32_t count;
+    if (sampler.getHourlyCount(&count)) {
+      Serial.printf("DHT samples last hour: %u (%lu at a fixed rate)\n", count, 3600000UL / dht_min_interval);
+    }
+    dhtSensorData.temperature = filtered[0];
+    dhtSensorData.relative_humidity = filtered[1];
+    dhtSensorData.timestamp = time(NULL);
+    sensorHistory.insert(dhtSensorData.timestamp, filtered);
+    EVENTLOGPAYLOAD payload = {};
+    payload.sensor.temperature = filtered[0];
+    payload.sensor.humidity = filtered[1];
+    eventLog.append(EVENTLOG_SENSOR, 0, &payload);
+
     Serial.print("Temperature: ");
     Serial.print(dhtSensorData.temperature);
     Serial.println("°C");
@@ -300,7 +369,7 @@ void syncDhtSensorCallback(TimerHandle_t xTimer) {
     Serial.println("%");
 
     // Try to add item to queue for 10 ticks, fail if queue is full
-    if (xQueueSend(dht_queue, (void *)&dhtSensorData, 10) != pdTRUE) {
+    if (sendMessage(dht_queue, &dhtSensorData, 10) != pdTRUE) {
       Serial.println("dht_queue queue full");
     }
   }
@@ -308,83 +377,325 @@ void syncDhtSensorCallback(TimerHandle_t xTimer) {
 
 void syncRtckWithNtp(void *parameters) {
   struct DATETIME dateTime;
+  unsigned long lastHoldover = millis();
   while (true) {
-    // See if there's a message in the queue (do not block)
-    if (xQueueReceive(ntp_datetime_queue, (void *)&dateTime, 0) == pdTRUE) {
-      if (xSemaphoreTake(i2c_mutex, portMAX_DELAY) == pdTRUE) {
-        DateTime now = rtc.now();
-        if (dateTime.epochTime != now.unixtime()) {
-          // // Adjust internal rtc
-          esp32Time.setTime(dateTime.epochTime);
-          if (dateTime.epochTime != esp32Time.getEpoch()) {
-            Serial.println("Failed to sync internal RTC clock");
-          }
+    // Sleep until a sample arrives or the holdover slew is due
+    unsigned long elapsed = millis() - lastHoldover;
+    TickType_t timeout = elapsed < clock_holdover_period ? (clock_holdover_period - elapsed) / portTICK_PERIOD_MS : 0;
+    if (receiveMessage(ntp_datetime_queue, &dateTime, timeout) == pdTRUE) {
+      double now = esp_timer_get_time() / 1e6;
+      // Battery backup rtc first, it is measured against the internal rtc
+      // so that one must not move until we are done
+      double rtcOffset = measureRtcOffset(dateTime.offset);
+      if (!isnan(rtcOffset)) {
+        int8_t aging = readRtcAgingOffset();
+        RTCADJUSTMENT rtcAdjustment = clockDiscipline.updateRtc(rtcOffset, now, aging);
+        if (rtcAdjustment.setAging) {
+          // Correct the crystal itself instead of stepping the time more often
+          writeRtcAgingOffset(rtcAdjustment.aging);
+          Serial.printf("External RTC drift %.2f ppm, aging offset %d\n", rtcAdjustment.drift, rtcAdjustment.aging);
+        }
+        if (rtcAdjustment.setTime) {
           // Adjust battery backup rtc
-          rtc.adjust(DateTime(dateTime.epochTime));
-          now = rtc.now();
-          if (dateTime.epochTime != now.unixtime()) {
-            Serial.println("Failed to sync external RTC clock");
-          }
-        } else {
-          Serial.println("RTC clocks are in sync with NTP");
+          setRtcOnSecondBoundary(dateTime.offset);
+          clockDiscipline.rtcSet(now);
         }
-        xSemaphoreGive(i2c_mutex);
+        Serial.printf("External RTC offset %.3f s\n", rtcOffset);
+      } else {
+        Serial.println("Failed to read external RTC clock");
       }
+      // Adjust internal rtc, small offsets are slewed so the tubes never jump
+      CLOCKADJUSTMENT adjustment = clockDiscipline.update(dateTime.offset, now);
+      adjustClock(adjustment);
+      EVENTLOGPAYLOAD payload = {};
+      payload.sync.offset = dateTime.offset;
+      payload.sync.roundTrip = dateTime.roundTrip;
+      payload.sync.residual = clockDiscipline.getResidual();
+      payload.sync.frequency = clockDiscipline.getFrequency();
+      eventLog.append(EVENTLOG_SYNC, adjustment.type, &payload);
+      publishSyncEvent(adjustment.type, &payload);
+      lastHoldover = millis();
+      Serial.printf("NTP offset %.6f s, round trip %.3f s, residual %.6f s, frequency %.2f ppm%s\n",
+        clockDiscipline.getOffset(), dateTime.roundTrip, clockDiscipline.getResidual(),
+        clockDiscipline.getFrequency(), adjustment.type == CLOCK_STEP ? ", stepped" : "");
+    }
+    // Keep the internal rtc on frequency between samples
+    if (millis() - lastHoldover >= clock_holdover_period) {
+      lastHoldover = millis();
+      slewClock(clockDiscipline.holdover(esp_timer_get_time() / 1e6));
+    }
+  }
+}
+
+double getSystemTime() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+double measureRtcOffset(double offset) {
+  // The DS3231 only reports whole seconds, so wait for its next tick to
+  // learn where the second boundary actually is
+  uint32_t second = 0, start = 0;
+  unsigned long since = millis();
+  while (millis() - since < rtc_tick_timeout) {
+    i2cBus.run(rtc_device, I2C_PRIORITY_HIGH, i2c_rtc_deadline, [](void *context) {
+      *(uint32_t *)context = rtc.now().unixtime();
+      return I2C_JOB_DONE;
+    }, &second);
+    double reference = getSystemTime() + offset;
+    if (start == 0) {
+      start = second;
+    } else if (second != start) {
+      return reference - second;
+    }
+    vTaskDelay(rtc_tick_poll_delay);
+  }
+  return NAN;
+}
+
+void setRtcOnSecondBoundary(double offset) {
+  // Writing the seconds register restarts the DS3231 countdown chain, so
+  // sleep outside the bus until just before the boundary. A late wakeup
+  // moves on to the next one rather than spinning through a whole second
+  uint32_t next;
+  while (true) {
+    double reference = getSystemTime() + offset;
+    next = (uint32_t)floor(reference) + 1;
+    double remaining = next - reference - rtc_set_spin;
+    if (remaining * 1000 < portTICK_PERIOD_MS) {
+      break;
     }
+    vTaskDelay((TickType_t)(remaining * 1000) / portTICK_PERIOD_MS);
   }
+  struct RTCSETTIME {
+    double offset;
+    uint32_t next;
+  } setTime = { offset, next };
+  // Only the last stretch is spent holding the bus
+  i2cBus.run(rtc_device, I2C_PRIORITY_HIGH, i2c_rtc_deadline, [](void *context) {
+    RTCSETTIME *setTime = (RTCSETTIME *)context;
+    while (getSystemTime() + setTime->offset < setTime->next);
+    rtc.adjust(DateTime(setTime->next));
+    return I2C_JOB_DONE;
+  }, &setTime);
+}
+
+void adjustClock(CLOCKADJUSTMENT adjustment) {
+  if (adjustment.type == CLOCK_STEP) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    double time = tv.tv_sec + tv.tv_usec / 1e6 + adjustment.amount;
+    tv.tv_sec = (time_t)floor(time);
+    tv.tv_usec = (suseconds_t)((time - floor(time)) * 1e6);
+    settimeofday(&tv, NULL);
+  } else if (adjustment.type == CLOCK_SLEW) {
+    slewClock(adjustment.amount);
+  }
+}
+
+void slewClock(double amount) {
+  // adjtime() replaces the pending adjustment, so carry over what's left of it
+  struct timeval tv;
+  if (adjtime(NULL, &tv) == 0) {
+    amount += tv.tv_sec + tv.tv_usec / 1e6;
+  }
+  tv.tv_sec = (time_t)trunc(amount);
+  tv.tv_usec = (suseconds_t)((amount - trunc(amount)) * 1e6);
+  if (adjtime(&tv, NULL) != 0) {
+    Serial.println("Failed to slew internal RTC clock");
+  }
+}
+
+int8_t readRtcAgingOffset() {
+  int8_t aging = 0;
+  i2cBus.run(rtc_device, I2C_PRIORITY_NORMAL, i2c_rtc_deadline, [](void *context) {
+    Wire.beginTransmission(DS3231_I2C_ADDRESS);
+    Wire.write(DS3231_AGING_OFFSET);
+    Wire.endTransmission();
+    Wire.requestFrom(DS3231_I2C_ADDRESS, 1);
+    *(int8_t *)context = (int8_t)Wire.read();
+    return I2C_JOB_DONE;
+  }, &aging);
+  return aging;
+}
+
+void writeRtcAgingOffset(int8_t aging) {
+  i2cBus.run(rtc_device, I2C_PRIORITY_NORMAL, i2c_rtc_deadline, [](void *context) {
+    Wire.beginTransmission(DS3231_I2C_ADDRESS);
+    Wire.write(DS3231_AGING_OFFSET);
+    Wire.write(*(uint8_t *)context);
+    Wire.endTransmission();
+    // The new offset only applies after a temperature conversion, force one
+    Wire.beginTransmission(DS3231_I2C_ADDRESS);
+    Wire.write(DS3231_CONTROL_REGISTER);
+    Wire.endTransmission();
+    Wire.requestFrom(DS3231_I2C_ADDRESS, 1);
+    uint8_t control = Wire.read();
+    Wire.beginTransmission(DS3231_I2C_ADDRESS);
+    Wire.write(DS3231_CONTROL_REGISTER);
+    Wire.write(control | DS3231_CONVERT_TEMPERATURE);
+    Wire.endTransmission();
+    return I2C_JOB_DONE;
+  }, &aging);
 }
 
 void setEsp32Time() {
-  // Get battery backup rtc
-  DateTime now = rtc.now();
+  // Get battery backup rtc, right after it ticks so the internal rtc
+  // starts with the same sub-second phase
+  uint32_t start = rtc.now().unixtime();
+  uint32_t second = start;
+  unsigned long since = millis();
+  while (second == start && millis() - since < rtc_tick_timeout) {
+    second = rtc.now().unixtime();
+  }
   // Adjust internal rtc
-  esp32Time.setTime(now.unixtime());
+  struct timeval tv = { (time_t)second, 0 };
+  settimeofday(&tv, NULL);
 }
 
 // Task: wait for item on queue and print it
 void printMessages(void *parameters) {
+  TimeFormatter timeFormatter;
+  uint32_t seconds = 0;
   while (true) {
-    Serial.println(esp32Time.getDateTime(true));
-    // Print out number of free heap memory bytes before malloc
-    // Serial.print("Heap size (bytes): ");
-    // Serial.println(xPortGetFreeHeapSize());
+    if (timeFormatter.update(timeZone.toLocal(time(NULL)))) {
+      Serial.println(timeFormatter.getDateTime());
+    }
+    if (++seconds % cpu_monitor_period == 0) {
+      CpuMonitor::sample();
+      Serial.printf("CPU idle: core 0 %.1f%%, core 1 %.1f%%\n", CpuMonitor::getIdle(0), CpuMonitor::getIdle(1));
+      NIXIESTATS nixieStats = nixie.getStats();
+      Serial.printf("Nixie ISR: %u interrupts, max %u ns, load %.2f%%, jitter %u us\n",
+        nixieStats.interrupts, nixieStats.maxIsrNanos, nixieStats.isrLoad, nixieStats.maxJitter);
+      MCPOUTPUTSTATS mcpStats = mcp.getStats();
+      Serial.printf("MCP23017: %u transactions, %u bytes, %u skipped, %u transactions and %u bytes saved\n",
+        mcpStats.transactions, mcpStats.bytes, mcpStats.skipped, mcpStats.savedTransactions, mcpStats.savedBytes);
+      double period = i2cBus.getStatsPeriod();
+      for (uint8_t device = 0; device < i2cBus.getDeviceCount(); device++) {
+        I2CDEVICESTATS i2cStats = i2cBus.getStats(device);
+        Serial.printf("I2C %s: %.2f%% bus, %u jobs, max wait %u us, %u missed deadlines\n",
+          i2cStats.name, i2cStats.busyMicros * 100.0 / period, i2cStats.jobs, i2cStats.maxWaitMicros, i2cStats.missedDeadlines);
+      }
+      i2cBus.resetStats();
+      FRAMEDIFFSTATS displayStats = displayDiff.getStats();
+      Serial.printf("Display: %u frames, %u dropped, %u spans, %u of %u bytes sent\n",
+        displayStats.frames, displayFrames.getDropped(), displayStats.spans, displayStats.bytes,
+        displayStats.frames * (SCREEN_WIDTH * SCREEN_HEIGHT / 8));
+      displayDiff.resetStats();
+      if (display_messages_task != NULL) {
+        Serial.printf("Display task: %u bytes of stack never used\n", uxTaskGetStackHighWaterMark(display_messages_task));
+      }
+      EVENTLOGSTATS logStats = eventLog.getStats();
+      Serial.printf("Event log: %u records, %u sector writes, %u dropped, %u failed\n",
+        logStats.records, logStats.sectors, logStats.dropped, logStats.failed);
+      // A largest free block that keeps shrinking while the free heap stays
+      // put means something is still fragmenting the heap
+      Serial.printf("Heap free: %u bytes, largest block: %u bytes\n",
+        heap_caps_get_free_size(MALLOC_CAP_8BIT), heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+    }
     vTaskDelay(1000 / portTICK_PERIOD_MS);
   }
 }
 
-void displaySensorInfo(DHTSENSORDATA *dhtSensorData, int16_t x, int16_t y, uint16_t color) {
-  if (xSemaphoreTake(i2c_mutex, portMAX_DELAY) == pdTRUE) {
-    display.clearDisplay();
-    display.setTextSize(1);
-    display.setTextColor(color);
-    
-    // display.setCursor(x, y);
-    // display.print("Temperature: ");
-    // display.print(dhtSensorData->temperature);
-    // display.println("*C");
-
-    // display.setCursor(x, y + 10);
-    // display.print("Humidity: ");
-    // display.print(dhtSensorData->relative_humidity);
-    // display.println("%");
-    
-    display.setCursor(x, y + 20);
-    display.print("Date: ");
-    display.println(esp32Time.getDateTime(true));
-    
-    display.display();
-
-    xSemaphoreGive(i2c_mutex);
+void displaySensorInfo(DHTSENSORDATA *dhtSensorData, TimeFormatter *timeFormatter, uint8_t timeChanged, int16_t x, int16_t y, uint16_t color) {
+  // Drawing only touches the render buffer, flushDisplayTask sends it later
+  display.setTextSize(1);
+  display.setTextColor(color);
+  
+  // display.setCursor(x, y);
+  // display.print("Temperature: ");
+  // display.print(dhtSensorData->temperature);
+  // display.println("*C");
+
+  // display.setCursor(x, y + 10);
+  // display.print("Humidity: ");
+  // display.print(dhtSensorData->relative_humidity);
+  // display.println("%");
+  
+  // The time goes through the glyph atlas, a few memcpys instead of
+  // rasterizing the font every second. The atlas only draws at page rows
+  if (timeChanged) {
+    timeGlyphs.draw(display.getBuffer(), SCREEN_WIDTH, SCREEN_HEIGHT / 8, y / 8, x, timeFormatter->getTime());
+  }
+  // Only rasterized when the day changes
+  if (timeChanged & TIME_CHANGED_DAY) {
+    display.fillRect(x, y + 24, SCREEN_WIDTH - x, 16, BLACK);
+    display.setCursor(x, y + 24);
+    display.print(timeFormatter->getDate());
   }
+  
+  // Hand the frame over to flushDisplayTask, never waits for the bus
+  memcpy(displayFrames.getBack(), display.getBuffer(), SCREEN_WIDTH * SCREEN_HEIGHT / 8);
+  displayFrames.publish();
+}
+
+void flushDisplayTask(void *parameters) {
+  TickType_t lastWake = xTaskGetTickCount();
+  while (true) {
+    // Fixed frame rate, whatever was rendered last goes out
+    vTaskDelayUntil(&lastWake, display_frame_period);
+    if (displayFrames.acquire()) {
+      // Only what changed since the last flush goes out, one span per step
+      // so tube and RTC traffic never waits for a whole frame
+      struct DISPLAYFLUSH flush = { displayFrames.getFront(), 0, false };
+      i2cBus.run(display_device, I2C_PRIORITY_LOW, i2c_display_deadline, flushDisplaySpan, &flush);
+    }
+  }
+}
+
+I2cJobResult flushDisplaySpan(void *context) {
+  struct DISPLAYFLUSH *flush = (struct DISPLAYFLUSH *)context;
+  const uint8_t *buffer = flush->frame;
+  FRAMESPAN span;
+  if (!displayDiff.next(buffer, &flush->cursor, &span)) {
+    if (flush->sent) {
+      displayDiff.frameSent();
+    }
+    return I2C_JOB_DONE;
+  }
+  Wire.beginTransmission(SCREEN_ADDRESS);
+  Wire.write((uint8_t)0x00);  // Command stream
+  Wire.write(SSD1306_PAGEADDR);
+  Wire.write(span.page);
+  Wire.write(span.page);
+  Wire.write(SSD1306_COLUMNADDR);
+  Wire.write(span.first);
+  Wire.write(span.last);
+  bool sent = Wire.endTransmission() == 0;
+  const uint8_t *data = buffer + span.page * SCREEN_WIDTH;
+  for (uint16_t column = span.first; sent && column <= span.last; column += display_chunk_size) {
+    uint8_t length = span.last - column + 1 < display_chunk_size ? span.last - column + 1 : display_chunk_size;
+    Wire.beginTransmission(SCREEN_ADDRESS);
+    Wire.write((uint8_t)0x40);  // Data stream
+    Wire.write(data + column, length);
+    sent = Wire.endTransmission() == 0;
+  }
+  if (!sent) {
+    // No telling how much of the span made it, resend everything next time
+    displayDiff.invalidate();
+    return I2C_JOB_FAILED;
+  }
+  displayDiff.commit(buffer, span);
+  flush->sent = true;
+  return I2C_JOB_MORE;
 }
 
 void displayMessages(void *parameters) {
-  struct DHTSENSORDATA dhtSensorData;
+  struct DHTSENSORDATA dhtSensorData = { NAN, NAN, 0 };
+  TimeFormatter timeFormatter;
   while (true) {
-    if (xQueueReceive(dht_queue, (void *)&dhtSensorData, 0) == pdTRUE) { // Third param = Non Blocking
-      displaySensorInfo(&dhtSensorData, 0, 0, WHITE);
+    // Block until new sensor data arrives or the clock ticks over to the
+    // next second, whichever comes first
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    TickType_t timeout = (1000 - tv.tv_usec / 1000) / portTICK_PERIOD_MS + 1;
+    bool sensorChanged = receiveMessage(dht_queue, &dhtSensorData, timeout) == pdTRUE;
+    uint8_t timeChanged = timeFormatter.update(timeZone.toLocal(time(NULL)));
+    // Nothing on screen changed, skip the redraw and the bus transfer
+    if (sensorChanged || timeChanged) {
+      displaySensorInfo(&dhtSensorData, &timeFormatter, timeChanged, 0, 0, WHITE);
     }
-    vTaskDelay(1000 / portTICK_PERIOD_MS);
   }
 }
 
@@ -393,21 +704,55 @@ void loop() {
   vTaskDelay(1000 / portTICK_PERIOD_MS);
 }
 
-void nixieTime() {
-  uint8_t numbers[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
-  for(uint8_t i = 0; i < (sizeof(numbers) / sizeof(numbers[0])); i++) {
-    int number = numbers[i];
-    uint16_t output = number << 0;
-    if (xSemaphoreTake(i2c_mutex, portMAX_DELAY) == pdTRUE) { 
-      mcp.writeGPIOAB(output);
-      xSemaphoreGive(i2c_mutex);
+void nixieDisplayTask(void *parameters) {
+  uint8_t digits[NIXIE_MAX_TUBES];
+  while (true) {
+    // Wake up right after the second boundary so the tubes tick with the clock
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    vTaskDelay((1000 - tv.tv_usec / 1000) / portTICK_PERIOD_MS + 1);
+    uint32_t seconds = timeZone.toLocal(time(NULL)) % 86400;
+    uint16_t minutes = seconds / 60;
+    nixie.setNight(nixie_night_start > nixie_night_end
+      ? minutes >= nixie_night_start || minutes < nixie_night_end
+      : minutes >= nixie_night_start && minutes < nixie_night_end);
+    nixie.setNumber(seconds / 3600 * 10000 + seconds / 60 % 60 * 100 + seconds % 60);
+    nixie.swap();
+    nixie.getFrame(digits);
+    cathodeScheduler.account(digits, 1);
+    // Most tubes are changing digits at the rollover anyway, that's where a
+    // short cycle is least noticeable
+    if (seconds % cathode_cycle_interval == 0) {
+      runCathodeCycle(digits);
     }
-    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    cathodeScheduler.save();
   }
 }
 
-void testOutput(void *parameters) {
-  while(true) {
-    nixieTime();
+void runCathodeCycle(const uint8_t *digits) {
+  uint8_t sequence[cathode_cycle_steps * NIXIE_MAX_TUBES];
+  cathodeScheduler.plan(sequence, cathode_cycle_steps);
+  // Hard switches, each step is shorter than a crossfade
+  nixie.setFadeTime(0);
+  for (uint8_t step = 0; step < cathode_cycle_steps; step++) {
+    for (uint8_t tube = 0; tube < nixie_tube_count; tube++) {
+      nixie.setDigit(tube, sequence[step * nixie_tube_count + tube]);
+    }
+    nixie.swap();
+    vTaskDelay(cathode_cycle_step_time);
+  }
+  nixie.setFadeTime(nixie_fade_time);
+  // Fade back to the time
+  for (uint8_t tube = 0; tube < nixie_tube_count; tube++) {
+    nixie.setDigit(tube, digits[tube]);
   }
-}
\ No newline at end of file
+  nixie.swap();
+}
+
+void eventLogTask(void *parameters) {
+  while (true) {
+    vTaskDelay(event_log_check_period);
+    // Full sectors go out right away, a partial one once the flush period is up
+    eventLog.flush();
+  }
+}
@@ -34,18 +34,21 @@
  **/
 
 #include <FreeRTOS.h>
+#include <esp_heap_caps.h>
 // Date and time functions using a DS3231 RTC connected via I2C and Wire lib
 #include <RTClib.h>
 RTC_DS3231 rtc;
+#define DS3231_I2C_ADDRESS 0x68
+#define DS3231_CONTROL_REGISTER 0x0E
+#define DS3231_AGING_OFFSET 0x10
+#define DS3231_CONVERT_TEMPERATURE 0x20
 
-#include <DHT.h>
-#include <DHT_U.h>
+#include "DhtReader.h"
 #define DHTPIN 25       // modify to the pin we connected
-#define DHTTYPE DHT21   // AM2301 
-DHT_Unified dht(DHTPIN, DHTTYPE);
+DhtReader dht(DHTPIN);  // DHT21 (AM2301), read through RMT channel 0
 
-#include <Adafruit_MCP23017.h>
-Adafruit_MCP23017 mcp;
+#include "McpOutput.h"
+McpOutput mcp(Wire);
 
 #include <ESP32Time.h>
 
@@ -56,54 +59,135 @@ ESP32Time esp32Time;
 #else
   static const BaseType_t app_cpu = 1;
 #endif
+// Tasks that mostly wait on I/O (I2C bus, display flush) run next to WiFi
+static const BaseType_t io_cpu = 0;
 
 #include <Wire.h>
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
 #define SCREEN_WIDTH 128 // OLED display width, in pixels
 #define SCREEN_HEIGHT 64 // OLED display height, in pixels
+#define SCREEN_ADDRESS 0x3C // Address 0x3D for 128x64
 // Declaration for an SSD1306 display connected to I2C (SDA, SCL pins)
 Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, -1);
+#include "FrameDiff.h"
+// What the panel shows, so only the changed columns of each page are sent
+FrameDiff displayDiff(SCREEN_WIDTH, SCREEN_HEIGHT);
+#include "GlyphAtlas.h"
+// The time is drawn from pre-rendered glyphs, the date (once a day) with GFX
+GlyphAtlas timeGlyphs;
+#define DISPLAY_TIME_CHARSET "0123456789:"
+#define DISPLAY_TIME_SCALE 2
+#include "FrameExchange.h"
+// Rendered frames on their way from displayMessages to flushDisplayTask
+FrameExchange<SCREEN_WIDTH * SCREEN_HEIGHT / 8> displayFrames;
+struct DISPLAYFLUSH {
+  const uint8_t *frame;
+  uint16_t cursor;          // Byte offset in the frame buffer
+  bool sent;                // At least one span went out
+};
+
+#include "MessageQueue.h"
 
 struct DHTSENSORDATA {
   float temperature;        // temperature is in degrees centigrade (Celsius)
   float relative_humidity;  // relative humidity in percent
   long timestamp;           // measurment timestamp
 };
+ASSERT_MESSAGE_TYPE(DHTSENSORDATA);
 
 #include "DateTime.h"
+#include "TimeFormatter.h"
+#include "TimeZone.h"
+#include "NtpSync.h"
+#include "ClockDiscipline.h"
+#include "CpuMonitor.h"
+#include "AdaptiveSampler.h"
+#include "I2cBus.h"
+#include "CathodeScheduler.h"
+#include "SensorHistory.h"
+#include "EventLog.h"
+#include "Nixie.h"
 #include "SetupHandler.h"
 
 // Functions
-void printDhtSensorData();
-void syncNtpDateTimeCallback(TimerHandle_t xTimer);
-void syncDhtSensorCallback(TimerHandle_t xTimer);
+void syncNtpDateTimeTask(void *parameters);
+void syncDhtSensorTask(void *parameters);
 void syncRtckWithNtp(void *parameters);
 void printMessages(void *parameters);
-void displaySensorInfo(DHTSENSORDATA *dhtSensorData, int16_t x, int16_t y, uint16_t color);
+void displaySensorInfo(DHTSENSORDATA *dhtSensorData, TimeFormatter *timeFormatter, uint8_t timeChanged, int16_t x, int16_t y, uint16_t color);
 void displayMessages(void *parameters);
+I2cJobResult flushDisplaySpan(void *context);
+void flushDisplayTask(void *parameters);
 void setEsp32Time();
-void testOutput(void *parameters);
-void nixieTime();
+void adjustClock(CLOCKADJUSTMENT adjustment);
+void slewClock(double amount);
+double getSystemTime();
+double measureRtcOffset(double offset);
+void setRtcOnSecondBoundary(double offset);
+int8_t readRtcAgingOffset();
+void writeRtcAgingOffset(int8_t aging);
+void nixieDisplayTask(void *parameters);
+void runCathodeCycle(const uint8_t *digits);
+void eventLogTask(void *parameters);
 
 // Settings
-static const TickType_t ntp_sync_delay = 5000 / portTICK_PERIOD_MS;
+static const TickType_t ntp_link_check_delay = 1000 / portTICK_PERIOD_MS;
 static const uint8_t ntp_datetime_queue_len = 5;
+static const unsigned long clock_holdover_period = 64000;  // In ms
+static const unsigned long rtc_tick_timeout = 1100;        // In ms
+static const TickType_t rtc_tick_poll_delay = 5 / portTICK_PERIOD_MS;
+static const double rtc_set_spin = 0.002;                 // In s, left to spin inside the bus job
 // Globals
 static QueueHandle_t ntp_datetime_queue = NULL;
-static TimerHandle_t ntp_sync_timer = NULL;
+ClockDiscipline clockDiscipline;
+TimeZone timeZone;
 struct DATETIME {
-  String formattedDate;
-  String dateStamp;
-  String timeStamp;
   unsigned long epochTime;
+  uint32_t epochMicros;     // Fraction of epochTime (us)
+  double offset;            // NTP minus internal rtc (s)
+  double roundTrip;         // In s
 };
+ASSERT_MESSAGE_TYPE(DATETIME);
 
 // Settings
 static const uint8_t dht_queue_len = 5;
+static const unsigned long dht_min_interval = 2000;     // DHT21 minimum (ms)
+static const unsigned long dht_max_interval = 128000;   // While readings are stable (ms)
+static const float dht_temperature_rate = 0.2;          // Faster changes speed sampling up (°C per minute)
+static const float dht_humidity_rate = 1.0;             // In % per minute
+static const uint32_t cpu_monitor_period = 10;  // In s
+static const uint8_t nixie_bcd_pins[NIXIE_BCD_PINS] = { 13, 14, 27, 26 };  // 74141 A, B, C, D, modify to the pins we connected
+static const uint8_t nixie_anode_pins[] = { 4, 16, 17, 32, 33, 15 };        // Hours, minutes, seconds from left to right
+static const uint8_t nixie_tube_count = sizeof(nixie_anode_pins) / sizeof(nixie_anode_pins[0]);
+static const uint32_t nixie_refresh_rate = 1000;  // Per tube (Hz)
+static const uint8_t nixie_timer = 0;
+static const uint16_t nixie_fade_time = 250;      // Digit crossfade (ms)
+static const uint8_t nixie_brightness = 255;      // Perceived brightness, 0 - 255
+static const uint8_t nixie_night_brightness = 48;
+static const uint16_t nixie_night_start = 23 * 60;  // Local time (minutes)
+static const uint16_t nixie_night_end = 7 * 60;
+static const uint32_t cathode_cycle_interval = 60;  // Slot-machine cycle every minute rollover (s)
+static const uint8_t cathode_cycle_steps = 12;
+static const TickType_t cathode_cycle_step_time = 25 / portTICK_PERIOD_MS;
+static const UBaseType_t i2c_bus_priority = 3;
+static const uint32_t i2c_expander_deadline = 2;  // In ms
+static const uint32_t i2c_rtc_deadline = 5;       // In ms
+static const uint32_t i2c_display_deadline = 100; // In ms
+static const uint8_t display_chunk_size = 32;     // Data bytes per I2C transaction, fits the Wire buffer
+static const TickType_t display_frame_period = 100 / portTICK_PERIOD_MS;
+static const unsigned long event_log_flush_period = 300000;  // Max time a partial sector waits in RAM (ms)
+static const TickType_t event_log_check_period = 1000 / portTICK_PERIOD_MS;
 // Globals
 static QueueHandle_t dht_queue = NULL;
-static TimerHandle_t dht_event_timer = NULL;
-static SemaphoreHandle_t i2c_mutex;
+static TaskHandle_t display_messages_task = NULL;
+I2cBus i2cBus;
+static uint8_t rtc_device;
+static uint8_t display_device;
+static uint8_t expander_device;
+Nixie nixie(nixie_bcd_pins, nixie_anode_pins, nixie_tube_count);
+CathodeScheduler cathodeScheduler(nixie_tube_count);
+SensorHistory sensorHistory;
+EventLog eventLog;
 
 
@@ -0,0 +1,73 @@
+// Host stand-in for the parts of the Arduino core the tested libraries use
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <mutex>
+
+using std::min;
+using std::max;
+typedef bool boolean;
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define PROGMEM
+#define PGM_P const char *
+#define F(text) text
+
+// Tests move the clock forward with `hostMillisOffset`
+inline unsigned long hostMillisOffset = 0;
+inline unsigned long millis() {
+  static const auto start = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() + hostMillisOffset;
+}
+
+// FreeRTOS, single mutex semantics are all the libraries rely on
+typedef std::recursive_mutex *SemaphoreHandle_t;
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+#define portMAX_DELAY 0xFFFFFFFF
+#define portTICK_PERIOD_MS 1
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return new std::recursive_mutex(); }
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t lock, TickType_t) { lock->lock(); return pdTRUE; }
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t lock) { lock->unlock(); return pdTRUE; }
+inline void vTaskDelay(TickType_t) {}
+
+class String : public std::string {
+  public:
+    String() {}
+    String(const char *text) : std::string(text != NULL ? text : "") {}
+    String(const std::string &text) : std::string(text) {}
+    String(char c) : std::string(1, c) {}
+    String(int value) : std::string(std::to_string(value)) {}
+    String(unsigned int value) : std::string(std::to_string(value)) {}
+    String(long value) : std::string(std::to_string(value)) {}
+    String(unsigned long value) : std::string(std::to_string(value)) {}
+    String(float value, unsigned int decimals = 2) { char text[32]; snprintf(text, sizeof(text), "%.*f", decimals, value); assign(text); }
+    String &operator+=(const char *text) { append(text); return *this; }
+    String &operator+=(const String &text) { append(text); return *this; }
+    String &operator+=(char c) { push_back(c); return *this; }
+    String &operator+=(int value) { append(std::to_string(value)); return *this; }
+    String &operator+=(unsigned int value) { append(std::to_string(value)); return *this; }
+    String &operator+=(long value) { append(std::to_string(value)); return *this; }
+    String &operator+=(unsigned long value) { append(std::to_string(value)); return *this; }
+    unsigned int length() const { return size(); }
+    char charAt(unsigned int index) const { return index < size() ? (*this)[index] : 0; }
+    bool endsWith(const String &suffix) const { return size() >= suffix.size() && compare(size() - suffix.size(), suffix.size(), suffix) == 0; }
+    bool startsWith(const String &prefix) const { return compare(0, prefix.size(), prefix) == 0; }
+    int indexOf(const char *text) const { size_t at = find(text); return at == npos ? -1 : (int)at; }
+    bool reserve(unsigned int size) { std::string::reserve(size); return true; }
+};
+inline String operator+(const String &a, const String &b) { String result(a); result += b; return result; }
+inline String operator+(const String &a, const char *b) { String result(a); result += b; return result; }
+inline String operator+(const char *a, const String &b) { String result(a); result += b; return result; }
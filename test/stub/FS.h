@@ -0,0 +1,151 @@
+// In-memory file system with power cut injection for host tests
+#pragma once
+#include <Arduino.h>
+#include <map>
+#include <memory>
+#include <vector>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+struct FSSTATE {
+  std::map<std::string, std::vector<uint8_t>> files;
+  std::map<std::string, bool> dirs;
+  long writesLeft = -1;     // Writes before the power cut, -1 for never
+  size_t tornBytes = 0;     // Bytes of the cut write that land, the rest it covered is lost
+  bool dead = false;        // Power is gone, nothing reaches the card
+  uint32_t writes = 0;
+};
+
+struct FILEHANDLE {
+  FSSTATE *state;
+  std::string path;
+  size_t position = 0;
+  bool directory = false;
+  bool writable = false;
+  bool open = true;
+  std::vector<std::string> entries;
+  size_t nextEntry = 0;
+};
+
+class File {
+  private:
+    std::shared_ptr<FILEHANDLE> handle;   // Copies share the open file, as on the device
+
+  public:
+    File() {}
+    File(std::shared_ptr<FILEHANDLE> handle) : handle(handle) {}
+    explicit operator bool() const { return this->handle && this->handle->open; }
+    bool isDirectory() { return this->handle->directory; }
+    const char *name() { return this->handle->path.c_str(); }
+    size_t size() { return this->handle->state->files[this->handle->path].size(); }
+    time_t getLastWrite() { return 1600000000; }
+    bool seek(uint32_t position) {
+      if (!this->handle->writable && position > this->size()) {
+        return false;
+      }
+      this->handle->position = position;
+      return true;
+    }
+    size_t read(uint8_t *buffer, size_t length) {
+      std::vector<uint8_t> &data = this->handle->state->files[this->handle->path];
+      size_t count = this->handle->position >= data.size() ? 0 : std::min(length, data.size() - this->handle->position);
+      memcpy(buffer, data.data() + this->handle->position, count);
+      this->handle->position += count;
+      return count;
+    }
+    size_t write(const uint8_t *buffer, size_t length) {
+      FSSTATE *state = this->handle->state;
+      if (state->dead || !this->handle->writable) {
+        return 0;
+      }
+      size_t count = length;
+      if (state->writesLeft == 0) {
+        // Only the head of the write makes it before the power goes
+        count = std::min(length, state->tornBytes);
+        state->dead = true;
+      } else if (state->writesLeft > 0) {
+        state->writesLeft--;
+      }
+      state->writes++;
+      std::vector<uint8_t> &data = state->files[this->handle->path];
+      if (data.size() < this->handle->position + count) {
+        data.resize(this->handle->position + count);
+      }
+      memcpy(data.data() + this->handle->position, buffer, count);
+      if (state->dead && data.size() > this->handle->position + count) {
+        // Flash is erased ahead of the write, what it didn't get to reads back blank
+        size_t end = std::min(data.size(), this->handle->position + length);
+        memset(data.data() + this->handle->position + count, 0xFF, end - this->handle->position - count);
+      }
+      this->handle->position += count;
+      return state->dead ? 0 : length;
+    }
+    File openNextFile() {
+      if (this->handle->nextEntry >= this->handle->entries.size()) {
+        return File();
+      }
+      std::shared_ptr<FILEHANDLE> entry = std::make_shared<FILEHANDLE>();
+      entry->state = this->handle->state;
+      entry->path = this->handle->entries[this->handle->nextEntry++];
+      return File(entry);
+    }
+    void close() {
+      if (this->handle) {
+        this->handle->open = false;
+      }
+    }
+};
+
+class FS {
+  public:
+    FSSTATE state;
+    /** Cut the power on the write after the next `writes` ones, landing `tornBytes` of it */
+    void cutPower(long writes, size_t tornBytes) {
+      this->state.writesLeft = writes;
+      this->state.tornBytes = tornBytes;
+    }
+    void restorePower() {
+      this->state.writesLeft = -1;
+      this->state.dead = false;
+    }
+    bool exists(const char *path) { return this->state.files.count(path) > 0 || this->state.dirs.count(path) > 0; }
+    bool exists(const String &path) { return this->exists(path.c_str()); }
+    bool mkdir(const char *path) { this->state.dirs[path] = true; return true; }
+    bool remove(const char *path) { return !this->state.dead && this->state.files.erase(path) > 0; }
+    File open(const char *path, const char *mode = FILE_READ) {
+      std::shared_ptr<FILEHANDLE> handle = std::make_shared<FILEHANDLE>();
+      handle->state = &this->state;
+      handle->path = path;
+      if (this->state.dirs.count(path) > 0) {
+        handle->directory = true;
+        std::string prefix = std::string(path) + "/";
+        for (auto &file : this->state.files) {
+          if (file.first.compare(0, prefix.size(), prefix) == 0) {
+            handle->entries.push_back(file.first);
+          }
+        }
+        return File(handle);
+      }
+      std::string how = mode;
+      if ((how == "r" || how == "r+") && this->state.files.count(path) == 0) {
+        return File();
+      }
+      if (how == "w" && !this->state.dead) {
+        this->state.files[path].clear();
+      }
+      if (how == "a") {
+        handle->position = this->state.files[path].size();
+      }
+      handle->writable = how != "r";
+      return File(handle);
+    }
+    File open(const String &path, const char *mode = FILE_READ) { return this->open(path.c_str(), mode); }
+};
+
+}
+
+using fs::File;
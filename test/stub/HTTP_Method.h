@@ -0,0 +1,12 @@
+#pragma once
+// Values of http_parser's enum http_method, as the ESP32 WebServer uses them
+typedef enum {
+  HTTP_DELETE = 0,
+  HTTP_GET = 1,
+  HTTP_HEAD = 2,
+  HTTP_POST = 3,
+  HTTP_PUT = 4,
+  HTTP_OPTIONS = 6,
+  HTTP_PATCH = 28,
+  HTTP_ANY = 255
+} HTTPMethod;
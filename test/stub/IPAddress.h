@@ -0,0 +1,30 @@
+#pragma once
+#include <Arduino.h>
+
+class IPAddress {
+  private:
+    uint32_t address;       // Network order, like the core
+
+  public:
+    IPAddress() : address(0) {}
+    IPAddress(uint32_t address) : address(address) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : address(a | b << 8 | c << 16 | (uint32_t)d << 24) {}
+    operator uint32_t() const { return this->address; }
+    uint8_t operator[](int index) const { return this->address >> (8 * index); }
+    bool operator==(const IPAddress &other) const { return this->address == other.address; }
+    bool operator!=(const IPAddress &other) const { return this->address != other.address; }
+    bool fromString(const char *text) {
+      unsigned int a, b, c, d;
+      char tail;
+      if (sscanf(text, "%u.%u.%u.%u%c", &a, &b, &c, &d, &tail) != 4 || a > 255 || b > 255 || c > 255 || d > 255) {
+        return false;
+      }
+      *this = IPAddress(a, b, c, d);
+      return true;
+    }
+    String toString() const {
+      char text[16];
+      snprintf(text, sizeof(text), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+      return String(text);
+    }
+};
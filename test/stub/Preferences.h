@@ -0,0 +1,44 @@
+// Host stand-in for NVS, one store shared by every instance so a new one
+// sees what an earlier one saved, the way a reboot would
+#pragma once
+#include <Arduino.h>
+#include <map>
+#include <vector>
+
+class Preferences {
+  private:
+    std::string name;
+    std::string path(const char *key) { return this->name + "/" + key; }
+
+  public:
+    static std::map<std::string, std::vector<uint8_t>> &store() {
+      static std::map<std::string, std::vector<uint8_t>> entries;
+      return entries;
+    }
+    bool begin(const char *name, bool readOnly = false) { this->name = name; return true; }
+    void end() {}
+    size_t getBytesLength(const char *key) {
+      auto entry = store().find(this->path(key));
+      return entry == store().end() ? 0 : entry->second.size();
+    }
+    size_t getBytes(const char *key, void *buffer, size_t length) {
+      auto entry = store().find(this->path(key));
+      if (entry == store().end()) {
+        return 0;
+      }
+      length = min(length, entry->second.size());
+      memcpy(buffer, entry->second.data(), length);
+      return length;
+    }
+    size_t putBytes(const char *key, const void *value, size_t length) {
+      store()[this->path(key)].assign((const uint8_t *)value, (const uint8_t *)value + length);
+      return length;
+    }
+    String getString(const char *key, const String &fallback = String()) {
+      auto entry = store().find(this->path(key));
+      return entry == store().end() ? fallback : String(std::string(entry->second.begin(), entry->second.end()));
+    }
+    size_t putString(const char *key, const String &value) { return this->putBytes(key, value.data(), value.size()); }
+    bool remove(const char *key) { return store().erase(this->path(key)) > 0; }
+    bool clear() { store().clear(); return true; }
+};
@@ -0,0 +1,24 @@
+#pragma once
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <map>
+
+// Name lookups answer from `hosts`, IP literals resolve to themselves
+class WiFiClass {
+  public:
+    std::map<std::string, IPAddress> hosts;
+    uint32_t lookups = 0;
+    int hostByName(const char *name, IPAddress &address) {
+      this->lookups++;
+      if (address.fromString(name)) {
+        return 1;
+      }
+      auto host = this->hosts.find(name);
+      if (host == this->hosts.end()) {
+        return 0;
+      }
+      address = host->second;
+      return 1;
+    }
+};
+inline WiFiClass WiFi;
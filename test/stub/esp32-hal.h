@@ -0,0 +1,6 @@
+#pragma once
+#include <Arduino.h>
+#include <time.h>
+
+// Declared with its default by the core, DateTime defines it
+bool getLocalTime(struct tm *info, uint32_t ms = 5000);
@@ -0,0 +1,13 @@
+// Wall clock the tests can step, `hostClockOffset` is added to the real one
+#pragma once
+#include_next <sys/time.h>
+
+inline long long hostClockOffset = 0;   // In us
+inline int hostGettimeofday(struct timeval *tv, void *tz) {
+  int result = gettimeofday(tv, NULL);
+  long long now = (long long)tv->tv_sec * 1000000 + tv->tv_usec + hostClockOffset;
+  tv->tv_sec = now / 1000000;
+  tv->tv_usec = now % 1000000;
+  return result;
+}
+#define gettimeofday(tv, tz) hostGettimeofday(tv, tz)
@@ -0,0 +1,109 @@
+#include <unity.h>
+#include <CathodeScheduler.h>
+
+#define TUBES 6
+#define STEPS 12
+
+/** HHMMSS digits of `seconds` into the day, tube 0 on the left */
+static void clockDigits(uint32_t seconds, uint8_t *digits) {
+  uint32_t number = seconds / 3600 * 10000 + seconds / 60 % 60 * 100 + seconds % 60;
+  for (int8_t tube = TUBES - 1; tube >= 0; tube--) {
+    digits[tube] = number % 10;
+    number /= 10;
+  }
+}
+
+/** Run the clock for `seconds`, a cycle every minute like nixieDisplayTask, and mark what each cycle showed */
+static void runClock(CathodeScheduler *scheduler, uint32_t from, uint32_t seconds, bool scheduled[TUBES][CATHODE_DIGITS]) {
+  uint8_t digits[TUBES];
+  uint8_t sequence[STEPS * TUBES];
+  for (uint32_t second = from; second < from + seconds; second++) {
+    clockDigits(second % 86400, digits);
+    scheduler->account(digits, 1);
+    if (second % 60 == 0) {
+      scheduler->plan(sequence, STEPS);
+      for (uint8_t i = 0; i < STEPS * TUBES; i++) {
+        scheduled[i % TUBES][sequence[i]] = true;
+      }
+    }
+  }
+}
+
+void setUp() {
+  Preferences::store().clear();
+}
+
+void tearDown() {
+}
+
+void test_least_used_cathodes_come_first() {
+  CathodeScheduler scheduler(TUBES);
+  TEST_ASSERT_TRUE(scheduler.begin());
+  uint8_t digits[TUBES];
+  // Every cathode gets a different share, 9 the least, 0 the most
+  for (uint8_t digit = 0; digit < CATHODE_DIGITS; digit++) {
+    memset(digits, digit, sizeof(digits));
+    scheduler.account(digits, (CATHODE_DIGITS - digit) * 100);
+  }
+  uint8_t sequence[STEPS * TUBES];
+  scheduler.plan(sequence, STEPS);
+  for (uint8_t step = 0; step < STEPS; step++) {
+    for (uint8_t tube = 0; tube < TUBES; tube++) {
+      TEST_ASSERT_EQUAL(9 - step % CATHODE_CYCLE_DIGITS, sequence[step * TUBES + tube]);
+    }
+  }
+}
+
+void test_never_shown_cathodes_all_take_turns() {
+  CathodeScheduler scheduler(TUBES);
+  TEST_ASSERT_TRUE(scheduler.begin());
+  bool scheduled[TUBES][CATHODE_DIGITS] = {};
+  runClock(&scheduler, 0, 86400, scheduled);
+  // A day on, 3 to 9 on the tens of hours and 6 to 9 on the tens of
+  // minutes and seconds have still never been shown
+  for (uint8_t tube = 0; tube < TUBES; tube++) {
+    for (uint8_t digit = 0; digit < CATHODE_DIGITS; digit++) {
+      if (scheduler.getHours(tube, digit) == 0) {
+        char message[32];
+        snprintf(message, sizeof(message), "tube %u digit %u", tube, digit);
+        TEST_ASSERT_TRUE_MESSAGE(scheduled[tube][digit], message);
+      }
+    }
+  }
+  // And they take turns within a few cycles, not just over a whole day
+  memset(scheduled, 0, sizeof(scheduled));
+  runClock(&scheduler, 86400, 3 * 60, scheduled);
+  for (uint8_t digit = 3; digit < CATHODE_DIGITS; digit++) {
+    TEST_ASSERT_TRUE(scheduled[0][digit]);
+  }
+}
+
+void test_counters_and_rotation_survive_a_reboot() {
+  CathodeScheduler *scheduler = new CathodeScheduler(TUBES);
+  TEST_ASSERT_TRUE(scheduler->begin());
+  uint8_t digits[TUBES] = {};
+  scheduler->account(digits, 2 * 3600);
+  uint8_t sequence[STEPS * TUBES];
+  scheduler->plan(sequence, STEPS);
+  TEST_ASSERT_EQUAL(1, sequence[0]);
+  TEST_ASSERT_TRUE(scheduler->save(true));
+  delete scheduler;
+
+  scheduler = new CathodeScheduler(TUBES);
+  TEST_ASSERT_TRUE(scheduler->begin());
+  TEST_ASSERT_EQUAL(2, scheduler->getHours(0, 0));
+  // Carries on after the cathodes the last cycle before the reboot ran
+  scheduler->plan(sequence, STEPS);
+  for (uint8_t step = 0; step < CATHODE_CYCLE_DIGITS; step++) {
+    TEST_ASSERT_EQUAL(1 + CATHODE_CYCLE_DIGITS + step, sequence[step * TUBES]);
+  }
+  delete scheduler;
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_least_used_cathodes_come_first);
+  RUN_TEST(test_never_shown_cathodes_all_take_turns);
+  RUN_TEST(test_counters_and_rotation_survive_a_reboot);
+  return UNITY_END();
+}
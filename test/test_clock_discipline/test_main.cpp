@@ -0,0 +1,203 @@
+#include <unity.h>
+#include <ClockDiscipline.h>
+#include <functional>
+
+#define POLL 64.0                   // Between samples (s)
+#define LONG_POLL 1024.0
+#define HOLDOVER 64.0               // clock_holdover_period, slews between samples (s)
+
+/**
+ * A local clock drifting off the reference, disciplined by samples every
+ * `poll` s with holdover slews in between, the way syncRtckWithNtp runs it.
+ * Slews land at once, adjtime finishes well within a holdover period.
+ */
+struct SIMULATION {
+  double error;                     // Local minus reference (s)
+  double now;
+  uint32_t seed;
+  double measured;                  // Offset the last sample saw, without the noise (s)
+};
+
+static double noise(SIMULATION *sim, double deviation) {
+  // Sum of uniforms, close enough to a normal distribution
+  double sum = 0;
+  for (uint8_t i = 0; i < 12; i++) {
+    sim->seed = sim->seed * 1664525 + 1013904223;
+    sum += (sim->seed >> 8) / 16777216.0;
+  }
+  return (sum - 6) * deviation;
+}
+
+/** Run `count` samples, `drift` gives the local clock error in ppm at a given time. @return last adjustment */
+static CLOCKADJUSTMENT run(ClockDiscipline *discipline, SIMULATION *sim, uint32_t count, double poll,
+    std::function<double(double)> drift, double deviation = 0) {
+  CLOCKADJUSTMENT adjustment = { CLOCK_NONE, 0 };
+  for (uint32_t i = 0; i < count; i++) {
+    for (double step = HOLDOVER; step <= poll; step += HOLDOVER) {
+      sim->error += drift(sim->now) * 1e-6 * HOLDOVER;
+      sim->now += HOLDOVER;
+      if (step + HOLDOVER <= poll) {
+        sim->error += discipline->holdover(sim->now);
+      }
+    }
+    sim->measured = -sim->error;
+    adjustment = discipline->update(sim->measured + noise(sim, deviation), sim->now);
+    sim->error += adjustment.amount;
+  }
+  return adjustment;
+}
+
+static std::function<double(double)> constant(double ppm) {
+  return [ppm](double now) { return ppm; };
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_first_samples() {
+  ClockDiscipline discipline;
+  // Half of a small offset is slewed, nothing known about frequency yet
+  CLOCKADJUSTMENT adjustment = discipline.update(0.1, 10);
+  TEST_ASSERT_EQUAL(CLOCK_SLEW, adjustment.type);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.05, adjustment.amount);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.05, discipline.getResidual());
+  // What the slew didn't explain is frequency: 6.4 ms over 64 s is 100 ppm, a quarter of it taken
+  adjustment = discipline.update(0.05 + 0.0064, 10 + POLL);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, 25, discipline.getFrequency());
+  // Half the offset plus the frequency owed since the last correction
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.0282 + 25e-6 * POLL, adjustment.amount);
+  // Samples closer together than that don't touch the frequency
+  discipline.update(0.001, 10 + POLL + 5);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, 25, discipline.getFrequency());
+}
+
+void test_far_off_is_stepped() {
+  ClockDiscipline discipline;
+  CLOCKADJUSTMENT adjustment = discipline.update(-3600.25, 10);
+  TEST_ASSERT_EQUAL(CLOCK_STEP, adjustment.type);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, -3600.25, adjustment.amount);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0, discipline.getResidual());
+  adjustment = discipline.update(2.5, 10 + POLL);
+  TEST_ASSERT_EQUAL(CLOCK_STEP, adjustment.type);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, 2.5, adjustment.amount);
+}
+
+void test_constant_drift_converges() {
+  static const double drifts[] = { 37, -12.5, 150 };
+  for (double ppm : drifts) {
+    ClockDiscipline discipline;
+    SIMULATION sim = { 0.3, 0, 1, 0 };
+    run(&discipline, &sim, 60, POLL, constant(ppm));
+    // A fast local clock needs a negative correction
+    TEST_ASSERT_DOUBLE_WITHIN(0.05, -ppm, discipline.getFrequency());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-4, 0, sim.measured);
+    // Once locked each slew is about the frequency owed for one poll
+    CLOCKADJUSTMENT adjustment = run(&discipline, &sim, 1, POLL, constant(ppm));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-5, -ppm * 1e-6 * POLL, adjustment.amount);
+  }
+}
+
+void test_ramp_is_tracked() {
+  // Warming up by 20 ppm over a day
+  ClockDiscipline discipline;
+  SIMULATION sim = { 0, 0, 1, 0 };
+  run(&discipline, &sim, 30, POLL, constant(5));
+  double maxError = 0;
+  auto ramp = [](double now) { return 5 + 20 * now / 86400; };
+  for (uint32_t i = 0; i < 86400 / POLL - 30; i++) {
+    run(&discipline, &sim, 1, POLL, ramp);
+    maxError = fmax(maxError, fabs(sim.measured));
+  }
+  // Lags the ramp by a few samples, no more
+  TEST_ASSERT_DOUBLE_WITHIN(0.2, -ramp(sim.now), discipline.getFrequency());
+  TEST_ASSERT_LESS_THAN(1e-3, maxError);
+}
+
+void test_noisy_offsets_average_out() {
+  ClockDiscipline discipline;
+  SIMULATION sim = { 0, 0, 7, 0 };
+  run(&discipline, &sim, 40, LONG_POLL, constant(-22), 0.001);
+  double sum = 0, squares = 0;
+  for (uint32_t i = 0; i < 400; i++) {
+    run(&discipline, &sim, 1, LONG_POLL, constant(-22), 0.001);
+    sum += discipline.getFrequency();
+    squares += sim.measured * sim.measured;
+  }
+  TEST_ASSERT_DOUBLE_WITHIN(0.3, 22, sum / 400);
+  // The clock stays within a few times the measurement noise
+  TEST_ASSERT_LESS_THAN(0.003, sqrt(squares / 400));
+}
+
+void test_frequency_is_clamped() {
+  ClockDiscipline discipline;
+  SIMULATION sim = { 0, 0, 1, 0 };
+  run(&discipline, &sim, 40, POLL, constant(900));
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, -DISCIPLINE_MAX_FREQ, discipline.getFrequency());
+}
+
+void test_holdover_keeps_the_frequency() {
+  ClockDiscipline discipline;
+  SIMULATION sim = { 0, 0, 1, 0 };
+  run(&discipline, &sim, 60, POLL, constant(40));
+  // No samples for an hour, slewed in one minute steps
+  double slewed = 0;
+  for (uint32_t i = 1; i <= 60; i++) {
+    slewed += discipline.holdover(sim.now + i * 60);
+  }
+  TEST_ASSERT_DOUBLE_WITHIN(1e-4, -40e-6 * 3600, slewed);
+  // The next sample doesn't owe that hour again
+  sim.now += 3600;
+  sim.error += 40e-6 * 3600 + slewed;
+  CLOCKADJUSTMENT adjustment = discipline.update(-sim.error, sim.now);
+  TEST_ASSERT_LESS_THAN(40e-6 * POLL, fabs(adjustment.amount));
+}
+
+void test_rtc_aging_offset() {
+  // Reference minus RTC after a day, for a DS3231 `ppm` fast, and the aging value expected
+  struct { double ppm; int8_t aging; int8_t expected; } cases[] = {
+    { 2, 0, 10 }, { -3, 0, -15 }, { 1, -20, -15 }, { 40, 0, 127 }, { -40, -100, -128 }, { 0.01, 5, 5 }
+  };
+  for (auto &test : cases) {
+    ClockDiscipline discipline;
+    RTCADJUSTMENT adjustment = discipline.updateRtc(0.01, 1000, test.aging);
+    TEST_ASSERT_FALSE(adjustment.setTime);
+    // Too short a window to tell drift, left alone
+    adjustment = discipline.updateRtc(-test.ppm * 1e-6 * 3600, 1000 + 3600, test.aging);
+    TEST_ASSERT_FALSE(adjustment.setAging);
+    adjustment = discipline.updateRtc(-test.ppm * 1e-6 * DS3231_MIN_AGING_WINDOW, 1000 + DS3231_MIN_AGING_WINDOW, test.aging);
+    TEST_ASSERT_TRUE(adjustment.setTime);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, test.ppm, adjustment.drift);
+    // A fast crystal takes a positive aging offset, it adds load and slows it down
+    TEST_ASSERT_EQUAL(test.expected, adjustment.aging);
+    TEST_ASSERT_EQUAL(test.expected != test.aging, adjustment.setAging);
+  }
+}
+
+void test_rtc_far_off_is_set_at_once() {
+  ClockDiscipline discipline;
+  RTCADJUSTMENT adjustment = discipline.updateRtc(12, 1000, 0);
+  TEST_ASSERT_TRUE(adjustment.setTime);
+  discipline.rtcSet(1000);
+  adjustment = discipline.updateRtc(0.2, 2000, 0);
+  TEST_ASSERT_FALSE(adjustment.setTime);
+  adjustment = discipline.updateRtc(-0.6, 3000, 0);
+  TEST_ASSERT_TRUE(adjustment.setTime);
+  TEST_ASSERT_FALSE(adjustment.setAging);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_first_samples);
+  RUN_TEST(test_far_off_is_stepped);
+  RUN_TEST(test_constant_drift_converges);
+  RUN_TEST(test_ramp_is_tracked);
+  RUN_TEST(test_noisy_offsets_average_out);
+  RUN_TEST(test_frequency_is_clamped);
+  RUN_TEST(test_holdover_keeps_the_frequency);
+  RUN_TEST(test_rtc_aging_offset);
+  RUN_TEST(test_rtc_far_off_is_set_at_once);
+  return UNITY_END();
+}
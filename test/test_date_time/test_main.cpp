@@ -0,0 +1,117 @@
+#include <unity.h>
+#include <DateTime.h>
+#include <chrono>
+
+#define FIRST_DAY 0                 // 1970-01-01
+#define LAST_DAY 49710              // 2106-02-07, where 32 bit seconds run out
+
+/**
+ * The loop this replaced, walking the years and months from 1970 and
+ * building the string out of String concatenations, with the time part the
+ * way NTPClient::getFormattedTime() built it.
+ */
+static String legacyFormattedDate(unsigned long secs) {
+  unsigned long rawTime = secs / 86400L;
+  long days = 0, year = 1970;
+  uint8_t month;
+  static const uint8_t monthDays[]={31,28,31,30,31,30,31,31,30,31,30,31};
+
+  while((days += (LEAP_YEAR(year) ? 366 : 365)) <= rawTime)
+    year++;
+  rawTime -= days - (LEAP_YEAR(year) ? 366 : 365);
+  days=0;
+  for (month=0; month<12; month++) {
+    uint8_t monthLength;
+    if (month==1) {
+      monthLength = LEAP_YEAR(year) ? 29 : 28;
+    } else {
+      monthLength = monthDays[month];
+    }
+    if (rawTime < monthLength) break;
+    rawTime -= monthLength;
+  }
+  String monthStr = ++month < 10 ? "0" + String(month) : String(month);
+  String dayStr = ++rawTime < 10 ? "0" + String(rawTime) : String(rawTime);
+  unsigned long hours = secs % 86400L / 3600;
+  unsigned long minutes = secs % 3600 / 60;
+  unsigned long seconds = secs % 60;
+  String hoursStr = hours < 10 ? "0" + String(hours) : String(hours);
+  String minuteStr = minutes < 10 ? "0" + String(minutes) : String(minutes);
+  String secondStr = seconds < 10 ? "0" + String(seconds) : String(seconds);
+  return String(year) + "-" + monthStr + "-" + dayStr + "T" + hoursStr + ":" + minuteStr + ":" + secondStr + "Z";
+}
+
+static double nanosPerCall(std::chrono::steady_clock::time_point start, uint32_t calls) {
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / calls;
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_every_day_round_trips() {
+  for (int32_t day = FIRST_DAY; day <= LAST_DAY; day++) {
+    CIVILDATE date = civilFromDays(day);
+    TEST_ASSERT_EQUAL(day, daysFromCivil(date.year, date.month, date.day));
+    // A different second of the day each time so the time part is covered too
+    uint32_t secs = (uint32_t)day * 86400 + (uint32_t)day * 7919 % 86400;
+    if (secs < (uint32_t)day * 86400) {
+      break;                        // Past 2106-02-07T06:28:15Z
+    }
+    char buffer[ISO8601_SIZE];
+    TEST_ASSERT_EQUAL(ISO8601_SIZE - 1, formatIso8601(buffer, sizeof(buffer), secs));
+    TEST_ASSERT_EQUAL_STRING(legacyFormattedDate(secs).c_str(), buffer);
+  }
+}
+
+void test_consecutive_days_are_consecutive_dates() {
+  CIVILDATE previous = civilFromDays(FIRST_DAY);
+  TEST_ASSERT_EQUAL(1970, previous.year);
+  for (int32_t day = FIRST_DAY + 1; day <= LAST_DAY; day++) {
+    CIVILDATE date = civilFromDays(day);
+    bool nextDay = date.year == previous.year && date.month == previous.month && date.day == previous.day + 1;
+    bool nextMonth = date.year == previous.year && date.month == previous.month + 1 && date.day == 1;
+    bool nextYear = date.year == previous.year + 1 && date.month == 1 && date.day == 1 && previous.month == 12 && previous.day == 31;
+    TEST_ASSERT_TRUE(nextDay || nextMonth || nextYear);
+    previous = date;
+  }
+  TEST_ASSERT_EQUAL(2106, previous.year);
+}
+
+void test_small_buffer_is_refused() {
+  char buffer[ISO8601_SIZE - 1];
+  TEST_ASSERT_EQUAL(0, formatIso8601(buffer, sizeof(buffer), 0));
+}
+
+void test_benchmark_against_the_loop() {
+  // Every 16th day over the whole range, enough to average out the timer
+  const uint32_t stride = 16;
+  uint32_t calls = 0;
+  size_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t day = FIRST_DAY; day < LAST_DAY; day += stride, calls++) {
+    sink += legacyFormattedDate(day * 86400 + 45296).length();
+  }
+  double legacy = nanosPerCall(start, calls);
+  start = std::chrono::steady_clock::now();
+  for (uint32_t round = 0; round < 16; round++) {
+    for (uint32_t day = FIRST_DAY; day < LAST_DAY; day += stride) {
+      char buffer[ISO8601_SIZE];
+      sink += formatIso8601(buffer, sizeof(buffer), day * 86400 + 45296 + round);
+    }
+  }
+  double current = nanosPerCall(start, calls * 16);
+  printf("getFormattedDate loop: %.0f ns, formatIso8601: %.0f ns per date (%zu)\n", legacy, current, sink);
+  TEST_ASSERT_TRUE(current < legacy);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_every_day_round_trips);
+  RUN_TEST(test_consecutive_days_are_consecutive_dates);
+  RUN_TEST(test_small_buffer_is_refused);
+  RUN_TEST(test_benchmark_against_the_loop);
+  return UNITY_END();
+}
@@ -0,0 +1,154 @@
+#include <unity.h>
+#include <DhtDecoder.h>
+#include <string.h>
+#include <vector>
+
+// A DHT22 answering 65.2 %RH, 23.1 C, the way the RMT hands it over at 1 us
+// resolution: the tail of the start signal, the response, 40 bits
+static const DHTPULSE reference[] = {
+  { 1, 31 }, { 0, 81 }, { 1, 84 },
+  // 0x02 0x8C, humidity 652
+  { 0, 53 }, { 1, 25 }, { 0, 51 }, { 1, 26 }, { 0, 52 }, { 1, 25 }, { 0, 51 }, { 1, 26 },
+  { 0, 52 }, { 1, 25 }, { 0, 51 }, { 1, 26 }, { 0, 52 }, { 1, 71 }, { 0, 51 }, { 1, 26 },
+  { 0, 53 }, { 1, 71 }, { 0, 51 }, { 1, 26 }, { 0, 52 }, { 1, 25 }, { 0, 51 }, { 1, 26 },
+  { 0, 52 }, { 1, 70 }, { 0, 51 }, { 1, 71 }, { 0, 52 }, { 1, 25 }, { 0, 51 }, { 1, 26 },
+  // 0x00 0xE7, temperature 231
+  { 0, 53 }, { 1, 25 }, { 0, 51 }, { 1, 26 }, { 0, 52 }, { 1, 25 }, { 0, 51 }, { 1, 26 },
+  { 0, 52 }, { 1, 25 }, { 0, 51 }, { 1, 26 }, { 0, 52 }, { 1, 25 }, { 0, 51 }, { 1, 26 },
+  { 0, 53 }, { 1, 71 }, { 0, 51 }, { 1, 70 }, { 0, 52 }, { 1, 71 }, { 0, 51 }, { 1, 26 },
+  { 0, 52 }, { 1, 25 }, { 0, 51 }, { 1, 70 }, { 0, 52 }, { 1, 71 }, { 0, 51 }, { 1, 70 },
+  // Checksum 0x75
+  { 0, 53 }, { 1, 25 }, { 0, 51 }, { 1, 70 }, { 0, 52 }, { 1, 71 }, { 0, 51 }, { 1, 71 },
+  { 0, 52 }, { 1, 25 }, { 0, 51 }, { 1, 70 }, { 0, 52 }, { 1, 26 }, { 0, 51 }, { 1, 71 },
+  // End of frame, the line goes back to idle
+  { 0, 54 }
+};
+
+static uint32_t seed;
+
+static int jitter(int range) {
+  seed = seed * 1664525 + 1013904223;
+  return (int)((seed >> 8) % (2 * range + 1)) - range;
+}
+
+/** Pulse train for `data`, every width off its nominal value by up to `spread` us */
+static std::vector<DHTPULSE> encode(const uint8_t *data, int spread) {
+  std::vector<DHTPULSE> pulses;
+  pulses.push_back({ 0, (uint16_t)(80 + jitter(spread)) });
+  pulses.push_back({ 1, (uint16_t)(80 + jitter(spread)) });
+  for (uint8_t bit = 0; bit < DHT_FRAME_BITS; bit++) {
+    bool one = data[bit / 8] & (0x80 >> (bit % 8));
+    pulses.push_back({ 0, (uint16_t)(50 + jitter(spread)) });
+    pulses.push_back({ 1, (uint16_t)((one ? 70 : 26) + jitter(spread)) });
+  }
+  pulses.push_back({ 0, (uint16_t)(50 + jitter(spread)) });
+  return pulses;
+}
+
+static void frame(uint8_t *data, uint16_t humidity, uint16_t temperature) {
+  data[0] = humidity >> 8;
+  data[1] = humidity;
+  data[2] = temperature >> 8;
+  data[3] = temperature;
+  data[4] = data[0] + data[1] + data[2] + data[3];
+}
+
+void setUp() {
+  seed = 1;
+}
+
+void tearDown() {
+}
+
+void test_reference_trace() {
+  DHTREADING reading;
+  TEST_ASSERT_EQUAL(DHT_OK, decodeDhtPulses(reference, sizeof(reference) / sizeof(reference[0]), &reading));
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 65.2, reading.humidity);
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 23.1, reading.temperature);
+}
+
+void test_jittered_traces() {
+  uint8_t data[5];
+  DHTREADING reading;
+  for (uint32_t i = 0; i < 10000; i++) {
+    uint16_t humidity = i % 1001;
+    uint16_t temperature = (i * 7) % 800;
+    bool negative = i % 3 == 0;
+    frame(data, humidity, temperature | (negative ? 0x8000 : 0));
+    // Wider than any sensor in spec, still clear of the thresholds
+    std::vector<DHTPULSE> pulses = encode(data, 12);
+    TEST_ASSERT_EQUAL(DHT_OK, decodeDhtPulses(pulses.data(), pulses.size(), &reading));
+    TEST_ASSERT_FLOAT_WITHIN(0.01, humidity / 10.0, reading.humidity);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, (negative ? -temperature : temperature) / 10.0, reading.temperature);
+  }
+}
+
+void test_negative_temperature() {
+  uint8_t data[5];
+  DHTREADING reading;
+  // Sign and magnitude, not two's complement: -10.1 C
+  frame(data, 255, 0x8000 | 101);
+  std::vector<DHTPULSE> pulses = encode(data, 0);
+  TEST_ASSERT_EQUAL(DHT_OK, decodeDhtPulses(pulses.data(), pulses.size(), &reading));
+  TEST_ASSERT_FLOAT_WITHIN(0.01, -10.1, reading.temperature);
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 25.5, reading.humidity);
+}
+
+void test_bad_checksum() {
+  DHTPULSE pulses[sizeof(reference) / sizeof(reference[0])];
+  memcpy(pulses, reference, sizeof(reference));
+  // Flip the last humidity bit, 0 to 1
+  pulses[3 + 2 * 15 + 1].micros = 70;
+  DHTREADING reading = { -1, -1 };
+  TEST_ASSERT_EQUAL(DHT_ERROR_CHECKSUM, decodeDhtPulses(pulses, sizeof(pulses) / sizeof(pulses[0]), &reading));
+  TEST_ASSERT_FLOAT_WITHIN(0.001, -1, reading.humidity);
+}
+
+void test_truncated_capture() {
+  DHTREADING reading;
+  // Ran out of RMT items 30 bits in
+  TEST_ASSERT_EQUAL(DHT_ERROR_TRUNCATED, decodeDhtPulses(reference, 3 + 2 * 30, &reading));
+  // The last bit has its low but lost its high
+  TEST_ASSERT_EQUAL(DHT_ERROR_TRUNCATED, decodeDhtPulses(reference, 3 + 2 * 39 + 1, &reading));
+  // A stuck high in the middle is no bit at all
+  DHTPULSE pulses[sizeof(reference) / sizeof(reference[0])];
+  memcpy(pulses, reference, sizeof(reference));
+  pulses[3 + 2 * 20 + 1].micros = 250;
+  TEST_ASSERT_EQUAL(DHT_ERROR_TRUNCATED, decodeDhtPulses(pulses, sizeof(pulses) / sizeof(pulses[0]), &reading));
+}
+
+void test_leading_start_low() {
+  uint8_t data[5];
+  frame(data, 400, 215);
+  std::vector<DHTPULSE> pulses = encode(data, 4);
+  // The capture started while our own start low was still on the line
+  std::vector<DHTPULSE> captured = { { 0, 1100 }, { 1, 28 } };
+  captured.insert(captured.end(), pulses.begin(), pulses.end());
+  DHTREADING reading;
+  TEST_ASSERT_EQUAL(DHT_OK, decodeDhtPulses(captured.data(), captured.size(), &reading));
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 40.0, reading.humidity);
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 21.5, reading.temperature);
+}
+
+void test_no_response() {
+  DHTREADING reading;
+  TEST_ASSERT_EQUAL(DHT_ERROR_TIMEOUT, decodeDhtPulses(reference, 0, &reading));
+  // Only the released line, the sensor never pulled it down
+  static const DHTPULSE released[] = { { 0, 1100 }, { 1, 30 } };
+  TEST_ASSERT_EQUAL(DHT_ERROR_NO_RESPONSE, decodeDhtPulses(released, 2, &reading));
+  // A response too short to be one
+  static const DHTPULSE glitch[] = { { 1, 30 }, { 0, 20 }, { 1, 15 }, { 0, 40 } };
+  TEST_ASSERT_EQUAL(DHT_ERROR_NO_RESPONSE, decodeDhtPulses(glitch, 4, &reading));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_reference_trace);
+  RUN_TEST(test_jittered_traces);
+  RUN_TEST(test_negative_temperature);
+  RUN_TEST(test_bad_checksum);
+  RUN_TEST(test_truncated_capture);
+  RUN_TEST(test_leading_start_low);
+  RUN_TEST(test_no_response);
+  return UNITY_END();
+}
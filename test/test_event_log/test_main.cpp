@@ -0,0 +1,177 @@
+#include <unity.h>
+#include <EventLog.h>
+
+static fs::FS *card;
+
+static EVENTLOGPAYLOAD payloadFor(uint32_t value) {
+  EVENTLOGPAYLOAD payload = {};
+  payload.sensor.temperature = value;
+  payload.sensor.humidity = value % 100;
+  return payload;
+}
+
+/**
+ * Append records numbered `from` up until `count` or the card dies, and
+ * flush every `every`. `durable` moves up to what a flush() reported written.
+ * @return the number after the last record appended
+ */
+static uint32_t appendRecords(EventLog *log, uint32_t from, uint32_t count, uint32_t every, uint32_t *durable) {
+  uint32_t i = from;
+  while (i < from + count && !card->state.dead) {
+    EVENTLOGPAYLOAD payload = payloadFor(i);
+    if (!log->append(EVENTLOG_SENSOR, 0, &payload)) {
+      break;
+    }
+    i++;
+    if (i % every == 0 && log->flush(true)) {
+      *durable = i;
+    }
+  }
+  return i;
+}
+
+/** Reopen the card and check the log holds records numbered 0 up, at least `durable` of them. @return how many */
+static uint32_t checkRecovered(EventLog *log, uint32_t durable, uint32_t appended) {
+  TEST_ASSERT_TRUE(log->begin(*card, 1000));
+  EVENTLOGCURSOR *cursor = new EVENTLOGCURSOR;
+  TEST_ASSERT_TRUE(log->seek(0, cursor));
+  EVENTLOGRECORD record;
+  uint32_t count = 0;
+  while (log->read(cursor, &record)) {
+    TEST_ASSERT_EQUAL(count, record.sequence);
+    TEST_ASSERT_EQUAL(count, (uint32_t)record.payload.sensor.temperature);
+    count++;
+  }
+  delete cursor;
+  TEST_ASSERT_GREATER_OR_EQUAL(durable, count);
+  TEST_ASSERT_LESS_OR_EQUAL(appended, count);
+  return count;
+}
+
+void setUp() {
+  card = new fs::FS();
+  hostClockOffset = 0;
+}
+
+void tearDown() {
+  delete card;
+}
+
+void test_records_read_back_in_order() {
+  EventLog *log = new EventLog();
+  TEST_ASSERT_TRUE(log->begin(*card, 1000));
+  uint32_t durable = 0;
+  appendRecords(log, 0, 200, 5, &durable);
+  TEST_ASSERT_EQUAL(200, durable);
+  delete log;
+  log = new EventLog();
+  TEST_ASSERT_EQUAL(200, checkRecovered(log, durable, 200));
+  delete log;
+}
+
+void test_partial_sectors_go_to_the_tail() {
+  EventLog *log = new EventLog();
+  TEST_ASSERT_TRUE(log->begin(*card, 1000));
+  uint32_t durable = 0;
+  appendRecords(log, 0, 20, 2, &durable);
+  // One whole sector in the segment, the rest only in a tail slot
+  TEST_ASSERT_EQUAL(EVENTLOG_SECTOR_SIZE, card->state.files[EVENTLOG_DIR "/00000000.log"].size());
+  TEST_ASSERT_EQUAL(EVENTLOG_TAIL_SLOTS * EVENTLOG_SECTOR_SIZE, card->state.files[EVENTLOG_TAIL_PATH].size());
+  delete log;
+  log = new EventLog();
+  TEST_ASSERT_EQUAL(20, checkRecovered(log, 20, 20));
+  // And the log carries on after the recovered ones
+  appendRecords(log, 20, 30, 3, &durable);
+  TEST_ASSERT_TRUE(log->flush(true));
+  delete log;
+  log = new EventLog();
+  TEST_ASSERT_EQUAL(50, checkRecovered(log, durable, 50));
+  delete log;
+}
+
+/** Cut the power at every write of a run, landing only part of it, and check nothing written is lost */
+void test_torn_writes_keep_durable_records() {
+  static const size_t tornBytes[] = { 0, 1, 40, 256, 300, 511 };
+  for (size_t torn : tornBytes) {
+    for (long writes = 0; writes < 40; writes++) {
+      delete card;
+      card = new fs::FS();
+      EventLog *log = new EventLog();
+      TEST_ASSERT_TRUE(log->begin(*card, 1000));
+      uint32_t durable = 0;
+      appendRecords(log, 0, 20, 4, &durable);
+      card->cutPower(writes, torn);
+      uint32_t appended = appendRecords(log, 20, 200, 3, &durable);
+      delete log;
+      card->restorePower();
+
+      log = new EventLog();
+      uint32_t recovered = checkRecovered(log, durable, appended);
+      // Still good for more, and those survive the next reboot
+      appended = appendRecords(log, recovered, 40, 5, &recovered);
+      delete log;
+      log = new EventLog();
+      checkRecovered(log, recovered, appended);
+      delete log;
+    }
+  }
+}
+
+void test_torn_write_across_segments() {
+  EventLog *log = new EventLog();
+  TEST_ASSERT_TRUE(log->begin(*card, 1000));
+  uint32_t almost = EVENTLOG_SEGMENT_RECORDS - 8;
+  uint32_t durable = 0;
+  appendRecords(log, 0, almost, EVENTLOG_SECTOR_RECORDS, &durable);
+  appendRecords(log, almost, 4, 2, &durable);
+  // Cut while the first sector of the next segment is partial, then full
+  card->cutPower(6, 100);
+  uint32_t appended = appendRecords(log, almost + 4, 40, 3, &durable);
+  delete log;
+  card->restorePower();
+  log = new EventLog();
+  uint32_t recovered = checkRecovered(log, durable, appended);
+  TEST_ASSERT_GREATER_THAN(EVENTLOG_SEGMENT_RECORDS, recovered);
+  delete log;
+}
+
+void test_time_never_goes_backwards() {
+  EventLog *log = new EventLog();
+  TEST_ASSERT_TRUE(log->begin(*card, 1000));
+  uint32_t durable = 0;
+  appendRecords(log, 0, 10, 5, &durable);
+  hostClockOffset = -3600LL * 1000000;
+  appendRecords(log, 10, 10, 5, &durable);
+  delete log;
+
+  // The clamp survives a reboot too
+  log = new EventLog();
+  TEST_ASSERT_TRUE(log->begin(*card, 1000));
+  appendRecords(log, 20, 10, 5, &durable);
+  EVENTLOGCURSOR *cursor = new EVENTLOGCURSOR;
+  TEST_ASSERT_TRUE(log->seek(0, cursor));
+  EVENTLOGRECORD record, previous = {};
+  uint32_t count = 0;
+  while (log->read(cursor, &record)) {
+    TEST_ASSERT_TRUE(record.time > previous.time || (record.time == previous.time && record.milliseconds >= previous.milliseconds));
+    previous = record;
+    count++;
+  }
+  TEST_ASSERT_EQUAL(30, count);
+  // Everything after the step is stamped with the last good time, seek finds it
+  TEST_ASSERT_TRUE(log->seek(previous.time, cursor));
+  TEST_ASSERT_TRUE(log->read(cursor, &record));
+  TEST_ASSERT_LESS_OR_EQUAL(10, record.sequence);
+  delete cursor;
+  delete log;
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_records_read_back_in_order);
+  RUN_TEST(test_partial_sectors_go_to_the_tail);
+  RUN_TEST(test_torn_writes_keep_durable_records);
+  RUN_TEST(test_torn_write_across_segments);
+  RUN_TEST(test_time_never_goes_backwards);
+  return UNITY_END();
+}
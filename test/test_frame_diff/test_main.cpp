@@ -0,0 +1,141 @@
+#include <unity.h>
+#include <FrameDiff.h>
+#include <stdlib.h>
+
+#define WIDTH 128
+#define HEIGHT 64
+#define FRAME_SIZE (WIDTH * HEIGHT / 8)
+
+static uint8_t frame[FRAME_SIZE];
+static uint8_t display[FRAME_SIZE];   // What the panel shows, spans are copied into it
+static uint32_t seed;
+
+static uint32_t nextRandom() {
+  seed = seed * 1664525 + 1013904223;
+  return seed >> 8;
+}
+
+/** Send every changed span of `frame` to `display`, as the display task does. @return spans sent */
+static uint32_t sendFrame(FrameDiff *diff, bool commit = true) {
+  uint16_t cursor = 0;
+  uint16_t previousEnd = 0;
+  FRAMESPAN span;
+  uint32_t spans = 0;
+  while (diff->next(frame, &cursor, &span)) {
+    uint16_t offset = span.page * WIDTH + span.first;
+    // In order, inside one page and never overlapping the previous one
+    TEST_ASSERT_LESS_THAN(HEIGHT / 8, span.page);
+    TEST_ASSERT_TRUE(span.first <= span.last);
+    TEST_ASSERT_LESS_THAN(WIDTH, span.last);
+    TEST_ASSERT_GREATER_OR_EQUAL(previousEnd, offset);
+    TEST_ASSERT_EQUAL(span.page * WIDTH + span.last + 1, cursor);
+    previousEnd = cursor;
+    memcpy(display + offset, frame + offset, span.last - span.first + 1);
+    if (commit) {
+      diff->commit(frame, span);
+    }
+    spans++;
+  }
+  TEST_ASSERT_EQUAL(FRAME_SIZE, cursor);
+  return spans;
+}
+
+static void assertDisplayShowsFrame() {
+  TEST_ASSERT_EQUAL_MEMORY(frame, display, FRAME_SIZE);
+}
+
+void setUp() {
+  seed = 12345;
+  memset(frame, 0, sizeof(frame));
+  // Whatever the panel had before, the first pass must cover it all
+  memset(display, 0xA5, sizeof(display));
+}
+
+void tearDown() {
+}
+
+void test_first_pass_sends_every_page() {
+  FrameDiff diff(WIDTH, HEIGHT);
+  TEST_ASSERT_EQUAL(HEIGHT / 8, sendFrame(&diff));
+  assertDisplayShowsFrame();
+  // Nothing changed, nothing to send
+  TEST_ASSERT_EQUAL(0, sendFrame(&diff));
+  FRAMEDIFFSTATS stats = diff.getStats();
+  TEST_ASSERT_EQUAL(FRAME_SIZE, stats.bytes);
+}
+
+void test_random_changes_reproduce_the_frame() {
+  FrameDiff diff(WIDTH, HEIGHT);
+  sendFrame(&diff);
+  for (uint16_t round = 0; round < 2000; round++) {
+    // From a single byte up to a large part of the frame
+    uint16_t changes = 1 + nextRandom() % (round % 10 == 0 ? 600 : 24);
+    for (uint16_t i = 0; i < changes; i++) {
+      frame[nextRandom() % FRAME_SIZE] = nextRandom();
+    }
+    sendFrame(&diff);
+    assertDisplayShowsFrame();
+  }
+}
+
+void test_nearby_changes_merge() {
+  FrameDiff diff(WIDTH, HEIGHT);
+  sendFrame(&diff);
+  frame[10] = 1;
+  frame[10 + FRAMEDIFF_SPAN_GAP] = 1;       // Within the gap, one span
+  frame[60] = 1;
+  frame[60 + FRAMEDIFF_SPAN_GAP + 1] = 1;   // Past it, two
+  frame[WIDTH - 1] = 1;
+  frame[WIDTH] = 1;                         // Next page, never merged across
+  TEST_ASSERT_EQUAL(5, sendFrame(&diff));
+  assertDisplayShowsFrame();
+}
+
+void test_uncommitted_spans_are_sent_again() {
+  FrameDiff diff(WIDTH, HEIGHT);
+  sendFrame(&diff);
+  frame[100] = 7;
+  frame[700] = 9;
+  // The transfer failed, the display may or may not have it
+  sendFrame(&diff, false);
+  display[100] = 0;
+  display[700] = 0;
+  TEST_ASSERT_EQUAL(2, sendFrame(&diff));
+  assertDisplayShowsFrame();
+}
+
+void test_invalidate_resends_everything() {
+  FrameDiff diff(WIDTH, HEIGHT);
+  sendFrame(&diff);
+  // The panel was reset behind our back
+  memset(display, 0, sizeof(display));
+  frame[3] = 0xFF;
+  diff.invalidate();
+  TEST_ASSERT_EQUAL(HEIGHT / 8, sendFrame(&diff));
+  assertDisplayShowsFrame();
+}
+
+void test_smaller_panel() {
+  FrameDiff diff(WIDTH, 32);
+  uint16_t cursor = 0;
+  FRAMESPAN span;
+  uint8_t pages = 0;
+  while (diff.next(frame, &cursor, &span)) {
+    TEST_ASSERT_LESS_THAN(4, span.page);
+    diff.commit(frame, span);
+    pages++;
+  }
+  TEST_ASSERT_EQUAL(4, pages);
+  TEST_ASSERT_EQUAL(WIDTH * 4, cursor);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_first_pass_sends_every_page);
+  RUN_TEST(test_random_changes_reproduce_the_frame);
+  RUN_TEST(test_nearby_changes_merge);
+  RUN_TEST(test_uncommitted_spans_are_sent_again);
+  RUN_TEST(test_invalidate_resends_everything);
+  RUN_TEST(test_smaller_panel);
+  return UNITY_END();
+}
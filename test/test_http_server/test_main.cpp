@@ -0,0 +1,455 @@
+#include <unity.h>
+#include <HttpServer.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define TEST_PORT 18080
+#define BIG_BODY_SIZE (512 * 1024)
+#define HUGE_BODY_SIZE (16 * 1024 * 1024)     // Past what loopback socket buffers absorb
+
+static HttpServer *server;
+static std::thread serverThread;
+static std::atomic<bool> running;
+static std::mutex tasksLock;
+static std::vector<std::function<void()>> tasks;
+
+/** Run `task` on the server thread, broadcast() and the clock belong to it */
+static void onServer(std::function<void()> task) {
+  std::promise<void> done;
+  {
+    std::lock_guard<std::mutex> lock(tasksLock);
+    tasks.push_back([&task, &done]() {
+      task();
+      done.set_value();
+    });
+  }
+  server->wake();
+  done.get_future().wait();
+}
+
+static uint8_t broadcastTick(uint32_t number, size_t padding = 0) {
+  std::string event = "event: tick\ndata: {\"n\":" + std::to_string(number) + ",\"pad\":\"" + std::string(padding, 'x') + "\"}\n\n";
+  uint8_t queued = 0;
+  onServer([&]() {
+    queued = server->broadcast(event.c_str(), event.size());
+  });
+  return queued;
+}
+
+/** Byte `index` of the generated bodies, a pattern that shows a dropped or repeated block */
+static char pattern(size_t index) {
+  return 'a' + (index * 7 + index / 2048) % 26;
+}
+
+static HttpProducer makeProducer(size_t length) {
+  size_t offset = 0;
+  return [length, offset](uint8_t *buffer, size_t size) mutable {
+    size_t count = std::min(size, length - offset);
+    for (size_t i = 0; i < count; i++) {
+      buffer[i] = pattern(offset + i);
+    }
+    offset += count;
+    return count;
+  };
+}
+
+static int connectClient(int receiveBuffer = 0) {
+  int client = socket(AF_INET, SOCK_STREAM, 0);
+  if (receiveBuffer > 0) {
+    // Set before connecting so the window stays small
+    setsockopt(client, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+  }
+  struct sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(TEST_PORT);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  TEST_ASSERT_EQUAL(0, connect(client, (struct sockaddr *)&address, sizeof(address)));
+  struct timeval timeout = { 5, 0 };
+  setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  return client;
+}
+
+static void sendRequest(int client, const char *request) {
+  TEST_ASSERT_EQUAL((ssize_t)strlen(request), ::send(client, request, strlen(request), 0));
+}
+
+/** Read until `buffered` holds at least `length` bytes, false on close or timeout */
+static bool fill(int client, std::string &buffered, size_t length) {
+  char data[4096];
+  while (buffered.size() < length) {
+    ssize_t count = recv(client, data, sizeof(data), 0);
+    if (count <= 0) {
+      return false;
+    }
+    buffered.append(data, count);
+  }
+  return true;
+}
+
+static bool fillLine(int client, std::string &buffered, size_t from, size_t *end) {
+  while ((*end = buffered.find("\r\n", from)) == std::string::npos) {
+    if (!fill(client, buffered, buffered.size() + 1)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+struct RESPONSE {
+  int status;
+  std::string head;
+  std::string body;
+};
+
+/** Read one response off `client`, `buffered` keeps what belongs to the next one */
+static RESPONSE readResponse(int client, std::string &buffered, bool headOnly = false) {
+  RESPONSE response = { 0, "", "" };
+  size_t headEnd;
+  while ((headEnd = buffered.find("\r\n\r\n")) == std::string::npos) {
+    TEST_ASSERT_TRUE_MESSAGE(fill(client, buffered, buffered.size() + 1), "response head");
+  }
+  response.head = buffered.substr(0, headEnd + 4);
+  buffered.erase(0, headEnd + 4);
+  response.status = atoi(response.head.c_str() + 9);
+  if (headOnly) {
+    return response;
+  }
+  size_t length = response.head.find("Content-Length: ");
+  if (length != std::string::npos) {
+    size_t size = strtoul(response.head.c_str() + length + 16, NULL, 10);
+    TEST_ASSERT_TRUE_MESSAGE(fill(client, buffered, size), "sized body");
+    response.body = buffered.substr(0, size);
+    buffered.erase(0, size);
+  } else if (response.head.find("Transfer-Encoding: chunked") != std::string::npos) {
+    while (true) {
+      size_t end;
+      TEST_ASSERT_TRUE_MESSAGE(fillLine(client, buffered, 0, &end), "chunk size");
+      size_t size = strtoul(buffered.c_str(), NULL, 16);
+      TEST_ASSERT_TRUE_MESSAGE(fill(client, buffered, end + 2 + size + 2), "chunk data");
+      TEST_ASSERT_EQUAL_STRING("\r\n", buffered.substr(end + 2 + size, 2).c_str());
+      response.body += buffered.substr(end + 2, size);
+      buffered.erase(0, end + 2 + size + 2);
+      if (size == 0) {
+        break;
+      }
+    }
+  } else {
+    // Delimited by the close
+    while (fill(client, buffered, buffered.size() + 1)) {
+    }
+    response.body = buffered;
+    buffered.clear();
+  }
+  return response;
+}
+
+static void assertPattern(const std::string &body, size_t length) {
+  TEST_ASSERT_EQUAL(length, body.size());
+  for (size_t i = 0; i < length; i++) {
+    if (body[i] != pattern(i)) {
+      TEST_FAIL_MESSAGE("body differs from the pattern");
+    }
+  }
+}
+
+static long elapsedMs(std::chrono::steady_clock::time_point since) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - since).count();
+}
+
+void setUp() {
+  hostMillisOffset = 0;
+  server = new HttpServer(TEST_PORT);
+  server->on("/small", HTTP_GET, []() {
+    server->send(200, "text/plain", "small");
+  });
+  server->on("/big", HTTP_GET, []() {
+    server->sendStream(200, "text/plain", CONTENT_LENGTH_UNKNOWN, makeProducer(BIG_BODY_SIZE));
+  });
+  server->on("/huge", HTTP_GET, []() {
+    server->sendStream(200, "text/plain", CONTENT_LENGTH_UNKNOWN, makeProducer(HUGE_BODY_SIZE));
+  });
+  server->on("/sized", HTTP_GET, []() {
+    server->sendStream(200, "text/plain", BIG_BODY_SIZE, makeProducer(BIG_BODY_SIZE));
+  });
+  server->on("/short", HTTP_GET, []() {
+    // Promises more than the producer has
+    server->sendStream(200, "text/plain", 10000, makeProducer(5000));
+  });
+  server->on("/events", HTTP_GET, []() {
+    server->startEventStream();
+  });
+  TEST_ASSERT_TRUE(server->begin());
+  running = true;
+  serverThread = std::thread([]() {
+    while (running) {
+      server->handle(20);
+      std::vector<std::function<void()>> ready;
+      {
+        std::lock_guard<std::mutex> lock(tasksLock);
+        ready.swap(tasks);
+      }
+      for (auto &task : ready) {
+        task();
+      }
+    }
+  });
+}
+
+void tearDown() {
+  running = false;
+  serverThread.join();
+  server->stop();
+  delete server;
+  hostMillisOffset = 0;
+}
+
+void test_keep_alive_pipelined() {
+  int client = connectClient();
+  std::string buffered;
+  sendRequest(client, "GET /small HTTP/1.1\r\nHost: x\r\n\r\nGET /small HTTP/1.1\r\nHost: x\r\n\r\n");
+  for (int i = 0; i < 2; i++) {
+    RESPONSE response = readResponse(client, buffered);
+    TEST_ASSERT_EQUAL(200, response.status);
+    TEST_ASSERT_EQUAL_STRING("small", response.body.c_str());
+  }
+  close(client);
+  TEST_ASSERT_EQUAL(1, server->getStats().keepAliveReuses);
+}
+
+void test_chunked_producer_body() {
+  int client = connectClient();
+  std::string buffered;
+  sendRequest(client, "GET /big HTTP/1.1\r\nHost: x\r\n\r\n");
+  RESPONSE response = readResponse(client, buffered);
+  TEST_ASSERT_EQUAL(200, response.status);
+  assertPattern(response.body, BIG_BODY_SIZE);
+  // The connection is still good for the next request
+  sendRequest(client, "GET /small HTTP/1.1\r\nHost: x\r\n\r\n");
+  TEST_ASSERT_EQUAL_STRING("small", readResponse(client, buffered).body.c_str());
+  close(client);
+}
+
+void test_sized_producer_body() {
+  int client = connectClient();
+  std::string buffered;
+  sendRequest(client, "GET /sized HTTP/1.1\r\nHost: x\r\n\r\n");
+  RESPONSE response = readResponse(client, buffered);
+  TEST_ASSERT_EQUAL(200, response.status);
+  assertPattern(response.body, BIG_BODY_SIZE);
+  close(client);
+}
+
+void test_head_skips_producer() {
+  int client = connectClient();
+  std::string buffered;
+  sendRequest(client, "HEAD /sized HTTP/1.1\r\nHost: x\r\n\r\nGET /small HTTP/1.1\r\nHost: x\r\n\r\n");
+  RESPONSE response = readResponse(client, buffered, true);
+  TEST_ASSERT_EQUAL(200, response.status);
+  TEST_ASSERT_EQUAL_STRING("small", readResponse(client, buffered).body.c_str());
+  close(client);
+}
+
+void test_short_producer_closes() {
+  int client = connectClient();
+  std::string buffered;
+  sendRequest(client, "GET /short HTTP/1.1\r\nHost: x\r\n\r\n");
+  // Only the close tells the client the body ended early
+  TEST_ASSERT_FALSE(fill(client, buffered, 20000));
+  TEST_ASSERT_EQUAL(5000, buffered.size() - buffered.find("\r\n\r\n") - 4);
+  close(client);
+}
+
+void test_slow_reader_does_not_stall_others() {
+  // Asks for a large body and then reads nothing for a while
+  int slow = connectClient(4096);
+  std::string slowBuffered;
+  sendRequest(slow, "GET /huge HTTP/1.1\r\nHost: x\r\n\r\n");
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  for (int i = 0; i < 10; i++) {
+    auto start = std::chrono::steady_clock::now();
+    int client = connectClient();
+    std::string buffered;
+    sendRequest(client, "GET /small HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n");
+    RESPONSE response = readResponse(client, buffered);
+    close(client);
+    TEST_ASSERT_EQUAL_STRING("small", response.body.c_str());
+    // Well under HTTP_WRITE_TIMEOUT, the slow reader is not being waited on
+    TEST_ASSERT_LESS_THAN(200, elapsedMs(start));
+  }
+  // The stalled body resumes where it stopped
+  RESPONSE response = readResponse(slow, slowBuffered);
+  assertPattern(response.body, HUGE_BODY_SIZE);
+  close(slow);
+}
+
+void test_concurrent_readers() {
+  const int clients = 4;
+  std::thread threads[clients];
+  std::atomic<int> complete(0);
+  for (int i = 0; i < clients; i++) {
+    threads[i] = std::thread([&complete]() {
+      int client = connectClient();
+      std::string buffered;
+      sendRequest(client, "GET /big HTTP/1.1\r\nHost: x\r\n\r\n");
+      RESPONSE response = readResponse(client, buffered);
+      if (response.body.size() == BIG_BODY_SIZE) {
+        complete++;
+      }
+      close(client);
+    });
+  }
+  for (int i = 0; i < clients; i++) {
+    threads[i].join();
+  }
+  TEST_ASSERT_EQUAL(clients, complete.load());
+}
+
+/** Open an event stream and check its head. @return the socket */
+static int subscribe(std::string &buffered, int receiveBuffer = 0) {
+  int client = connectClient(receiveBuffer);
+  sendRequest(client, "GET /events HTTP/1.1\r\nHost: x\r\n\r\n");
+  RESPONSE response = readResponse(client, buffered, true);
+  TEST_ASSERT_EQUAL(200, response.status);
+  TEST_ASSERT_TRUE(response.head.find("Content-Type: text/event-stream") != std::string::npos);
+  TEST_ASSERT_TRUE(response.head.find("Content-Length") == std::string::npos);
+  return client;
+}
+
+/** Read the next event off a stream. @return its data line, empty on close or timeout */
+static std::string readEvent(int client, std::string &buffered) {
+  size_t end;
+  while ((end = buffered.find("\n\n")) == std::string::npos) {
+    if (!fill(client, buffered, buffered.size() + 1)) {
+      return "";
+    }
+  }
+  std::string event = buffered.substr(0, end);
+  buffered.erase(0, end + 2);
+  TEST_ASSERT_EQUAL(0, event.find("event: tick\ndata: "));
+  return event.substr(event.find("data: ") + 6);
+}
+
+/** Wait for the server thread to see `count` subscribers */
+static void waitForStreams(uint8_t count) {
+  for (int i = 0; i < 200 && server->getStats().streams != count; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  TEST_ASSERT_EQUAL(count, server->getStats().streams);
+}
+
+void test_subscriber_receives_ticks() {
+  std::string buffered;
+  int client = subscribe(buffered);
+  waitForStreams(1);
+  for (uint32_t i = 0; i < 5; i++) {
+    TEST_ASSERT_EQUAL(1, broadcastTick(i));
+    TEST_ASSERT_EQUAL_STRING(("{\"n\":" + std::to_string(i) + ",\"pad\":\"\"}").c_str(), readEvent(client, buffered).c_str());
+  }
+  close(client);
+  // Leaving is noticed without anything being written to it
+  waitForStreams(0);
+}
+
+void test_one_event_fans_out() {
+  const int clients = 3;
+  int sockets[clients];
+  std::string buffered[clients];
+  for (int i = 0; i < clients; i++) {
+    sockets[i] = subscribe(buffered[i]);
+  }
+  waitForStreams(clients);
+  for (uint32_t n = 0; n < 20; n++) {
+    TEST_ASSERT_EQUAL(clients, broadcastTick(n, 40));
+  }
+  for (int i = 0; i < clients; i++) {
+    for (uint32_t n = 0; n < 20; n++) {
+      TEST_ASSERT_EQUAL(0, readEvent(sockets[i], buffered[i]).find("{\"n\":" + std::to_string(n) + ","));
+    }
+    close(sockets[i]);
+  }
+}
+
+void test_stalled_subscriber_is_dropped() {
+  std::string healthyBuffered, stalledBuffered;
+  int healthy = subscribe(healthyBuffered);
+  // Takes the head and then reads nothing
+  int stalled = subscribe(stalledBuffered, 4096);
+  waitForStreams(2);
+  uint32_t n = 0;
+  uint32_t dropped = server->getStats().droppedEvents;
+  while (server->getStats().droppedEvents == dropped) {
+    TEST_ASSERT_LESS_THAN(100000, n);
+    broadcastTick(n, 400);
+    // The healthy one keeps up with every event
+    TEST_ASSERT_EQUAL(0, readEvent(healthy, healthyBuffered).find("{\"n\":" + std::to_string(n) + ","));
+    n++;
+  }
+  // Only the stalled one misses out
+  TEST_ASSERT_EQUAL(1, broadcastTick(n, 400));
+  TEST_ASSERT_EQUAL(0, readEvent(healthy, healthyBuffered).find("{\"n\":" + std::to_string(n) + ","));
+  n++;
+  // Past the stall timeout it is closed, the healthy one has nothing pending and stays
+  onServer([]() {
+    hostMillisOffset += HTTP_STALL_TIMEOUT;
+  });
+  waitForStreams(1);
+  TEST_ASSERT_EQUAL(1, broadcastTick(n, 400));
+  TEST_ASSERT_EQUAL(0, readEvent(healthy, healthyBuffered).find("{\"n\":" + std::to_string(n) + ","));
+  // What the stalled one had buffered drains, then the close shows
+  while (readEvent(stalled, stalledBuffered) != "") {
+  }
+  char data;
+  TEST_ASSERT_EQUAL(0, recv(stalled, &data, 1, 0));
+  close(stalled);
+  close(healthy);
+}
+
+void test_fifth_stream_is_refused() {
+  int sockets[HTTP_MAX_STREAMS];
+  std::string buffered[HTTP_MAX_STREAMS];
+  for (int i = 0; i < HTTP_MAX_STREAMS; i++) {
+    sockets[i] = subscribe(buffered[i]);
+  }
+  waitForStreams(HTTP_MAX_STREAMS);
+  int client = connectClient();
+  std::string extra;
+  sendRequest(client, "GET /events HTTP/1.1\r\nHost: x\r\n\r\n");
+  RESPONSE response = readResponse(client, extra);
+  TEST_ASSERT_EQUAL(503, response.status);
+  // The connection is still good for a plain request
+  sendRequest(client, "GET /small HTTP/1.1\r\nHost: x\r\n\r\n");
+  TEST_ASSERT_EQUAL_STRING("small", readResponse(client, extra).body.c_str());
+  close(client);
+  // A freed slot can be taken again
+  close(sockets[0]);
+  waitForStreams(HTTP_MAX_STREAMS - 1);
+  sockets[0] = subscribe(buffered[0]);
+  waitForStreams(HTTP_MAX_STREAMS);
+  for (int i = 0; i < HTTP_MAX_STREAMS; i++) {
+    close(sockets[i]);
+  }
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_keep_alive_pipelined);
+  RUN_TEST(test_chunked_producer_body);
+  RUN_TEST(test_sized_producer_body);
+  RUN_TEST(test_head_skips_producer);
+  RUN_TEST(test_short_producer_closes);
+  RUN_TEST(test_slow_reader_does_not_stall_others);
+  RUN_TEST(test_concurrent_readers);
+  RUN_TEST(test_subscriber_receives_ticks);
+  RUN_TEST(test_one_event_fans_out);
+  RUN_TEST(test_stalled_subscriber_is_dropped);
+  RUN_TEST(test_fifth_stream_is_refused);
+  return UNITY_END();
+}
@@ -0,0 +1,100 @@
+#include <unity.h>
+#include <utils.h>
+#include <chrono>
+
+/** The chain this replaced, one endsWith() per type on a String copy */
+static String legacyContentType(String filename) {
+  if (filename.endsWith(".htm")) {
+    return "text/html";
+  } else if (filename.endsWith(".html")) {
+    return "text/html";
+  } else if (filename.endsWith(".css")) {
+    return "text/css";
+  } else if (filename.endsWith(".js")) {
+    return "application/javascript";
+  } else if (filename.endsWith(".png")) {
+    return "image/png";
+  } else if (filename.endsWith(".gif")) {
+    return "image/gif";
+  } else if (filename.endsWith(".jpg")) {
+    return "image/jpeg";
+  } else if (filename.endsWith(".ico")) {
+    return "image/x-icon";
+  } else if (filename.endsWith(".xml")) {
+    return "text/xml";
+  } else if (filename.endsWith(".pdf")) {
+    return "application/x-pdf";
+  } else if (filename.endsWith(".zip")) {
+    return "application/x-zip";
+  } else if (filename.endsWith(".gz")) {
+    return "application/x-gzip";
+  }
+  return "text/plain";
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+/** A slot holds one extension, so two sharing one would leave one of them text/plain */
+void test_every_extension_has_its_own_slot() {
+  for (const MIMETYPE &mime : mimeTypes) {
+    std::string filename = std::string("/www/file.") + mime.extension;
+    TEST_ASSERT_EQUAL_STRING_MESSAGE(mime.type, getContentType(filename), mime.extension);
+  }
+}
+
+void test_only_the_last_extension_counts() {
+  TEST_ASSERT_EQUAL_STRING("application/x-gzip", getContentType("/www/app.js.gz"));
+  TEST_ASSERT_EQUAL_STRING("application/javascript", getContentType("/www/v1.2/app.js"));
+}
+
+void test_unknown_extensions_are_plain_text() {
+  static const char *const unknown[] = {
+    "/www/readme", "/www/readme.", "/www/file.txt", "/www/file.htmlx", "/www/file.ht", "/www/file.JS",
+    "/www/file.j", "/www/file.jsonp", "/www/file.html "
+  };
+  for (const char *filename : unknown) {
+    TEST_ASSERT_EQUAL_STRING_MESSAGE("text/plain", getContentType(filename), filename);
+  }
+}
+
+void test_benchmark_against_the_chain() {
+  // What a page load asks for, the tail of the chain included
+  static const char *const filenames[] = {
+    "/index.html", "/css/style.css", "/js/app.js", "/favicon.ico", "/img/logo.png", "/js/app.js.gz",
+    "/fonts/nixie.woff2", "/data/history.json", "/readme.txt"
+  };
+  const uint32_t rounds = 20000;
+  size_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t round = 0; round < rounds; round++) {
+    for (const char *filename : filenames) {
+      sink += legacyContentType(filename).length();
+    }
+  }
+  auto legacy = std::chrono::steady_clock::now() - start;
+  start = std::chrono::steady_clock::now();
+  for (uint32_t round = 0; round < rounds; round++) {
+    for (const char *filename : filenames) {
+      sink += strlen(getContentType(filename));
+    }
+  }
+  auto current = std::chrono::steady_clock::now() - start;
+  uint32_t calls = rounds * sizeof(filenames) / sizeof(filenames[0]);
+  printf("endsWith chain: %.0f ns, hash: %.0f ns per lookup (%zu)\n",
+    std::chrono::duration<double, std::nano>(legacy).count() / calls,
+    std::chrono::duration<double, std::nano>(current).count() / calls, sink);
+  TEST_ASSERT_TRUE(current < legacy);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_every_extension_has_its_own_slot);
+  RUN_TEST(test_only_the_last_extension_counts);
+  RUN_TEST(test_unknown_extensions_are_plain_text);
+  RUN_TEST(test_benchmark_against_the_chain);
+  return UNITY_END();
+}
@@ -0,0 +1,366 @@
+#include <unity.h>
+#include <NtpSync.h>
+#include <map>
+#include <vector>
+
+/** How a scripted server answers, times in us */
+struct SERVERSCRIPT {
+  int64_t offset;           // Server clock minus ours
+  int64_t forward;          // Request time in flight
+  int64_t processing;       // Between server receive and transmit
+  int64_t backward;         // Reply time in flight
+  bool wrongNonce;          // Echo something else as originate timestamp
+  uint32_t source;          // Reply from this address instead, 0 for the server's own
+  bool silent;
+  uint32_t dropMask;        // Bit n drops the reply to the n-th request this server gets
+  uint32_t received;        // Requests seen so far
+};
+
+struct REPLY {
+  uint8_t packet[NTP_PACKET_SIZE];
+  int64_t arrival;          // Our clock
+  uint32_t source;
+};
+
+/** UDP peer answering NTP requests as scripted, the local clock jumps to each reply as it is read */
+class FakeUdp : public UDP {
+  private:
+    std::vector<uint8_t> outgoing;
+    uint32_t destination = 0;
+    std::vector<REPLY> replies;
+    REPLY current;
+
+    static void writeTimestamp(uint8_t *buffer, int64_t micros) {
+      uint32_t seconds = micros / 1000000 + SEVENZYYEARS;
+      uint32_t fraction = ((uint64_t)(micros % 1000000) << 32) / 1000000;
+      for (uint8_t i = 0; i < 4; i++) {
+        buffer[i] = seconds >> (24 - 8 * i);
+        buffer[4 + i] = fraction >> (24 - 8 * i);
+      }
+    }
+
+  public:
+    std::map<uint32_t, SERVERSCRIPT> servers;
+    std::vector<uint32_t> requests;   // Destination of every request sent
+
+    uint8_t begin(uint16_t port) override { return 1; }
+    void stop() override {}
+    int beginPacket(IPAddress ip, uint16_t port) override {
+      this->destination = ip;
+      this->outgoing.clear();
+      return port == NTP_SERVER_PORT;
+    }
+    int beginPacket(const char *host, uint16_t port) override {
+      TEST_FAIL_MESSAGE("requests must go to a resolved address");
+      return 0;
+    }
+    size_t write(uint8_t value) override { this->outgoing.push_back(value); return 1; }
+    size_t write(const uint8_t *buffer, size_t size) override {
+      this->outgoing.insert(this->outgoing.end(), buffer, buffer + size);
+      return size;
+    }
+    int endPacket() override {
+      TEST_ASSERT_EQUAL(NTP_PACKET_SIZE, this->outgoing.size());
+      this->requests.push_back(this->destination);
+      auto server = this->servers.find(this->destination);
+      if (server == this->servers.end() || server->second.silent) {
+        return 1;
+      }
+      SERVERSCRIPT *script = &server->second;
+      if (script->dropMask & (1UL << (script->received++ % 32))) {
+        return 1;
+      }
+      int64_t sent = NtpSync::localMicros();
+      REPLY reply = {};
+      reply.packet[0] = 0b00100100;     // LI = 0, Version = 4, Mode = server
+      reply.packet[1] = 1;              // Stratum
+      memcpy(reply.packet + 24, this->outgoing.data() + 40, 8);
+      if (script->wrongNonce) {
+        reply.packet[27] ^= 0x5A;
+      }
+      int64_t received = sent + script->forward + script->offset;
+      writeTimestamp(reply.packet + 32, received);
+      writeTimestamp(reply.packet + 40, received + script->processing);
+      reply.arrival = sent + script->forward + script->processing + script->backward;
+      reply.source = script->source != 0 ? script->source : this->destination;
+      this->replies.push_back(reply);
+      return 1;
+    }
+    int parsePacket() override {
+      if (this->replies.empty()) {
+        return 0;
+      }
+      auto first = this->replies.begin();
+      for (auto reply = this->replies.begin(); reply != this->replies.end(); reply++) {
+        first = reply->arrival < first->arrival ? reply : first;
+      }
+      this->current = *first;
+      this->replies.erase(first);
+      int64_t now = NtpSync::localMicros();
+      if (this->current.arrival > now) {
+        hostClockOffset += this->current.arrival - now;
+      }
+      return NTP_PACKET_SIZE;
+    }
+    int available() override { return NTP_PACKET_SIZE; }
+    int read() override { return -1; }
+    int read(unsigned char *buffer, size_t length) override {
+      size_t count = min(length, (size_t)NTP_PACKET_SIZE);
+      memcpy(buffer, this->current.packet, count);
+      return count;
+    }
+    int read(char *buffer, size_t length) override { return this->read((unsigned char *)buffer, length); }
+    int peek() override { return -1; }
+    void flush() override {}
+    IPAddress remoteIP() override { return IPAddress(this->current.source); }
+    uint16_t remotePort() override { return NTP_SERVER_PORT; }
+};
+
+static const IPAddress first(10, 0, 0, 1);
+static const IPAddress second(10, 0, 0, 2);
+static const IPAddress third(10, 0, 0, 3);
+static const char *const servers[] = { "10.0.0.1", "10.0.0.2", "10.0.0.3" };
+static FakeUdp *udp;
+
+/** Run the state machine over simulated millis() until a poll ends. @return true with a sample */
+static bool runPoll(NtpSync *sync, NTPSAMPLE *sample, unsigned long *now) {
+  for (uint32_t i = 0; i < 100000; i++) {
+    if (sync->poll(*now, sample)) {
+      return true;
+    }
+    if (sync->getState() == NTP_BACKOFF) {
+      return false;
+    }
+    *now += max(1UL, sync->nextPollDelay(*now));
+  }
+  TEST_FAIL_MESSAGE("poll never ended");
+  return false;
+}
+
+static SERVERSCRIPT server(int64_t offset, int64_t forward, int64_t backward) {
+  return SERVERSCRIPT { offset, forward, 1000, backward, false, 0, false, 0, 0 };
+}
+
+void setUp() {
+  udp = new FakeUdp();
+  hostClockOffset = 0;
+  WiFi.hosts.clear();
+  WiFi.lookups = 0;
+}
+
+void tearDown() {
+  delete udp;
+}
+
+void test_offset_from_four_timestamps() {
+  udp->servers[first] = server(1500000, 20000, 20000);
+  NtpSync sync(*udp, servers, 1);
+  sync.begin();
+  NTPSAMPLE sample;
+  unsigned long now = 0;
+  TEST_ASSERT_TRUE(runPoll(&sync, &sample, &now));
+  TEST_ASSERT_DOUBLE_WITHIN(0.0005, 1.5, sample.offset);
+  // Processing time at the server is not part of the round trip
+  TEST_ASSERT_DOUBLE_WITHIN(0.0005, 0.040, sample.roundTrip);
+  TEST_ASSERT_EQUAL(1, sample.peers);
+  TEST_ASSERT_EQUAL(1, sample.truechimers);
+  TEST_ASSERT_EQUAL(NTP_BURST_SIZE, udp->requests.size());
+}
+
+void test_asymmetric_path_splits_the_difference() {
+  // Half the asymmetry shows up as offset, there is no telling it apart
+  udp->servers[first] = server(-250000, 30000, 10000);
+  NtpSync sync(*udp, servers, 1);
+  NTPSAMPLE sample;
+  unsigned long now = 0;
+  TEST_ASSERT_TRUE(runPoll(&sync, &sample, &now));
+  TEST_ASSERT_DOUBLE_WITHIN(0.0005, -0.25 + 0.01, sample.offset);
+  TEST_ASSERT_DOUBLE_WITHIN(0.0005, 0.040, sample.roundTrip);
+}
+
+void test_wrong_nonce_is_ignored() {
+  udp->servers[first] = server(1500000, 20000, 20000);
+  udp->servers[first].wrongNonce = true;
+  NtpSync sync(*udp, servers, 1);
+  NTPSAMPLE sample;
+  unsigned long now = 0;
+  TEST_ASSERT_FALSE(runPoll(&sync, &sample, &now));
+  TEST_ASSERT_EQUAL(NTP_BACKOFF, sync.getState());
+  // Every request waited out its timeout
+  TEST_ASSERT_GREATER_OR_EQUAL(NTP_BURST_SIZE * NTP_REQUEST_TIMEOUT, now);
+}
+
+void test_reply_from_another_host_is_ignored() {
+  udp->servers[first] = server(1500000, 20000, 20000);
+  udp->servers[first].source = second;
+  NtpSync sync(*udp, servers, 1);
+  NTPSAMPLE sample;
+  unsigned long now = 0;
+  TEST_ASSERT_FALSE(runPoll(&sync, &sample, &now));
+}
+
+void test_long_round_trip_is_dropped() {
+  udp->servers[first] = server(1500000, 600000, 500000);
+  udp->servers[second] = server(1500000, 490000, 490000);
+  NtpSync sync(*udp, servers, 2);
+  NTPSAMPLE sample;
+  unsigned long now = 0;
+  // 1.1 s is out, 0.98 s still counts
+  TEST_ASSERT_TRUE(runPoll(&sync, &sample, &now));
+  TEST_ASSERT_EQUAL(1, sample.peers);
+  TEST_ASSERT_DOUBLE_WITHIN(0.0005, 0.98, sample.roundTrip);
+
+  udp->servers[second] = server(1500000, 510000, 500000);
+  unsigned long later = now + sync.getPollInterval() * 1000UL;
+  TEST_ASSERT_FALSE(runPoll(&sync, &sample, &later));
+}
+
+void test_falseticker_is_left_out() {
+  udp->servers[first] = server(200000, 10000, 10000);
+  udp->servers[second] = server(210000, 30000, 30000);
+  udp->servers[third] = server(9000000, 10000, 10000);
+  NtpSync sync(*udp, servers, 3);
+  NTPSAMPLE sample;
+  unsigned long now = 0;
+  TEST_ASSERT_TRUE(runPoll(&sync, &sample, &now));
+  TEST_ASSERT_EQUAL(3, sample.peers);
+  TEST_ASSERT_EQUAL(2, sample.truechimers);
+  // Weighted towards the tighter first server
+  TEST_ASSERT_TRUE(sample.offset >= 0.2 && sample.offset < 0.205);
+}
+
+void test_names_resolve_once_per_poll() {
+  static const char *const pool[] = { "pool.ntp.org" };
+  WiFi.hosts["pool.ntp.org"] = first;
+  udp->servers[first] = server(0, 5000, 5000);
+  udp->servers[second] = server(0, 5000, 5000);
+  NtpSync sync(*udp, pool, 1);
+  NTPSAMPLE sample;
+  unsigned long now = 0;
+  // Let the first request out, then have the pool name move
+  TEST_ASSERT_FALSE(sync.poll(now, &sample));
+  WiFi.hosts["pool.ntp.org"] = second;
+  TEST_ASSERT_TRUE(runPoll(&sync, &sample, &now));
+  TEST_ASSERT_EQUAL(1, WiFi.lookups);
+  for (uint32_t destination : udp->requests) {
+    TEST_ASSERT_EQUAL((uint32_t)first, destination);
+  }
+  // The next poll looks it up again
+  now += sync.getPollInterval() * 1000UL;
+  TEST_ASSERT_TRUE(runPoll(&sync, &sample, &now));
+  TEST_ASSERT_EQUAL(2, WiFi.lookups);
+  TEST_ASSERT_EQUAL((uint32_t)second, udp->requests.back());
+}
+
+void test_failed_lookup_backs_off() {
+  static const char *const unknown[] = { "nowhere.invalid" };
+  NtpSync sync(*udp, unknown, 1);
+  NTPSAMPLE sample;
+  unsigned long now = 0;
+  TEST_ASSERT_FALSE(sync.poll(now, &sample));
+  TEST_ASSERT_EQUAL(NTP_BACKOFF, sync.getState());
+  TEST_ASSERT_EQUAL(0, udp->requests.size());
+}
+
+void test_lost_replies_time_out() {
+  udp->servers[first] = server(400000, 10000, 10000);
+  udp->servers[second] = server(400000, 10000, 10000);
+  udp->servers[second].silent = true;
+  // Half of the first server replies go missing too
+  udp->servers[first].dropMask = 0b0101;
+  NtpSync sync(*udp, servers, 2);
+  NTPSAMPLE sample;
+  unsigned long now = 0;
+  TEST_ASSERT_TRUE(runPoll(&sync, &sample, &now));
+  TEST_ASSERT_EQUAL(1, sample.peers);
+  TEST_ASSERT_DOUBLE_WITHIN(0.0005, 0.4, sample.offset);
+  TEST_ASSERT_EQUAL(2 * NTP_BURST_SIZE, udp->requests.size());
+  // Every request waited out its timeout, the burst still went out on schedule
+  TEST_ASSERT_GREATER_OR_EQUAL(NTP_BURST_SIZE * NTP_REQUEST_TIMEOUT + (NTP_BURST_SIZE - 1) * NTP_BURST_SPACING, now);
+  TEST_ASSERT_LESS_THAN(NTP_BURST_SIZE * NTP_REQUEST_TIMEOUT + (NTP_BURST_SIZE - 1) * NTP_BURST_SPACING + 100, now);
+}
+
+void test_dropped_burst_backs_off_and_retries() {
+  udp->servers[first] = server(400000, 10000, 10000);
+  udp->servers[first].silent = true;
+  NtpSync sync(*udp, servers, 1);
+  NTPSAMPLE sample;
+  unsigned long now = 0;
+  TEST_ASSERT_FALSE(runPoll(&sync, &sample, &now));
+  TEST_ASSERT_EQUAL(NTP_BACKOFF, sync.getState());
+  TEST_ASSERT_EQUAL(NTP_MIN_BACKOFF, sync.nextPollDelay(now));
+  // Nothing goes out before the backoff is up
+  size_t requests = udp->requests.size();
+  TEST_ASSERT_FALSE(sync.poll(now + NTP_MIN_BACKOFF - 1, &sample));
+  TEST_ASSERT_EQUAL(requests, udp->requests.size());
+  // Still lost, the wait doubles
+  now += NTP_MIN_BACKOFF;
+  TEST_ASSERT_FALSE(runPoll(&sync, &sample, &now));
+  TEST_ASSERT_EQUAL(2 * NTP_MIN_BACKOFF, sync.nextPollDelay(now));
+  // The server comes back, the retry gets a sample and the wait resets
+  udp->servers[first].silent = false;
+  now += 2 * NTP_MIN_BACKOFF;
+  TEST_ASSERT_TRUE(runPoll(&sync, &sample, &now));
+  TEST_ASSERT_DOUBLE_WITHIN(0.0005, 0.4, sample.offset);
+  TEST_ASSERT_EQUAL(sync.getPollInterval() * 1000UL, sync.nextPollDelay(now));
+  udp->servers[first].silent = true;
+  now += sync.getPollInterval() * 1000UL;
+  TEST_ASSERT_FALSE(runPoll(&sync, &sample, &now));
+  TEST_ASSERT_EQUAL(NTP_MIN_BACKOFF, sync.nextPollDelay(now));
+}
+
+void test_poll_interval_adapts() {
+  udp->servers[first] = server(50000, 10000, 10000);
+  NtpSync sync(*udp, servers, 1);
+  NTPSAMPLE sample;
+  unsigned long now = 0;
+  TEST_ASSERT_EQUAL(1UL << NTP_MIN_POLL, sync.getPollInterval());
+  // Stable, one doubling every NTP_STABLE_SAMPLES polls up to the maximum
+  for (uint8_t exponent = NTP_MIN_POLL; exponent <= NTP_MAX_POLL; exponent++) {
+    for (uint8_t i = 0; i < NTP_STABLE_SAMPLES; i++) {
+      TEST_ASSERT_EQUAL(1UL << exponent, sync.getPollInterval());
+      TEST_ASSERT_TRUE(runPoll(&sync, &sample, &now));
+      TEST_ASSERT_EQUAL(sync.getPollInterval() * 1000UL, sync.nextPollDelay(now));
+      now += sync.getPollInterval() * 1000UL;
+    }
+  }
+  TEST_ASSERT_EQUAL(1UL << NTP_MAX_POLL, sync.getPollInterval());
+  // Drifting away, halved on every sample out of bounds
+  udp->servers[first] = server(500000, 10000, 10000);
+  for (uint8_t exponent = NTP_MAX_POLL; exponent > NTP_MIN_POLL; exponent--) {
+    TEST_ASSERT_TRUE(runPoll(&sync, &sample, &now));
+    TEST_ASSERT_EQUAL(1UL << (exponent - 1), sync.getPollInterval());
+    now += sync.getPollInterval() * 1000UL;
+  }
+  TEST_ASSERT_TRUE(runPoll(&sync, &sample, &now));
+  TEST_ASSERT_EQUAL(1UL << NTP_MIN_POLL, sync.getPollInterval());
+  // One stable sample between unstable ones doesn't count towards growing
+  udp->servers[first] = server(50000, 10000, 10000);
+  for (uint8_t i = 0; i < NTP_STABLE_SAMPLES - 1; i++) {
+    now += sync.getPollInterval() * 1000UL;
+    TEST_ASSERT_TRUE(runPoll(&sync, &sample, &now));
+  }
+  udp->servers[first] = server(500000, 10000, 10000);
+  now += sync.getPollInterval() * 1000UL;
+  TEST_ASSERT_TRUE(runPoll(&sync, &sample, &now));
+  udp->servers[first] = server(50000, 10000, 10000);
+  now += sync.getPollInterval() * 1000UL;
+  TEST_ASSERT_TRUE(runPoll(&sync, &sample, &now));
+  TEST_ASSERT_EQUAL(1UL << NTP_MIN_POLL, sync.getPollInterval());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_offset_from_four_timestamps);
+  RUN_TEST(test_asymmetric_path_splits_the_difference);
+  RUN_TEST(test_wrong_nonce_is_ignored);
+  RUN_TEST(test_reply_from_another_host_is_ignored);
+  RUN_TEST(test_long_round_trip_is_dropped);
+  RUN_TEST(test_falseticker_is_left_out);
+  RUN_TEST(test_names_resolve_once_per_poll);
+  RUN_TEST(test_failed_lookup_backs_off);
+  RUN_TEST(test_lost_replies_time_out);
+  RUN_TEST(test_dropped_burst_backs_off_and_retries);
+  RUN_TEST(test_poll_interval_adapts);
+  return UNITY_END();
+}
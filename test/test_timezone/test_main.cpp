@@ -0,0 +1,134 @@
+#include <unity.h>
+#include <TimeZone.h>
+
+#define TABLE_YEAR 2024
+#define LATER_YEAR 2045               // Past the transition table, from the rules
+
+static TimeZone zone;
+
+/** Check the offset right before and right at `utc` */
+static void assertTransition(uint32_t utc, int32_t before, int32_t after, bool dstAfter) {
+  bool dst;
+  TEST_ASSERT_EQUAL(before, zone.getOffset(utc - 1, &dst));
+  TEST_ASSERT_EQUAL(!dstAfter, dst);
+  TEST_ASSERT_EQUAL(after, zone.getOffset(utc, &dst));
+  TEST_ASSERT_EQUAL(dstAfter, dst);
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_northern_zone() {
+  TEST_ASSERT_TRUE(zone.begin("CET-1CEST,M3.5.0,M10.5.0/3", TABLE_YEAR));
+  assertTransition(1711846800, 3600, 7200, true);       // 2024-03-31T01:00Z
+  assertTransition(1729990800, 7200, 3600, false);      // 2024-10-27T01:00Z
+  assertTransition(2374102800, 3600, 7200, true);       // 2045-03-26T01:00Z
+  assertTransition(2392851600, 7200, 3600, false);      // 2045-10-29T01:00Z
+  TEST_ASSERT_EQUAL_STRING("CET", zone.getName(false));
+  TEST_ASSERT_EQUAL_STRING("CEST", zone.getName(true));
+  TEST_ASSERT_EQUAL(1711846800 + 7200, zone.toLocal(1711846800));
+}
+
+void test_southern_zone() {
+  TEST_ASSERT_TRUE(zone.begin("AEST-10AEDT,M10.1.0,M4.1.0/3", TABLE_YEAR));
+  bool dst;
+  // Summer at the start of the year
+  TEST_ASSERT_EQUAL(39600, zone.getOffset(1705276800, &dst));  // 2024-01-15
+  TEST_ASSERT_TRUE(dst);
+  assertTransition(1712419200, 39600, 36000, false);    // 2024-04-06T16:00Z
+  assertTransition(1728144000, 36000, 39600, true);     // 2024-10-05T16:00Z
+  assertTransition(2374675200, 39600, 36000, false);    // 2045-04-01T16:00Z
+  assertTransition(2390400000, 36000, 39600, true);     // 2045-09-30T16:00Z
+}
+
+void test_default_us_rules() {
+  // No rule given, the US one applies
+  TEST_ASSERT_TRUE(zone.begin("EST5EDT", TABLE_YEAR));
+  assertTransition(1710054000, -18000, -14400, true);   // 2024-03-10T07:00Z
+  assertTransition(1730613600, -14400, -18000, false);  // 2024-11-03T06:00Z
+  assertTransition(2372914800, -18000, -14400, true);   // 2045-03-12T07:00Z
+  assertTransition(2393474400, -14400, -18000, false);  // 2045-11-05T06:00Z
+}
+
+void test_julian_rule_skips_february_29() {
+  TEST_ASSERT_TRUE(zone.begin("EST5EDT,J60,J300", TABLE_YEAR));
+  assertTransition(1709276400, -18000, -14400, true);   // 2024-03-01T07:00Z, leap year
+  assertTransition(1730008800, -14400, -18000, false);  // 2024-10-27T06:00Z
+  assertTransition(1740812400, -18000, -14400, true);   // 2025-03-01T07:00Z
+  assertTransition(1761544800, -14400, -18000, false);  // 2025-10-27T06:00Z
+}
+
+void test_day_rule_counts_february_29() {
+  TEST_ASSERT_TRUE(zone.begin("EST5EDT,59,299", TABLE_YEAR));
+  assertTransition(1709190000, -18000, -14400, true);   // 2024-02-29T07:00Z
+  assertTransition(1729922400, -14400, -18000, false);  // 2024-10-26T06:00Z
+  assertTransition(1740812400, -18000, -14400, true);   // 2025-03-01T07:00Z
+  assertTransition(1761544800, -14400, -18000, false);  // 2025-10-27T06:00Z
+}
+
+void test_negative_rule_time() {
+  // Greenland switches at -1:00, the evening before the last Sunday
+  TEST_ASSERT_TRUE(zone.begin("<-02>2<-01>,M3.5.0/-1,M10.5.0/0", TABLE_YEAR));
+  assertTransition(1711846800, -7200, -3600, true);     // 2024-03-31T01:00Z
+  assertTransition(1729990800, -3600, -7200, false);    // 2024-10-27T01:00Z
+  assertTransition(2374102800, -7200, -3600, true);     // 2045-03-26T01:00Z
+  assertTransition(2392851600, -3600, -7200, false);    // 2045-10-29T01:00Z
+  TEST_ASSERT_EQUAL_STRING("-02", zone.getName(false));
+}
+
+void test_rule_time_past_midnight() {
+  // Israel, the Friday before the last Sunday of March written as Thursday 26:00
+  TEST_ASSERT_TRUE(zone.begin("IST-2IDT,M3.4.4/26,M10.5.0", TABLE_YEAR));
+  assertTransition(1711670400, 7200, 10800, true);      // 2024-03-29T00:00Z
+  assertTransition(1729983600, 10800, 7200, false);     // 2024-10-26T23:00Z
+  assertTransition(2373926400, 7200, 10800, true);      // 2045-03-24T00:00Z
+  assertTransition(2392844400, 10800, 7200, false);     // 2045-10-28T23:00Z
+}
+
+void test_minute_offsets() {
+  // Lord Howe, half an hour of DST
+  TEST_ASSERT_TRUE(zone.begin("<+1030>-10:30<+11>-11,M10.1.0,M4.1.0", TABLE_YEAR));
+  assertTransition(1712415600, 39600, 37800, false);    // 2024-04-06T15:00Z
+  assertTransition(1728142200, 37800, 39600, true);     // 2024-10-05T15:30Z
+  assertTransition(2374671600, 39600, 37800, false);    // 2045-04-01T15:00Z
+  assertTransition(2390398200, 37800, 39600, true);     // 2045-09-30T15:30Z
+}
+
+void test_fixed_zone() {
+  TEST_ASSERT_TRUE(zone.begin(DEFAULT_TIMEZONE, TABLE_YEAR));
+  bool dst = true;
+  TEST_ASSERT_EQUAL(-10800, zone.getOffset(1711846800, &dst));
+  TEST_ASSERT_FALSE(dst);
+  TEST_ASSERT_EQUAL(-10800, zone.getOffset(2392851600));
+}
+
+void test_malformed_strings_fall_back_to_utc() {
+  static const char *const malformed[] = {
+    "", "CE", "CET", "CET-1CEST,M3.5.0", "CET-1CEST,M13.5.0,M10.5.0", "CET-1CEST,M3.6.0,M10.5.0",
+    "CET-1CEST,M3.5.7,M10.5.0", "CET-1CEST,J0,J300", "CET-1CEST,366,300", "<-03", "CET-1CEST,M3.5.0,M10.5.0/x",
+    "CET-1CEST,M3.5.0,M10.5.0,"
+  };
+  for (const char *tz : malformed) {
+    TEST_ASSERT_FALSE_MESSAGE(zone.begin(tz, TABLE_YEAR), tz);
+    TEST_ASSERT_EQUAL(0, zone.getOffset(1711846800));
+    TEST_ASSERT_EQUAL_STRING("UTC", zone.getName(false));
+  }
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_northern_zone);
+  RUN_TEST(test_southern_zone);
+  RUN_TEST(test_default_us_rules);
+  RUN_TEST(test_julian_rule_skips_february_29);
+  RUN_TEST(test_day_rule_counts_february_29);
+  RUN_TEST(test_negative_rule_time);
+  RUN_TEST(test_rule_time_past_midnight);
+  RUN_TEST(test_minute_offsets);
+  RUN_TEST(test_fixed_zone);
+  RUN_TEST(test_malformed_strings_fall_back_to_utc);
+  return UNITY_END();
+}